@@ -6,6 +6,10 @@
 #include <ulog.h>
 #include "paho_mqtt.h"
 #include "sht20.h"
+#include "sample_codec.h"
+#include "sample_store.h"
+#include "msg_stream.h"
+#include "stm32h7xx.h"
 /**
  * MQTT URI farmat:
  * domain mode
@@ -48,14 +52,28 @@
 #define MQTT_WILLMSG            "Goodbye!"
 #define MQTT_QOS                1
 #define MQTT_PUB_SUB_BUF_SIZE   1024
+#define MQTT_BUF_SIZE_MIN       256
+#define MQTT_BUF_SIZE_MAX       (64 * 1024)
+/* the thread paho_mqtt_start() creates, and how long stop waits for it */
+#define PAHO_THREAD_NAME        "mqtt"
+#define PAHO_EXIT_TIMEOUT_MS    5000
 
-#define CMD_INFO                "'mqtt_ctrl <start|stop>'"
+#define CMD_INFO                "'mqtt_ctrl <start|stop|status|encoding [json|cbor|packed]|bufsize [bytes]|stream [bytes]>'"
 #define TEST_DATA_SIZE          256
 #define PUB_CYCLE_TM            1000
 
+/* sample ring size, must be a power of two */
+#define SAMPLE_RING_SIZE        32
+/* max samples published per publisher wakeup */
+#define PUB_BATCH_MAX           8
+#define SAMPLE_EVENT_READY      (1 << 0)
+/* max stored samples drained per loop while the link is up */
+#define STORE_DRAIN_MAX         32
+
 #define I2C_NAME    "i2c3"
 
 static rt_thread_t pub_thread_tid = RT_NULL;
+static rt_thread_t sample_thread_tid = RT_NULL;
 
 static char *pub_data = RT_NULL;
 
@@ -66,12 +84,82 @@ static rt_uint32_t pub_count = 0, sub_count = 0;
 static int recon_count = -1;
 static int is_started = 0;
 
+/*
+ * Single-producer/single-consumer ring: only thread_sample writes ring_head,
+ * only thread_pub writes ring_tail, so no lock is needed. When full, the
+ * newest sample is dropped and counted.
+ */
+static struct sample sample_ring[SAMPLE_RING_SIZE];
+static rt_uint32_t ring_head = 0, ring_tail = 0;
+static rt_uint32_t ring_overflow = 0, ring_peak = 0;
+static rt_uint32_t sample_count = 0, pub_fail_count = 0, late_count = 0;
+
+/* payload encoding, switchable at runtime by 'mqtt_ctrl encoding' */
+static enum sample_encoding pub_encoding = SAMPLE_ENC_JSON;
+
+/* per-encoding payload size and encode cost, measured with the DWT cycle counter */
+struct encode_stat
+{
+    rt_uint32_t count;
+    rt_uint32_t bytes_last;
+    rt_uint32_t cycles_max;
+    rt_uint64_t bytes_total;
+    rt_uint64_t cycles_total;
+};
+static struct encode_stat encode_stats[SAMPLE_ENC_MAX];
+
+/*
+ * paho write and read buffers: two equal blocks of one memory pool, sized
+ * at start from mqtt_buf_size so 'mqtt_ctrl bufsize' can change them
+ */
+static rt_mp_t mqtt_buf_mp = RT_NULL;
+static rt_uint32_t mqtt_buf_size = MQTT_PUB_SUB_BUF_SIZE;
+
+static struct rt_event sample_event;
+static sht20_device_t sht20_dev = RT_NULL;
+
+/* set by the paho online/offline callbacks; samples are stored while clear */
+static volatile int link_online = 0;
+/* backlog drain progress, drain_rate is samples/s of the last complete drain */
+static rt_uint32_t drain_count = 0, drain_last = 0, drain_rate = 0;
+static rt_tick_t drain_start = 0;
+
+/*
+ * 'mqtt_stats' counters. Every field has a single writer (pub_thread, or
+ * the paho thread for rx and reconnects), so the hot path takes no lock;
+ * the shell reads them as-is and may see an average one sample stale.
+ */
+struct mqtt_client_stats
+{
+    rt_uint32_t lat_min_us;
+    rt_uint32_t lat_max_us;
+    rt_uint32_t lat_count;
+    rt_uint64_t lat_sum_us;
+    rt_uint32_t bytes_tx;
+    rt_uint32_t bytes_rx;
+    rt_uint32_t recon_n;
+    rt_uint32_t recon_last_ms;
+    rt_uint32_t recon_max_ms;
+    rt_uint32_t recon_sum_ms;
+    rt_tick_t offline_tick;
+    rt_tick_t start_tick;
+};
+static struct mqtt_client_stats stats;
+
 static void mqtt_sub_callback(MQTTClient *c, MessageData *msg_data)
 {
+    MQTTMessage *msg = msg_data->message;
+
     sub_count++;
-    *((char *) msg_data->message->payload + msg_data->message->payloadlen) = '\0';
+    stats.bytes_rx += msg->payloadlen;
+    /* chunks of a large message are streamed to their sink, not printed */
+    if (msg_stream_feed(msg->payload, msg->payloadlen))
+    {
+        return;
+    }
+    /* the payload may fill the read buffer, print it by length instead of terminating it */
     rt_kprintf("mqtt sub callback[%u]: \n topic: %.*s \n message %.*s", sub_count, msg_data->topicName->lenstring.len,
-            msg_data->topicName->lenstring.data, msg_data->message->payloadlen, (char *) msg_data->message->payload);
+            msg_data->topicName->lenstring.data, (int) msg->payloadlen, (char *) msg->payload);
 }
 
 static void mqtt_connect_callback(MQTTClient *c)
@@ -83,10 +171,30 @@ static void mqtt_online_callback(MQTTClient *c)
 {
     recon_count++;
     rt_kprintf(" mqtt_online_callback[%d]!", recon_count);
+
+    if (stats.offline_tick)
+    {
+        rt_uint32_t ms = (rt_tick_get() - stats.offline_tick) * 1000 / RT_TICK_PER_SECOND;
+
+        stats.recon_n++;
+        stats.recon_last_ms = ms;
+        stats.recon_sum_ms += ms;
+        if (ms > stats.recon_max_ms)
+        {
+            stats.recon_max_ms = ms;
+        }
+        stats.offline_tick = 0;
+    }
+
+    /* wake the publisher so the offline backlog starts draining now */
+    link_online = 1;
+    rt_event_send(&sample_event, SAMPLE_EVENT_READY);
 }
 
 static void mqtt_offline_callback(MQTTClient *c)
 {
+    link_online = 0;
+    stats.offline_tick = rt_tick_get();
     rt_kprintf(" mqtt_offline_callback!");
 }
 
@@ -95,9 +203,9 @@ static void mqtt_offline_callback(MQTTClient *c)
  *
  * @param void
  *
- * @return none
+ * @return RT_EOK or -RT_ENOMEM
  */
-static void mqtt_create(void)
+static int mqtt_create(void)
 {
     /* init condata param by using MQTTPacket_connectData_initializer */
     MQTTPacket_connectData condata = MQTTPacket_connectData_initializer;
@@ -126,10 +234,16 @@ static void mqtt_create(void)
         client.condata.will.topicName.cstring = MQTT_PUBTOPIC;
         client.condata.will.message.cstring = MQTT_WILLMSG;
 
-        /* malloc buffer. */
-        client.buf_size = client.readbuf_size = MQTT_PUB_SUB_BUF_SIZE;
-        client.buf = rt_malloc(client.buf_size);
-        client.readbuf = rt_malloc(client.readbuf_size);
+        /* allocate buffers from a pool sized for this run. */
+        mqtt_buf_mp = rt_mp_create("mqtt_buf", 2, mqtt_buf_size);
+        if (mqtt_buf_mp == RT_NULL)
+        {
+            rt_kprintf("no memory for MQTT client buffer!\n");
+            return -RT_ENOMEM;
+        }
+        client.buf_size = client.readbuf_size = mqtt_buf_size;
+        client.buf = rt_mp_alloc(mqtt_buf_mp, RT_WAITING_NO);
+        client.readbuf = rt_mp_alloc(mqtt_buf_mp, RT_WAITING_NO);
         if (!(client.buf && client.readbuf))
         {
             rt_kprintf("no memory for MQTT client buffer!\n");
@@ -153,58 +267,233 @@ static void mqtt_create(void)
     /* run mqtt client */
     paho_mqtt_start(&client);
 
-    return;
+    return RT_EOK;
+
+    _exit: if (mqtt_buf_mp)
+    {
+        rt_mp_delete(mqtt_buf_mp);
+        mqtt_buf_mp = RT_NULL;
+    }
+    client.buf = client.readbuf = RT_NULL;
+    return -RT_ENOMEM;
+}
+
+static rt_bool_t sample_ring_put(const struct sample *smp)
+{
+    rt_uint32_t head = ring_head;
+    rt_uint32_t tail = __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE);
+    rt_uint32_t depth = head - tail;
 
-    _exit: if (client.buf)
+    if (depth >= SAMPLE_RING_SIZE)
     {
-        rt_free(client.buf);
-        client.buf = RT_NULL;
+        ring_overflow++;
+        return RT_FALSE;
     }
-    if (client.readbuf)
+
+    sample_ring[head & (SAMPLE_RING_SIZE - 1)] = *smp;
+    __atomic_store_n(&ring_head, head + 1, __ATOMIC_RELEASE);
+
+    if (depth + 1 > ring_peak)
     {
-        rt_free(client.readbuf);
-        client.readbuf = RT_NULL;
+        ring_peak = depth + 1;
     }
-    return;
+    return RT_TRUE;
 }
 
-static void thread_pub(void *parameter)
+static rt_bool_t sample_ring_get(struct sample *smp)
 {
-    pub_data = rt_malloc(TEST_DATA_SIZE * sizeof(char));
-    if (!pub_data)
+    rt_uint32_t tail = ring_tail;
+
+    if (tail == __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE))
     {
-        rt_kprintf("no memory for pub_data\n");
-        return;
+        return RT_FALSE;
     }
 
-    sht20_device_t dev = sht20_init(I2C_NAME);
-    rt_kprintf("sht20_device_t init:   %p\n", dev);
+    *smp = sample_ring[tail & (SAMPLE_RING_SIZE - 1)];
+    __atomic_store_n(&ring_tail, tail + 1, __ATOMIC_RELEASE);
+    return RT_TRUE;
+}
 
-    rt_kprintf("test start at '%d'\r\n", time((time_t *) RT_NULL));
-    float humidity = 0.0, temperature = 0.0;
+static void cycle_counter_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
 
-    while (1)
+static int publish_sample(const struct sample *smp)
+{
+    enum sample_encoding enc = pub_encoding;
+    struct encode_stat *st = &encode_stats[enc];
+    MQTTMessage message;
+    rt_uint32_t cycles, us;
+    rt_size_t len;
+    int rc;
+
+    cycles = DWT->CYCCNT;
+    len = sample_encode(enc, smp, (rt_uint8_t *) pub_data, TEST_DATA_SIZE);
+    cycles = DWT->CYCCNT - cycles;
+    if (len == 0)
     {
-        humidity = sht20_read_humidity(dev);
-        temperature = sht20_read_temperature(dev);
+        return -1;
+    }
 
-        snprintf(pub_data, TEST_DATA_SIZE, "{\n"
-                "  \"seq\": \"%u\",\n"
-                "  \"time\": \"%ld\", \n"
-                "  \"humidity\": \"%.2f\",\n"
-                "  \"temperature\": \"%.2f\"\n"
-                "}", pub_count, time((time_t *) RT_NULL), humidity, temperature);
+    st->count++;
+    st->bytes_last = len;
+    st->bytes_total += len;
+    st->cycles_total += cycles;
+    if (cycles > st->cycles_max)
+    {
+        st->cycles_max = cycles;
+    }
 
+    if (enc == SAMPLE_ENC_JSON)
+    {
         rt_kprintf("%s\n", pub_data);
+    }
+
+    /* binary payloads may contain NUL, so pass the length explicitly */
+    rt_memset(&message, 0, sizeof(message));
+    message.qos = QOS1;
+    message.payload = pub_data;
+    message.payloadlen = len;
 
-        if (paho_mqtt_publish(&client, QOS1, MQTT_PUBTOPIC, pub_data) == 0)
+    cycles = DWT->CYCCNT;
+    rc = MQTTPublish(&client, MQTT_PUBTOPIC, &message);
+    us = (DWT->CYCCNT - cycles) / (SystemCoreClock / 1000000);
+    if (rc == 0)
+    {
+        if (stats.lat_count == 0 || us < stats.lat_min_us)
         {
-            ++pub_count;
+            stats.lat_min_us = us;
         }
+        if (us > stats.lat_max_us)
+        {
+            stats.lat_max_us = us;
+        }
+        stats.lat_sum_us += us;
+        stats.lat_count++;
+        stats.bytes_tx += len;
+    }
+    return rc;
+}
+
+static void thread_sample(void *parameter)
+{
+    rt_tick_t period = rt_tick_from_millisecond(PUB_CYCLE_TM);
+    rt_tick_t wake = rt_tick_get();
+    rt_tick_t elapsed;
+    struct sample smp;
+
+    while (1)
+    {
+        smp.seq = sample_count++;
+        smp.tick = rt_tick_get();
+        smp.time = time((time_t *) RT_NULL);
+        smp.humidity = sht20_read_humidity(sht20_dev);
+        smp.temperature = sht20_read_temperature(sht20_dev);
+
+        sample_ring_put(&smp);
+        rt_event_send(&sample_event, SAMPLE_EVENT_READY);
+
+        /*
+         * absolute deadline: sensor read time does not stretch the period.
+         * Overrun slots are skipped so later samples stay on the same grid.
+         */
+        elapsed = rt_tick_get() - wake;
+        if (elapsed >= period)
+        {
+            late_count += elapsed / period;
+            wake += (elapsed / period) * period;
+        }
+        rt_thread_delay_until(&wake, period);
+    }
+}
 
-        rt_thread_delay(PUB_CYCLE_TM);
+/*
+ * publish stored samples oldest first, stop at the first failure
+ *
+ * @return 0 if the store is empty or more can be sent right away, -1 on failure
+ */
+static int drain_store(void)
+{
+    struct sample smp;
+    rt_tick_t elapsed;
+    int n;
+
+    for (n = 0; n < STORE_DRAIN_MAX && link_online && sample_store_peek(&smp) == RT_EOK; n++)
+    {
+        if (drain_count == 0)
+        {
+            drain_start = rt_tick_get();
+        }
+        if (publish_sample(&smp) != 0)
+        {
+            ++pub_fail_count;
+            return -1;
+        }
+        sample_store_pop();
+        ++pub_count;
+        ++drain_count;
+    }
+
+    if (drain_count > 0 && sample_store_depth() == 0)
+    {
+        elapsed = rt_tick_get() - drain_start;
+        drain_last = drain_count;
+        drain_rate = (rt_uint32_t) ((rt_uint64_t) drain_count * RT_TICK_PER_SECOND / (elapsed ? elapsed : 1));
+        drain_count = 0;
+    }
+    return 0;
+}
+
+static void thread_pub(void *parameter)
+{
+    struct sample smp;
+    rt_uint32_t recved;
+    rt_int32_t timeout;
+    int drain_ok = 1;
+    int n;
+
+    rt_kprintf("test start at '%d'\r\n", time((time_t *) RT_NULL));
+
+    while (1)
+    {
+        /*
+         * with a backlog on a live link, do not sleep: drain at link rate.
+         * After a failed drain, retry on the next sample instead of spinning.
+         */
+        timeout = (link_online && drain_ok && sample_store_depth() > 0) ? RT_WAITING_NO : RT_WAITING_FOREVER;
+        rt_event_recv(&sample_event, SAMPLE_EVENT_READY, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                timeout, &recved);
+
+        /*
+         * a stalled publish only lets the ring fill up, sampling keeps its pace.
+         * Samples that cannot be sent go to the store; live samples are not
+         * held back behind the backlog since each carries its own seq and time.
+         */
+        for (n = 0; n < PUB_BATCH_MAX && sample_ring_get(&smp); n++)
+        {
+            if (link_online && publish_sample(&smp) == 0)
+            {
+                ++pub_count;
+                continue;
+            }
+            if (link_online)
+            {
+                ++pub_fail_count;
+            }
+            sample_store_put(&smp);
+        }
+
+        drain_ok = drain_store() == 0;
+
+        /* more samples left: come back after other threads had a chance to run */
+        if (n == PUB_BATCH_MAX)
+        {
+            rt_event_send(&sample_event, SAMPLE_EVENT_READY);
+        }
     }
-    sht20_deinit(dev);
 }
 
 void mqtt_client_start(void)
@@ -214,7 +503,19 @@ void mqtt_client_start(void)
         return;
     }
 
-    mqtt_create();
+    /* the online callback signals this event, create it before the client */
+    rt_event_init(&sample_event, "sample", RT_IPC_FLAG_FIFO);
+
+    if (sample_store_init() != RT_EOK)
+    {
+        rt_kprintf("no file system at "SAMPLE_STORE_DIR", offline samples are kept in RAM only\n");
+    }
+
+    if (mqtt_create() != RT_EOK)
+    {
+        rt_event_detach(&sample_event);
+        return;
+    }
 
     while (!client.isconnected)
     {
@@ -222,6 +523,29 @@ void mqtt_client_start(void)
         rt_thread_delay(1000);
     }
 
+    pub_data = rt_malloc(TEST_DATA_SIZE * sizeof(char));
+    if (!pub_data)
+    {
+        rt_kprintf("no memory for pub_data\n");
+        return;
+    }
+
+    rt_memset(&stats, 0, sizeof(stats));
+    stats.start_tick = rt_tick_get();
+
+    sht20_dev = sht20_init(I2C_NAME);
+    rt_kprintf("sht20_device_t init:   %p\n", sht20_dev);
+
+    ring_head = ring_tail = 0;
+    cycle_counter_init();
+
+    /* sampling runs at a higher priority so publish stalls cannot delay it */
+    sample_thread_tid = rt_thread_create("smp_thread", thread_sample, RT_NULL, 512, 7, 10);
+    if (sample_thread_tid != RT_NULL)
+    {
+        rt_thread_startup(sample_thread_tid);
+    }
+
     pub_thread_tid = rt_thread_create("pub_thread", thread_pub, RT_NULL, 1024, 8, 100);
     if (pub_thread_tid != RT_NULL)
     {
@@ -233,13 +557,54 @@ void mqtt_client_start(void)
     return;
 }
 
+/*
+ * paho_mqtt_stop() only asks the paho thread to disconnect, it keeps using
+ * client.buf and client.readbuf until it has exited
+ */
+static rt_bool_t paho_wait_exit(void)
+{
+    rt_uint32_t waited = 0;
+
+    while (rt_thread_find(PAHO_THREAD_NAME) != RT_NULL)
+    {
+        if (waited >= PAHO_EXIT_TIMEOUT_MS)
+        {
+            return RT_FALSE;
+        }
+        rt_thread_mdelay(10);
+        waited += 10;
+    }
+    return RT_TRUE;
+}
+
 void mqtt_client_stop(void)
 {
     MQTTClient *local_client = &client;
 
+    if (!is_started)
+    {
+        return;
+    }
+
+    if (sample_thread_tid)
+    {
+        rt_thread_delete(sample_thread_tid);
+        sample_thread_tid = RT_NULL;
+    }
+
     if (pub_thread_tid)
     {
         rt_thread_delete(pub_thread_tid);
+        pub_thread_tid = RT_NULL;
+    }
+
+    /* keep unsent samples for the next start */
+    sample_store_flush();
+
+    if (sht20_dev)
+    {
+        sht20_deinit(sht20_dev);
+        sht20_dev = RT_NULL;
     }
 
     if (pub_data)
@@ -253,12 +618,188 @@ void mqtt_client_stop(void)
         paho_mqtt_stop(local_client);
     }
 
+    if (mqtt_buf_mp)
+    {
+        if (paho_wait_exit())
+        {
+            rt_mp_delete(mqtt_buf_mp);
+        }
+        else
+        {
+            /* leak the pool rather than free buffers a live thread may still use */
+            rt_kprintf("paho thread did not exit, keeping its buffers\n");
+        }
+        mqtt_buf_mp = RT_NULL;
+        client.buf = client.readbuf = RT_NULL;
+    }
+
+    link_online = 0;
+    rt_event_detach(&sample_event);
+
     pub_count = sub_count = recon_count = 0;
+    sample_count = pub_fail_count = late_count = 0;
+    ring_overflow = ring_peak = 0;
+    rt_memset(encode_stats, 0, sizeof(encode_stats));
+    drain_count = drain_last = drain_rate = 0;
     is_started = 0;
 
     rt_kprintf("==== MQTT Stability test stop ====\n");
 }
 
+void mqtt_client_status(void)
+{
+    struct sample_store_stats store;
+    struct msg_stream_stats stream;
+    int i;
+    rt_uint32_t depth = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) - ring_tail;
+
+    rt_kprintf("sampled: %u, published: %u, publish failed: %u, received: %u\n",
+            sample_count, pub_count, pub_fail_count, sub_count);
+    rt_kprintf("ring depth: %u/%u, peak: %u, overflow: %u, late samples: %u\n",
+            depth, SAMPLE_RING_SIZE, ring_peak, ring_overflow, late_count);
+
+    sample_store_stats_get(&store);
+    rt_kprintf("link: %s, store depth: %u/%u, stored: %u, drained: %u, dropped: %u, flushes: %u, write errors: %u\n",
+            link_online ? "online" : "offline", store.depth, SAMPLE_STORE_SEGMENTS * SAMPLE_STORE_SEG_RECORDS,
+            store.stored, store.drained, store.dropped, store.flushes, store.write_errors);
+    rt_kprintf("last drain: %u samples at %u samples/s\n", drain_last, drain_rate);
+
+    msg_stream_stats_get(&stream);
+    rt_kprintf("buffers: %u B x2, stream: completed: %u, aborted: %u, corrupted: %u, chunks: %u, largest: %u B\n",
+            mqtt_buf_size, stream.completed, stream.aborted, stream.corrupted, stream.chunks, stream.largest);
+
+    for (i = 0; i < SAMPLE_ENC_MAX; i++)
+    {
+        const struct encode_stat *st = &encode_stats[i];
+
+        if (st->count == 0)
+        {
+            continue;
+        }
+        rt_kprintf("%c%-6s samples: %u, bytes/sample: %u (avg %u), encode cycles: avg %u, max %u\n",
+                i == (int) pub_encoding ? '*' : ' ', sample_encoding_name((enum sample_encoding) i), st->count,
+                st->bytes_last, (rt_uint32_t) (st->bytes_total / st->count),
+                (rt_uint32_t) (st->cycles_total / st->count), st->cycles_max);
+    }
+}
+
+/* show or change the paho buffer size, a running client is restarted */
+static void mqtt_ctrl_bufsize(int size)
+{
+    if (size == 0)
+    {
+        rt_kprintf("MQTT buffer size: %u bytes\n", mqtt_buf_size);
+        return;
+    }
+    if (size < MQTT_BUF_SIZE_MIN || size > MQTT_BUF_SIZE_MAX)
+    {
+        rt_kprintf("buffer size must be %d..%d bytes\n", MQTT_BUF_SIZE_MIN, MQTT_BUF_SIZE_MAX);
+        return;
+    }
+
+    mqtt_buf_size = RT_ALIGN(size, RT_ALIGN_SIZE);
+    if (is_started)
+    {
+        mqtt_client_stop();
+        mqtt_client_start();
+    }
+    rt_kprintf("MQTT buffer size: %u bytes\n", mqtt_buf_size);
+}
+
+/*
+ * send self-test messages to our own subscription through the broker,
+ * one given size, or 16 B..64 KB doubling if no size is given
+ */
+static void mqtt_ctrl_stream(int size)
+{
+    rt_uint32_t total = size > 0 ? size : 16;
+    struct msg_stream_stats before, after;
+
+    if (!is_started)
+    {
+        rt_kprintf("mqtt client is not started\n");
+        return;
+    }
+
+    msg_stream_set_sink(RT_NULL);
+    msg_stream_stats_get(&before);
+    do
+    {
+        if (msg_stream_publish_test(&client, MQTT_SUBTOPIC, total) != RT_EOK)
+        {
+            rt_kprintf("stream publish of %u bytes failed\n", total);
+            return;
+        }
+        total *= 2;
+    } while (size <= 0 && total <= 64 * 1024);
+
+    /* give the broker time to echo the chunks back */
+    rt_thread_mdelay(3000);
+    msg_stream_stats_get(&after);
+    rt_kprintf("stream test: completed: %u, aborted: %u, corrupted: %u\n", after.completed - before.completed,
+            after.aborted - before.aborted, after.corrupted - before.corrupted);
+}
+
+/* stack high-water mark in bytes: RT-Thread fills new stacks with '#', count what is no longer '#' */
+static rt_uint32_t stack_used(rt_thread_t tid)
+{
+    rt_uint8_t *p = (rt_uint8_t *) tid->stack_addr;
+
+    while (*p == '#' && p < (rt_uint8_t *) tid->stack_addr + tid->stack_size)
+    {
+        p++;
+    }
+    return tid->stack_size - (p - (rt_uint8_t *) tid->stack_addr);
+}
+
+static void mqtt_stats(uint8_t argc, char **argv)
+{
+    rt_uint32_t secs, pub_rate, sub_rate, buf_heap;
+    rt_uint32_t total, used, max_used;
+
+    if (!is_started)
+    {
+        rt_kprintf("mqtt client is not started\n");
+        return;
+    }
+
+    secs = (rt_tick_get() - stats.start_tick) / RT_TICK_PER_SECOND;
+    if (secs == 0)
+    {
+        secs = 1;
+    }
+    /* rates in 1/100 msg/s */
+    pub_rate = (rt_uint32_t) ((rt_uint64_t) pub_count * 100 / secs);
+    sub_rate = (rt_uint32_t) ((rt_uint64_t) sub_count * 100 / secs);
+
+    rt_kprintf("publish latency: min %u us, avg %u us, max %u us (%u publishes)\n", stats.lat_min_us,
+            stats.lat_count ? (rt_uint32_t) (stats.lat_sum_us / stats.lat_count) : 0, stats.lat_max_us,
+            stats.lat_count);
+    rt_kprintf("rate over %u s: published %u.%02u msg/s, received %u.%02u msg/s\n", secs, pub_rate / 100,
+            pub_rate % 100, sub_rate / 100, sub_rate % 100);
+    rt_kprintf("payload bytes: sent %u, received %u\n", stats.bytes_tx, stats.bytes_rx);
+    rt_kprintf("reconnects: %u, offline time: last %u ms, avg %u ms, max %u ms%s\n", stats.recon_n,
+            stats.recon_last_ms, stats.recon_n ? stats.recon_sum_ms / stats.recon_n : 0, stats.recon_max_ms,
+            stats.offline_tick ? " (offline now)" : "");
+
+    /* pool blocks carry a one-pointer header each */
+    buf_heap = mqtt_buf_mp ? sizeof(struct rt_mempool) + 2 * (mqtt_buf_size + sizeof(rt_uint8_t *)) : 0;
+    rt_memory_info(&total, &used, &max_used);
+    rt_kprintf("client heap: %u B (buffers 2 x %u B, pub_data %u B), system heap used %u/%u B, max %u B\n",
+            buf_heap + TEST_DATA_SIZE, mqtt_buf_size, TEST_DATA_SIZE, used, total, max_used);
+
+    if (pub_thread_tid)
+    {
+        rt_kprintf("stack high-water: pub_thread %u/%u B", stack_used(pub_thread_tid), pub_thread_tid->stack_size);
+    }
+    if (sample_thread_tid)
+    {
+        rt_kprintf(", smp_thread %u/%u B", stack_used(sample_thread_tid), sample_thread_tid->stack_size);
+    }
+    rt_kprintf("\n");
+}
+MSH_CMD_EXPORT(mqtt_stats, MQTT client latency rate heap and stack statistics);
+
 static void mqtt_ctrl(uint8_t argc, char **argv)
 {
     if (argc >= 2)
@@ -272,6 +813,30 @@ static void mqtt_ctrl(uint8_t argc, char **argv)
         {
             mqtt_client_stop();
         }
+        else if (!strcmp(argv[1], "status"))
+        {
+            mqtt_client_status();
+        }
+        else if (!strcmp(argv[1], "encoding"))
+        {
+            enum sample_encoding enc = argc >= 3 ? sample_encoding_parse(argv[2]) : pub_encoding;
+
+            if (enc == SAMPLE_ENC_MAX)
+            {
+                rt_kprintf("unknown encoding '%s', use json, cbor or packed\n", argv[2]);
+                return;
+            }
+            pub_encoding = enc;
+            rt_kprintf("payload encoding: %s\n", sample_encoding_name(pub_encoding));
+        }
+        else if (!strcmp(argv[1], "bufsize"))
+        {
+            mqtt_ctrl_bufsize(argc >= 3 ? atoi(argv[2]) : 0);
+        }
+        else if (!strcmp(argv[1], "stream"))
+        {
+            mqtt_ctrl_stream(argc >= 3 ? atoi(argv[2]) : 0);
+        }
         else
         {
             rt_kprintf("Please input "CMD_INFO"\n");
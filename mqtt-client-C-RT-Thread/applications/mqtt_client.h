@@ -12,5 +12,6 @@
 
 extern void mqtt_client_start(void);
 extern void mqtt_client_stop(void);
+extern void mqtt_client_status(void);
 
 #endif /* APPLICATIONS_MQTT_CLIENT_H_ */
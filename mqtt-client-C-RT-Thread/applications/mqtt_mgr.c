@@ -0,0 +1,787 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netdb.h>
+
+#include "paho_mqtt.h"
+#include "MQTTPacket.h"
+#include "mqtt_mgr.h"
+
+#define CMD_INFO                "'mqtt_mgr <add host port [user] [pass]|del id|sub id topic|pub id|all topic msg [qos]|list>'"
+
+/* select() timeout, also bounds how late a new connection is picked up */
+#define MGR_POLL_MS             100
+#define MGR_CONNECT_TIMEOUT_MS  10000
+#define MGR_CONNACK_TIMEOUT_MS  10000
+#define MGR_BACKOFF_MIN_MS      1000
+#define MGR_BACKOFF_MAX_MS      30000
+
+enum conn_state
+{
+    CONN_FREE = 0,
+    CONN_IDLE,          /* waiting for the next connect attempt */
+    CONN_RESOLVING,     /* host name queued for the resolver thread */
+    CONN_CONNECTING,    /* non-blocking TCP connect in progress, socket in writefds */
+    CONN_WAIT_CONNACK,
+    CONN_ONLINE,
+};
+
+static const char *const state_names[] = { "free", "idle", "resolving", "connecting", "connack", "online" };
+
+struct mqtt_conn
+{
+    enum conn_state state;
+    rt_uint32_t gen;            /* bumped on add/del, detects a slot reused while connecting */
+    int sock;
+
+    char host[MQTT_MGR_HOST_LEN];
+    rt_uint16_t port;
+    struct sockaddr_in addr;    /* resolved once, reused by every reconnect */
+    rt_bool_t resolved;
+    char client_id[32];
+    char username[MQTT_MGR_CRED_LEN];
+    char password[MQTT_MGR_CRED_LEN];
+    char filter[MQTT_MGR_FILTER_LEN];
+
+    rt_uint8_t *txbuf;
+    rt_uint8_t *rxbuf;
+    rt_size_t rx_len;
+
+    rt_uint16_t next_packetid;
+    rt_bool_t ping_outstanding;
+    rt_tick_t last_tx, last_rx, ping_sent, retry_at, state_since;
+    rt_uint32_t backoff_ms;
+
+    rt_uint32_t connects, published, acked, received, oversize;
+    rt_uint32_t bytes_tx, bytes_rx;
+};
+
+static struct mqtt_conn conns[MQTT_MGR_MAX_CONN];
+static struct rt_mutex mgr_lock;
+static mqtt_mgr_msg_cb msg_cb = RT_NULL;
+
+/* one thread for all connections */
+static struct rt_thread mgr_thread;
+static rt_uint8_t mgr_stack[MQTT_MGR_STACK_SIZE];
+static rt_bool_t mgr_started = RT_FALSE;
+
+/* resolves names that failed in mqtt_mgr_add(), so DNS never blocks the select loop */
+static struct rt_thread dns_thread;
+static rt_uint8_t dns_stack[MQTT_MGR_DNS_STACK_SIZE];
+static struct rt_semaphore dns_sem;
+
+/* shared buffer pool: a tx and an rx block per connection, each with the pool's block header */
+static struct rt_mempool buf_mp;
+static rt_uint8_t buf_pool[MQTT_MGR_MAX_CONN * 2 * (MQTT_MGR_BUF_SIZE + sizeof(rt_uint8_t *))];
+
+static void conn_close(struct mqtt_conn *c)
+{
+    if (c->sock >= 0)
+    {
+        closesocket(c->sock);
+        c->sock = -1;
+    }
+    c->rx_len = 0;
+    c->ping_outstanding = RT_FALSE;
+    c->state = CONN_IDLE;
+    c->state_since = rt_tick_get();
+    c->retry_at = c->state_since + rt_tick_from_millisecond(c->backoff_ms);
+
+    c->backoff_ms *= 2;
+    if (c->backoff_ms > MGR_BACKOFF_MAX_MS)
+    {
+        c->backoff_ms = MGR_BACKOFF_MAX_MS;
+    }
+}
+
+static int conn_send(struct mqtt_conn *c, int len)
+{
+    int sent = 0, n;
+
+    if (len <= 0)
+    {
+        return -RT_ERROR;
+    }
+    while (sent < len)
+    {
+        n = send(c->sock, c->txbuf + sent, len - sent, 0);
+        if (n <= 0)
+        {
+            conn_close(c);
+            return -RT_ERROR;
+        }
+        sent += n;
+    }
+    c->bytes_tx += len;
+    c->last_tx = rt_tick_get();
+    return RT_EOK;
+}
+
+static int conn_send_subscribe(struct mqtt_conn *c)
+{
+    MQTTString topic = MQTTString_initializer;
+    int qos = 1;
+
+    topic.cstring = c->filter;
+    if (++c->next_packetid == 0)
+    {
+        c->next_packetid = 1;
+    }
+    return conn_send(c, MQTTSerialize_subscribe(c->txbuf, MQTT_MGR_BUF_SIZE, 0, c->next_packetid, 1, &topic, &qos));
+}
+
+/* blocking, so never called by the manager thread with the lock held */
+static int resolve(const char *host, rt_uint16_t port, struct sockaddr_in *addr)
+{
+    struct addrinfo hints, *res = RT_NULL;
+    char port_str[8];
+
+    rt_memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    rt_snprintf(port_str, sizeof(port_str), "%u", port);
+    if (getaddrinfo(host, port_str, &hints, &res) != 0 || res == RT_NULL)
+    {
+        return -RT_ERROR;
+    }
+    rt_memcpy(addr, res->ai_addr, sizeof(*addr));
+    freeaddrinfo(res);
+    return RT_EOK;
+}
+
+/*
+ * names that did not resolve in mqtt_mgr_add(), e.g. because the network
+ * was not up yet; getaddrinfo() runs without the lock, a slot deleted
+ * (and maybe reused) meanwhile is detected by its generation
+ */
+static void dns_thread_entry(void *parameter)
+{
+    struct sockaddr_in addr;
+    char host[MQTT_MGR_HOST_LEN];
+    struct mqtt_conn *c;
+    rt_uint16_t port;
+    rt_uint32_t gen;
+    int i, rc;
+
+    while (1)
+    {
+        rt_sem_take(&dns_sem, RT_WAITING_FOREVER);
+        for (i = 0; i < MQTT_MGR_MAX_CONN; i++)
+        {
+            c = &conns[i];
+            rt_mutex_take(&mgr_lock, RT_WAITING_FOREVER);
+            if (c->state != CONN_RESOLVING)
+            {
+                rt_mutex_release(&mgr_lock);
+                continue;
+            }
+            rt_strncpy(host, c->host, sizeof(host));
+            port = c->port;
+            gen = c->gen;
+            rt_mutex_release(&mgr_lock);
+
+            rc = resolve(host, port, &addr);
+
+            rt_mutex_take(&mgr_lock, RT_WAITING_FOREVER);
+            if (c->gen == gen && c->state == CONN_RESOLVING)
+            {
+                if (rc == RT_EOK)
+                {
+                    c->addr = addr;
+                    c->resolved = RT_TRUE;
+                    c->state = CONN_IDLE;
+                    c->retry_at = rt_tick_get();
+                }
+                else
+                {
+                    conn_close(c);
+                }
+            }
+            rt_mutex_release(&mgr_lock);
+        }
+    }
+}
+
+/* start a non-blocking connect, conn_connected() finishes it once the socket is writable */
+static void conn_connect(struct mqtt_conn *c)
+{
+    unsigned long on = 1;
+
+    if (!c->resolved)
+    {
+        c->state = CONN_RESOLVING;
+        c->state_since = rt_tick_get();
+        rt_sem_release(&dns_sem);
+        return;
+    }
+
+    c->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (c->sock < 0)
+    {
+        conn_close(c);
+        return;
+    }
+    if (ioctlsocket(c->sock, FIONBIO, &on) < 0
+            || (connect(c->sock, (struct sockaddr *) &c->addr, sizeof(c->addr)) < 0 && errno != EINPROGRESS))
+    {
+        conn_close(c);
+        return;
+    }
+    c->state = CONN_CONNECTING;
+    c->state_since = rt_tick_get();
+}
+
+static void conn_connected(struct mqtt_conn *c)
+{
+    MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+    unsigned long off = 0;
+    socklen_t len = sizeof(int);
+    int err = 0;
+
+    /* back to blocking once connected, conn_send() relies on it */
+    if (getsockopt(c->sock, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0
+            || ioctlsocket(c->sock, FIONBIO, &off) < 0)
+    {
+        conn_close(c);
+        return;
+    }
+
+    c->rx_len = 0;
+    c->last_rx = rt_tick_get();
+
+    data.clientID.cstring = c->client_id;
+    data.keepAliveInterval = MQTT_MGR_KEEPALIVE;
+    data.cleansession = 1;
+    if (c->username[0])
+    {
+        data.username.cstring = c->username;
+        data.password.cstring = c->password;
+    }
+    if (conn_send(c, MQTTSerialize_connect(c->txbuf, MQTT_MGR_BUF_SIZE, &data)) == RT_EOK)
+    {
+        c->state = CONN_WAIT_CONNACK;
+        c->state_since = rt_tick_get();
+    }
+}
+
+static void conn_handle_packet(struct mqtt_conn *c, rt_uint8_t *buf, int len)
+{
+    unsigned char session_present, connack_rc, dup, type;
+    unsigned short packetid;
+    MQTTString topic;
+    unsigned char *payload;
+    unsigned char retained;
+    int qos, payload_len;
+
+    switch (buf[0] >> 4)
+    {
+    case CONNACK:
+        if (MQTTDeserialize_connack(&session_present, &connack_rc, buf, len) != 1 || connack_rc != 0)
+        {
+            rt_kprintf("mqtt_mgr[%d]: connect refused (%d)\n", (int) (c - conns), connack_rc);
+            conn_close(c);
+            return;
+        }
+        c->state = CONN_ONLINE;
+        c->state_since = rt_tick_get();
+        c->connects++;
+        c->backoff_ms = MGR_BACKOFF_MIN_MS;
+        if (c->filter[0])
+        {
+            conn_send_subscribe(c);
+        }
+        break;
+
+    case PUBLISH:
+        if (MQTTDeserialize_publish(&dup, &qos, &retained, &packetid, &topic, &payload,
+                &payload_len, buf, len) != 1)
+        {
+            break;
+        }
+        c->received++;
+        if (msg_cb)
+        {
+            msg_cb((int) (c - conns), topic.lenstring.data, topic.lenstring.len, payload, payload_len);
+        }
+        if (qos == 1)
+        {
+            conn_send(c, MQTTSerialize_puback(c->txbuf, MQTT_MGR_BUF_SIZE, packetid));
+        }
+        else if (qos == 2)
+        {
+            conn_send(c, MQTTSerialize_ack(c->txbuf, MQTT_MGR_BUF_SIZE, PUBREC, 0, packetid));
+        }
+        break;
+
+    case PUBREL:
+        if (MQTTDeserialize_ack(&type, &dup, &packetid, buf, len) == 1)
+        {
+            conn_send(c, MQTTSerialize_pubcomp(c->txbuf, MQTT_MGR_BUF_SIZE, packetid));
+        }
+        break;
+
+    case PUBACK:
+        c->acked++;
+        break;
+
+    default:
+        /* SUBACK, PINGRESP: any packet proves the link is alive */
+        break;
+    }
+}
+
+static void conn_read(struct mqtt_conn *c)
+{
+    rt_size_t pos = 0, rl, hl;
+    rt_uint8_t b;
+    int n;
+
+    n = recv(c->sock, c->rxbuf + c->rx_len, MQTT_MGR_BUF_SIZE - c->rx_len, 0);
+    if (n <= 0)
+    {
+        conn_close(c);
+        return;
+    }
+    c->rx_len += n;
+    c->bytes_rx += n;
+    c->last_rx = rt_tick_get();
+    c->ping_outstanding = RT_FALSE;
+
+    while (c->rx_len - pos >= 2)
+    {
+        /* remaining length, variable byte integer of up to 4 bytes */
+        rl = 0;
+        hl = 1;
+        do
+        {
+            if (pos + hl >= c->rx_len)
+            {
+                goto _need_more;
+            }
+            b = c->rxbuf[pos + hl];
+            rl |= (rt_size_t) (b & 0x7F) << (7 * (hl - 1));
+            hl++;
+        } while ((b & 0x80) && hl <= 4);
+
+        if (hl + rl > MQTT_MGR_BUF_SIZE)
+        {
+            /* cannot be buffered, drop the connection rather than desynchronize */
+            c->oversize++;
+            conn_close(c);
+            return;
+        }
+        if (pos + hl + rl > c->rx_len)
+        {
+            break;
+        }
+
+        conn_handle_packet(c, c->rxbuf + pos, hl + rl);
+        if (c->sock < 0)
+        {
+            return;
+        }
+        pos += hl + rl;
+    }
+
+_need_more:
+    rt_memmove(c->rxbuf, c->rxbuf + pos, c->rx_len - pos);
+    c->rx_len -= pos;
+}
+
+static void conn_timers(struct mqtt_conn *c, rt_tick_t now)
+{
+    rt_tick_t keepalive = rt_tick_from_millisecond(MQTT_MGR_KEEPALIVE * 1000);
+
+    if (c->state == CONN_CONNECTING && now - c->state_since >= rt_tick_from_millisecond(MGR_CONNECT_TIMEOUT_MS))
+    {
+        conn_close(c);
+    }
+    else if (c->state == CONN_WAIT_CONNACK && now - c->state_since >= rt_tick_from_millisecond(MGR_CONNACK_TIMEOUT_MS))
+    {
+        conn_close(c);
+    }
+    else if (c->state == CONN_ONLINE)
+    {
+        /* timed from the PINGREQ, last_rx may be older than keepalive on an idle link */
+        if (c->ping_outstanding && now - c->ping_sent >= keepalive)
+        {
+            conn_close(c);
+        }
+        else if (!c->ping_outstanding && now - c->last_tx >= keepalive / 2)
+        {
+            if (conn_send(c, MQTTSerialize_pingreq(c->txbuf, MQTT_MGR_BUF_SIZE)) == RT_EOK)
+            {
+                c->ping_outstanding = RT_TRUE;
+                c->ping_sent = now;
+            }
+        }
+    }
+}
+
+static void mgr_thread_entry(void *parameter)
+{
+    /* sockets handed to select(), a connection may be closed and reopened meanwhile */
+    int polled[MQTT_MGR_MAX_CONN];
+    struct mqtt_conn *c;
+    struct timeval tv;
+    fd_set rfds, wfds;
+    rt_tick_t now;
+    int i, maxfd;
+
+    while (1)
+    {
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        maxfd = -1;
+
+        rt_mutex_take(&mgr_lock, RT_WAITING_FOREVER);
+        for (i = 0; i < MQTT_MGR_MAX_CONN; i++)
+        {
+            c = &conns[i];
+            polled[i] = -1;
+            if (c->state == CONN_IDLE && (rt_int32_t) (rt_tick_get() - c->retry_at) >= 0)
+            {
+                conn_connect(c);
+            }
+            if (c->state == CONN_CONNECTING || c->state == CONN_WAIT_CONNACK || c->state == CONN_ONLINE)
+            {
+                polled[i] = c->sock;
+                /* a pending connect reports completion or failure as writable */
+                FD_SET(c->sock, c->state == CONN_CONNECTING ? &wfds : &rfds);
+                if (c->sock > maxfd)
+                {
+                    maxfd = c->sock;
+                }
+            }
+        }
+        rt_mutex_release(&mgr_lock);
+
+        if (maxfd < 0)
+        {
+            rt_thread_mdelay(MGR_POLL_MS);
+            continue;
+        }
+
+        tv.tv_sec = 0;
+        tv.tv_usec = MGR_POLL_MS * 1000;
+        if (select(maxfd + 1, &rfds, &wfds, RT_NULL, &tv) < 0)
+        {
+            FD_ZERO(&rfds);
+            FD_ZERO(&wfds);
+        }
+
+        rt_mutex_take(&mgr_lock, RT_WAITING_FOREVER);
+        now = rt_tick_get();
+        for (i = 0; i < MQTT_MGR_MAX_CONN; i++)
+        {
+            c = &conns[i];
+            if (polled[i] >= 0 && c->sock == polled[i])
+            {
+                if (c->state == CONN_CONNECTING && FD_ISSET(c->sock, &wfds))
+                {
+                    conn_connected(c);
+                }
+                else if (FD_ISSET(c->sock, &rfds))
+                {
+                    conn_read(c);
+                }
+            }
+            conn_timers(c, now);
+        }
+        rt_mutex_release(&mgr_lock);
+    }
+}
+
+static int mgr_init(void)
+{
+    if (mgr_started)
+    {
+        return RT_EOK;
+    }
+
+    rt_mutex_init(&mgr_lock, "mqtt_mgr", RT_IPC_FLAG_FIFO);
+    rt_mp_init(&buf_mp, "mgr_buf", buf_pool, sizeof(buf_pool), MQTT_MGR_BUF_SIZE);
+    rt_sem_init(&dns_sem, "mgr_dns", 0, RT_IPC_FLAG_FIFO);
+    if (rt_thread_init(&mgr_thread, "mqtt_mgr", mgr_thread_entry, RT_NULL, mgr_stack, sizeof(mgr_stack), 9, 20)
+            != RT_EOK
+            || rt_thread_init(&dns_thread, "mgr_dns", dns_thread_entry, RT_NULL, dns_stack, sizeof(dns_stack), 10, 20)
+            != RT_EOK)
+    {
+        return -RT_ERROR;
+    }
+    rt_thread_startup(&mgr_thread);
+    rt_thread_startup(&dns_thread);
+    mgr_started = RT_TRUE;
+    return RT_EOK;
+}
+
+int mqtt_mgr_add(const char *host, rt_uint16_t port, const char *username, const char *password)
+{
+    struct mqtt_conn *c = RT_NULL;
+    struct sockaddr_in addr;
+    rt_bool_t resolved;
+    int i;
+
+    if (mgr_init() != RT_EOK)
+    {
+        return -RT_ERROR;
+    }
+
+    /* resolve in the caller's thread, the manager thread must not block on DNS */
+    resolved = resolve(host, port, &addr) == RT_EOK;
+
+    rt_mutex_take(&mgr_lock, RT_WAITING_FOREVER);
+    for (i = 0; i < MQTT_MGR_MAX_CONN; i++)
+    {
+        if (conns[i].state == CONN_FREE)
+        {
+            c = &conns[i];
+            break;
+        }
+    }
+    if (c == RT_NULL)
+    {
+        rt_mutex_release(&mgr_lock);
+        return -RT_EFULL;
+    }
+
+    i = c->gen;
+    rt_memset(c, 0, sizeof(*c));
+    c->gen = i + 1;
+    c->sock = -1;
+    rt_strncpy(c->host, host, sizeof(c->host) - 1);
+    c->port = port;
+    if (resolved)
+    {
+        c->addr = addr;
+        c->resolved = RT_TRUE;
+    }
+    rt_snprintf(c->client_id, sizeof(c->client_id), "rtthread-mgr%d-%d", (int) (c - conns), rt_tick_get());
+    if (username)
+    {
+        rt_strncpy(c->username, username, sizeof(c->username) - 1);
+    }
+    if (password)
+    {
+        rt_strncpy(c->password, password, sizeof(c->password) - 1);
+    }
+    c->txbuf = rt_mp_alloc(&buf_mp, RT_WAITING_NO);
+    c->rxbuf = rt_mp_alloc(&buf_mp, RT_WAITING_NO);
+    c->backoff_ms = MGR_BACKOFF_MIN_MS;
+    c->retry_at = rt_tick_get();
+    c->state = CONN_IDLE;
+    rt_mutex_release(&mgr_lock);
+
+    return (int) (c - conns);
+}
+
+int mqtt_mgr_del(int id)
+{
+    struct mqtt_conn *c;
+
+    if (id < 0 || id >= MQTT_MGR_MAX_CONN || !mgr_started)
+    {
+        return -RT_ERROR;
+    }
+
+    rt_mutex_take(&mgr_lock, RT_WAITING_FOREVER);
+    c = &conns[id];
+    if (c->state == CONN_FREE)
+    {
+        rt_mutex_release(&mgr_lock);
+        return -RT_ERROR;
+    }
+    if (c->state == CONN_ONLINE)
+    {
+        conn_send(c, MQTTSerialize_disconnect(c->txbuf, MQTT_MGR_BUF_SIZE));
+    }
+    if (c->sock >= 0)
+    {
+        closesocket(c->sock);
+        c->sock = -1;
+    }
+    rt_mp_free(c->txbuf);
+    rt_mp_free(c->rxbuf);
+    c->txbuf = c->rxbuf = RT_NULL;
+    c->gen++;
+    c->state = CONN_FREE;
+    rt_mutex_release(&mgr_lock);
+
+    return RT_EOK;
+}
+
+int mqtt_mgr_subscribe(int id, const char *filter)
+{
+    struct mqtt_conn *c;
+    int rc = RT_EOK;
+
+    if (id < 0 || id >= MQTT_MGR_MAX_CONN || !mgr_started)
+    {
+        return -RT_ERROR;
+    }
+
+    rt_mutex_take(&mgr_lock, RT_WAITING_FOREVER);
+    c = &conns[id];
+    if (c->state == CONN_FREE)
+    {
+        rc = -RT_ERROR;
+    }
+    else
+    {
+        rt_strncpy(c->filter, filter, sizeof(c->filter) - 1);
+        if (c->state == CONN_ONLINE)
+        {
+            rc = conn_send_subscribe(c);
+        }
+    }
+    rt_mutex_release(&mgr_lock);
+
+    return rc;
+}
+
+int mqtt_mgr_publish(int id, const char *topic, const void *payload, rt_size_t len, int qos)
+{
+    MQTTString topic_str = MQTTString_initializer;
+    struct mqtt_conn *c;
+    int rc = -RT_ERROR;
+
+    if (id < 0 || id >= MQTT_MGR_MAX_CONN || !mgr_started)
+    {
+        return -RT_ERROR;
+    }
+
+    topic_str.cstring = (char *) topic;
+    qos = qos > 0 ? 1 : 0;
+
+    rt_mutex_take(&mgr_lock, RT_WAITING_FOREVER);
+    c = &conns[id];
+    if (c->state == CONN_ONLINE)
+    {
+        if (qos && ++c->next_packetid == 0)
+        {
+            c->next_packetid = 1;
+        }
+        rc = conn_send(c, MQTTSerialize_publish(c->txbuf, MQTT_MGR_BUF_SIZE, 0, qos, 0, c->next_packetid, topic_str,
+                (unsigned char *) payload, len));
+        if (rc == RT_EOK)
+        {
+            c->published++;
+        }
+    }
+    rt_mutex_release(&mgr_lock);
+
+    return rc;
+}
+
+void mqtt_mgr_set_callback(mqtt_mgr_msg_cb cb)
+{
+    msg_cb = cb;
+}
+
+static void mgr_print_msg(int id, const char *topic, int topic_len, const void *payload, rt_size_t len)
+{
+    rt_kprintf("mqtt_mgr[%d] %.*s: %.*s\n", id, topic_len, topic, (int) len, (const char *) payload);
+}
+
+static void mgr_list(void)
+{
+    rt_uint32_t per_conn = sizeof(struct mqtt_conn) + 2 * (MQTT_MGR_BUF_SIZE + sizeof(rt_uint8_t *));
+    rt_tick_t now = rt_tick_get();
+    struct mqtt_conn *c;
+    int i, used = 0;
+
+    if (mgr_started)
+    {
+        rt_mutex_take(&mgr_lock, RT_WAITING_FOREVER);
+    }
+    for (i = 0; i < MQTT_MGR_MAX_CONN; i++)
+    {
+        c = &conns[i];
+        if (c->state == CONN_FREE)
+        {
+            continue;
+        }
+        used++;
+        rt_kprintf("[%d] %s:%u %s for %u s, pub: %u, ack: %u, recv: %u, tx: %u B, rx: %u B, reconnects: %u%s\n", i,
+                c->host, c->port, state_names[c->state], (now - c->state_since) / RT_TICK_PER_SECOND, c->published,
+                c->acked, c->received, c->bytes_tx, c->bytes_rx, c->connects ? c->connects - 1 : 0, c->oversize ? ", oversize drops" : "");
+    }
+    if (mgr_started)
+    {
+        rt_mutex_release(&mgr_lock);
+    }
+
+    rt_kprintf("connections: %d/%d, RAM per connection: %u B (state %u B + 2 x %u B buffers)\n", used,
+            MQTT_MGR_MAX_CONN, per_conn, (rt_uint32_t) sizeof(struct mqtt_conn), MQTT_MGR_BUF_SIZE);
+    rt_kprintf("shared: thread stack %u B, resolver stack %u B, total static %u B\n", MQTT_MGR_STACK_SIZE,
+            MQTT_MGR_DNS_STACK_SIZE, (rt_uint32_t) (sizeof(conns) + sizeof(buf_pool) + sizeof(mgr_stack)
+            + sizeof(mgr_thread) + sizeof(dns_stack) + sizeof(dns_thread)));
+}
+
+static void mqtt_mgr(uint8_t argc, char **argv)
+{
+    int id, rc, i;
+
+    if (argc >= 4 && !strcmp(argv[1], "add"))
+    {
+        if (msg_cb == RT_NULL)
+        {
+            mqtt_mgr_set_callback(mgr_print_msg);
+        }
+        id = mqtt_mgr_add(argv[2], atoi(argv[3]), argc >= 5 ? argv[4] : RT_NULL, argc >= 6 ? argv[5] : RT_NULL);
+        if (id < 0)
+        {
+            rt_kprintf("no free connection slot\n");
+        }
+        else
+        {
+            rt_kprintf("connection %d added\n", id);
+        }
+    }
+    else if (argc >= 3 && !strcmp(argv[1], "del"))
+    {
+        rc = mqtt_mgr_del(atoi(argv[2]));
+        rt_kprintf("%s\n", rc == RT_EOK ? "deleted" : "no such connection");
+    }
+    else if (argc >= 4 && !strcmp(argv[1], "sub"))
+    {
+        rc = mqtt_mgr_subscribe(atoi(argv[2]), argv[3]);
+        rt_kprintf("%s\n", rc == RT_EOK ? "subscribed" : "subscribe failed");
+    }
+    else if (argc >= 5 && !strcmp(argv[1], "pub"))
+    {
+        int qos = argc >= 6 ? atoi(argv[5]) : 0;
+
+        if (!strcmp(argv[2], "all"))
+        {
+            for (i = 0, rc = 0; i < MQTT_MGR_MAX_CONN; i++)
+            {
+                rc += mqtt_mgr_publish(i, argv[3], argv[4], rt_strlen(argv[4]), qos) == RT_EOK;
+            }
+            rt_kprintf("published on %d connections\n", rc);
+        }
+        else
+        {
+            rc = mqtt_mgr_publish(atoi(argv[2]), argv[3], argv[4], rt_strlen(argv[4]), qos);
+            rt_kprintf("%s\n", rc == RT_EOK ? "published" : "connection not online");
+        }
+    }
+    else if (argc >= 2 && !strcmp(argv[1], "list"))
+    {
+        mgr_list();
+    }
+    else
+    {
+        rt_kprintf("Please input "CMD_INFO"\n");
+    }
+}
+MSH_CMD_EXPORT(mqtt_mgr, MQTT connection manager CMD_INFO);
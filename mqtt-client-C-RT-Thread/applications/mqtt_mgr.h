@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef APPLICATIONS_MQTT_MGR_H_
+#define APPLICATIONS_MQTT_MGR_H_
+
+#include <rtthread.h>
+
+/*
+ * Connection manager for gateways talking to several brokers or tenants.
+ *
+ * Unlike paho_mqtt_start(), which creates one thread per client, all
+ * connections are served by a single statically allocated thread running
+ * one select() loop; a second small thread only resolves host names that
+ * did not resolve when the connection was added. Client buffers come from a shared, statically sized
+ * memory pool, so the RAM cost of every extra connection is fixed and
+ * known at build time. Connections are plain TCP, QoS 0 and 1.
+ */
+
+#define MQTT_MGR_MAX_CONN       4
+#define MQTT_MGR_BUF_SIZE       1024
+#define MQTT_MGR_STACK_SIZE     2048
+/* resolver thread for names not resolvable when the connection was added */
+#define MQTT_MGR_DNS_STACK_SIZE 1536
+#define MQTT_MGR_KEEPALIVE      60
+#define MQTT_MGR_HOST_LEN       64
+#define MQTT_MGR_CRED_LEN       32
+#define MQTT_MGR_FILTER_LEN     64
+
+/* called from the manager thread for every received PUBLISH */
+typedef void (*mqtt_mgr_msg_cb)(int id, const char *topic, int topic_len, const void *payload, rt_size_t len);
+
+/**
+ * Add a connection, the manager connects and reconnects it in the background.
+ *
+ * @return connection id, or -RT_EFULL if all slots are in use
+ */
+int mqtt_mgr_add(const char *host, rt_uint16_t port, const char *username, const char *password);
+
+int mqtt_mgr_del(int id);
+
+/**
+ * Set the topic filter of a connection, (re)subscribed on every connect.
+ */
+int mqtt_mgr_subscribe(int id, const char *filter);
+
+/**
+ * Publish on one connection, qos is 0 or 1.
+ *
+ * @return RT_EOK, or -RT_ERROR if the connection is not online
+ */
+int mqtt_mgr_publish(int id, const char *topic, const void *payload, rt_size_t len, int qos);
+
+void mqtt_mgr_set_callback(mqtt_mgr_msg_cb cb);
+
+#endif /* APPLICATIONS_MQTT_MGR_H_ */
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <string.h>
+
+#include "msg_stream.h"
+
+/* MQTT PUBLISH overhead besides the topic: fixed header + topic length + packet id */
+#define PUBLISH_OVERHEAD        (5 + 2 + 2)
+
+static msg_stream_sink_t stream_sink = RT_NULL;
+
+/* receiver state of the message in progress */
+static rt_bool_t rx_active = RT_FALSE;
+static rt_uint16_t rx_id = 0;
+static rt_uint32_t rx_next = 0;
+static rt_bool_t rx_bad = RT_FALSE;
+
+static rt_uint16_t tx_id = 0;
+
+static struct msg_stream_stats stats;
+
+static rt_uint8_t pattern_byte(rt_uint16_t id, rt_uint32_t offset)
+{
+    return (rt_uint8_t) (offset * 31 + id);
+}
+
+static void verify_sink(rt_uint16_t id, rt_uint32_t offset, const rt_uint8_t *data, rt_size_t len, rt_bool_t last)
+{
+    rt_size_t i;
+
+    for (i = 0; i < len && !rx_bad; i++)
+    {
+        rx_bad = data[i] != pattern_byte(id, offset + i);
+    }
+    if (last && rx_bad)
+    {
+        stats.corrupted++;
+    }
+}
+
+void msg_stream_set_sink(msg_stream_sink_t sink)
+{
+    stream_sink = sink;
+}
+
+rt_bool_t msg_stream_feed(const void *payload, rt_size_t len)
+{
+    const rt_uint8_t *p = payload;
+    rt_uint16_t id;
+    rt_uint32_t offset;
+    rt_bool_t last;
+
+    if (len < MSG_STREAM_HDR_SIZE || p[0] != MSG_STREAM_MAGIC)
+    {
+        return RT_FALSE;
+    }
+
+    last = (p[1] & MSG_STREAM_FLAG_LAST) != 0;
+    id = (p[2] << 8) | p[3];
+    offset = ((rt_uint32_t) p[4] << 24) | ((rt_uint32_t) p[5] << 16) | (p[6] << 8) | p[7];
+
+    if (offset == 0)
+    {
+        if (rx_active)
+        {
+            /* a new message started before the previous one ended */
+            stats.aborted++;
+        }
+        rx_active = RT_TRUE;
+        rx_id = id;
+        rx_next = 0;
+        rx_bad = RT_FALSE;
+    }
+    else if (!rx_active || id != rx_id || offset != rx_next)
+    {
+        if (rx_active)
+        {
+            stats.aborted++;
+            rx_active = RT_FALSE;
+        }
+        return RT_TRUE;
+    }
+
+    len -= MSG_STREAM_HDR_SIZE;
+    (stream_sink ? stream_sink : verify_sink)(id, offset, p + MSG_STREAM_HDR_SIZE, len, last);
+
+    stats.chunks++;
+    stats.bytes += len;
+    rx_next = offset + len;
+    if (last)
+    {
+        stats.completed++;
+        if (rx_next > stats.largest)
+        {
+            stats.largest = rx_next;
+        }
+        rx_active = RT_FALSE;
+    }
+    return RT_TRUE;
+}
+
+int msg_stream_publish_test(MQTTClient *c, const char *topic, rt_uint32_t total)
+{
+    MQTTMessage message;
+    rt_uint32_t offset = 0, i;
+    rt_size_t chunk, n;
+    rt_uint8_t *buf;
+    int rc = RT_EOK;
+
+    if (c->buf_size <= PUBLISH_OVERHEAD + rt_strlen(topic) + MSG_STREAM_HDR_SIZE)
+    {
+        return -RT_ERROR;
+    }
+    chunk = c->buf_size - PUBLISH_OVERHEAD - rt_strlen(topic) - MSG_STREAM_HDR_SIZE;
+
+    buf = rt_malloc(MSG_STREAM_HDR_SIZE + chunk);
+    if (buf == RT_NULL)
+    {
+        return -RT_ENOMEM;
+    }
+
+    tx_id++;
+    do
+    {
+        n = total - offset < chunk ? total - offset : chunk;
+
+        buf[0] = MSG_STREAM_MAGIC;
+        buf[1] = offset + n == total ? MSG_STREAM_FLAG_LAST : 0;
+        buf[2] = tx_id >> 8;
+        buf[3] = tx_id;
+        buf[4] = offset >> 24;
+        buf[5] = offset >> 16;
+        buf[6] = offset >> 8;
+        buf[7] = offset;
+        for (i = 0; i < n; i++)
+        {
+            buf[MSG_STREAM_HDR_SIZE + i] = pattern_byte(tx_id, offset + i);
+        }
+
+        rt_memset(&message, 0, sizeof(message));
+        message.qos = QOS1;
+        message.payload = buf;
+        message.payloadlen = MSG_STREAM_HDR_SIZE + n;
+        if (MQTTPublish(c, topic, &message) != 0)
+        {
+            rc = -RT_ERROR;
+            break;
+        }
+        offset += n;
+    } while (offset < total);
+
+    rt_free(buf);
+    return rc;
+}
+
+void msg_stream_stats_get(struct msg_stream_stats *st)
+{
+    *st = stats;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef APPLICATIONS_MSG_STREAM_H_
+#define APPLICATIONS_MSG_STREAM_H_
+
+#include <rtthread.h>
+#include "paho_mqtt.h"
+
+/*
+ * Messages larger than the paho read buffer are sent as a sequence of
+ * chunks on the same topic. Each chunk starts with an 8-byte header:
+ *
+ *   magic(1) = 0xCB, flags(1), message id(2), offset(4), all big-endian
+ *
+ * and MSG_STREAM_FLAG_LAST marks the final chunk. The receiver hands each
+ * chunk to a sink as it arrives, so the whole message is never buffered.
+ * MQTT keeps chunks of one publisher on one topic in order, a gap in the
+ * offsets aborts the message.
+ */
+
+#define MSG_STREAM_MAGIC        0xCB
+#define MSG_STREAM_HDR_SIZE     8
+#define MSG_STREAM_FLAG_LAST    0x01
+
+/* called for every chunk in order, data points into the paho read buffer */
+typedef void (*msg_stream_sink_t)(rt_uint16_t id, rt_uint32_t offset, const rt_uint8_t *data, rt_size_t len,
+        rt_bool_t last);
+
+struct msg_stream_stats
+{
+    rt_uint32_t completed;      /* messages received up to the last chunk */
+    rt_uint32_t aborted;        /* messages with missing chunks */
+    rt_uint32_t corrupted;      /* self-test messages with unexpected content */
+    rt_uint32_t chunks;
+    rt_uint32_t largest;        /* largest completed message, in bytes */
+    rt_uint64_t bytes;
+};
+
+/**
+ * Replace the sink, RT_NULL restores the built-in self-test verifier.
+ */
+void msg_stream_set_sink(msg_stream_sink_t sink);
+
+/**
+ * Offer a received payload to the stream receiver.
+ *
+ * @return RT_TRUE if the payload was a chunk and has been consumed
+ */
+rt_bool_t msg_stream_feed(const void *payload, rt_size_t len);
+
+/**
+ * Publish a self-test message of total bytes in chunks that fit the
+ * client write buffer. The content is a pattern checked by the built-in
+ * verifier, so publishing to a subscribed topic tests the full path.
+ *
+ * @return RT_EOK or -RT_ERROR
+ */
+int msg_stream_publish_test(MQTTClient *c, const char *topic, rt_uint32_t total);
+
+void msg_stream_stats_get(struct msg_stream_stats *stats);
+
+#endif /* APPLICATIONS_MSG_STREAM_H_ */
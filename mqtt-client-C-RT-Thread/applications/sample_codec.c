@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "sample_codec.h"
+
+#define CBOR_MAJOR_UINT     0x00
+#define CBOR_MAJOR_ARRAY    0x80
+#define CBOR_FLOAT32        0xFA
+
+static const char *const encoding_names[SAMPLE_ENC_MAX] = { "json", "cbor", "packed" };
+
+static rt_uint8_t *put_be16(rt_uint8_t *p, rt_uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+    return p + 2;
+}
+
+static rt_uint8_t *put_be32(rt_uint8_t *p, rt_uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+    return p + 4;
+}
+
+/* CBOR head with the shortest argument encoding */
+static rt_uint8_t *cbor_put_head(rt_uint8_t *p, rt_uint8_t major, rt_uint32_t v)
+{
+    if (v < 24)
+    {
+        *p++ = major | v;
+    }
+    else if (v <= 0xFF)
+    {
+        *p++ = major | 24;
+        *p++ = v;
+    }
+    else if (v <= 0xFFFF)
+    {
+        *p++ = major | 25;
+        p = put_be16(p, v);
+    }
+    else
+    {
+        *p++ = major | 26;
+        p = put_be32(p, v);
+    }
+    return p;
+}
+
+static rt_uint8_t *cbor_put_float(rt_uint8_t *p, float f)
+{
+    rt_uint32_t bits;
+
+    memcpy(&bits, &f, sizeof(bits));
+    *p++ = CBOR_FLOAT32;
+    return put_be32(p, bits);
+}
+
+/* round to 0.01 fixed point, saturating at the int16 range */
+static rt_uint16_t to_centi(float f)
+{
+    float v = f * 100.0f;
+
+    if (v >= 32767.0f)
+    {
+        return 32767;
+    }
+    if (v <= -32768.0f)
+    {
+        return (rt_uint16_t) -32768;
+    }
+    return (rt_uint16_t) (rt_int16_t) (v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+rt_size_t sample_encode(enum sample_encoding enc, const struct sample *smp, rt_uint8_t *buf, rt_size_t size)
+{
+    rt_uint8_t *p = buf;
+    int len;
+
+    switch (enc)
+    {
+    case SAMPLE_ENC_JSON:
+        len = snprintf((char *) buf, size, "{\n"
+                "  \"seq\": \"%u\",\n"
+                "  \"time\": \"%ld\", \n"
+                "  \"humidity\": \"%.2f\",\n"
+                "  \"temperature\": \"%.2f\"\n"
+                "}", smp->seq, (long) smp->time, smp->humidity, smp->temperature);
+        return (len > 0 && (rt_size_t) len < size) ? (rt_size_t) len : 0;
+
+    case SAMPLE_ENC_CBOR:
+        if (size < SAMPLE_CBOR_MAX_SIZE)
+        {
+            return 0;
+        }
+        p = cbor_put_head(p, CBOR_MAJOR_ARRAY, 5);
+        p = cbor_put_head(p, CBOR_MAJOR_UINT, SAMPLE_CODEC_VERSION);
+        p = cbor_put_head(p, CBOR_MAJOR_UINT, smp->seq);
+        p = cbor_put_head(p, CBOR_MAJOR_UINT, (rt_uint32_t) smp->time);
+        p = cbor_put_float(p, smp->humidity);
+        p = cbor_put_float(p, smp->temperature);
+        return p - buf;
+
+    case SAMPLE_ENC_PACKED:
+        if (size < SAMPLE_PACKED_SIZE)
+        {
+            return 0;
+        }
+        *p++ = SAMPLE_CODEC_VERSION;
+        p = put_be32(p, smp->seq);
+        p = put_be32(p, (rt_uint32_t) smp->time);
+        p = put_be16(p, to_centi(smp->humidity));
+        p = put_be16(p, to_centi(smp->temperature));
+        return p - buf;
+
+    default:
+        return 0;
+    }
+}
+
+const char *sample_encoding_name(enum sample_encoding enc)
+{
+    return enc < SAMPLE_ENC_MAX ? encoding_names[enc] : "unknown";
+}
+
+enum sample_encoding sample_encoding_parse(const char *name)
+{
+    int i;
+
+    for (i = 0; i < SAMPLE_ENC_MAX; i++)
+    {
+        if (!strcmp(name, encoding_names[i]))
+        {
+            return (enum sample_encoding) i;
+        }
+    }
+    return SAMPLE_ENC_MAX;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef APPLICATIONS_SAMPLE_CODEC_H_
+#define APPLICATIONS_SAMPLE_CODEC_H_
+
+#include <rtthread.h>
+#include <time.h>
+
+/* version byte of the compact formats, bump on layout change */
+#define SAMPLE_CODEC_VERSION    1
+
+/* size of SAMPLE_ENC_PACKED output */
+#define SAMPLE_PACKED_SIZE      13
+/* worst-case size of SAMPLE_ENC_CBOR output */
+#define SAMPLE_CBOR_MAX_SIZE    22
+
+/* one fixed-size binary sample, encoded only by the publisher */
+struct sample
+{
+    rt_uint32_t seq;
+    rt_uint32_t tick;
+    time_t time;
+    float humidity;
+    float temperature;
+};
+
+enum sample_encoding
+{
+    /* pretty-printed JSON text, formatted by snprintf */
+    SAMPLE_ENC_JSON = 0,
+    /*
+     * CBOR array: [version, seq, time, humidity, temperature],
+     * integers as unsigned ints, floats as single precision
+     */
+    SAMPLE_ENC_CBOR,
+    /*
+     * packed big-endian struct:
+     * version(1) seq(4) time(4) humidity(2) temperature(2),
+     * humidity and temperature as signed 0.01 fixed point
+     */
+    SAMPLE_ENC_PACKED,
+    SAMPLE_ENC_MAX
+};
+
+/**
+ * Encode one sample into buf.
+ *
+ * @return encoded length, 0 if buf is too small
+ */
+rt_size_t sample_encode(enum sample_encoding enc, const struct sample *smp, rt_uint8_t *buf, rt_size_t size);
+
+const char *sample_encoding_name(enum sample_encoding enc);
+
+/**
+ * @return encoding matching name, SAMPLE_ENC_MAX if unknown
+ */
+enum sample_encoding sample_encoding_parse(const char *name);
+
+#endif /* APPLICATIONS_SAMPLE_CODEC_H_ */
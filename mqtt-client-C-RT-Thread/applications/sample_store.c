@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <dfs_posix.h>
+#include "sample_store.h"
+
+#define RECORD_SIZE     sizeof(struct sample)
+
+static rt_bool_t store_ready = RT_FALSE;
+
+/* oldest segment id and the segment being appended to */
+static rt_uint32_t seg_head = 0, seg_tail = 0;
+/* records already in the tail segment file */
+static rt_uint32_t tail_records = 0;
+/* records queued in files, not yet drained */
+static rt_uint32_t file_depth = 0;
+
+/* samples waiting for the next batch append, batch_pos is the read index */
+static struct sample batch[SAMPLE_STORE_BATCH];
+static rt_uint32_t batch_count = 0, batch_pos = 0;
+
+/* read-ahead cache of the head segment */
+static int read_fd = -1;
+static struct sample read_cache[SAMPLE_STORE_BATCH];
+static rt_uint32_t read_count = 0, read_pos = 0;
+static rt_bool_t head_in_file = RT_FALSE;
+
+static struct sample_store_stats stats;
+
+static void seg_path(char *path, rt_size_t size, rt_uint32_t id)
+{
+    rt_snprintf(path, size, SAMPLE_STORE_DIR "/%08x.q", id);
+}
+
+static rt_uint32_t seg_records(rt_uint32_t id)
+{
+    struct stat st;
+    char path[32];
+
+    seg_path(path, sizeof(path), id);
+    if (stat(path, &st) < 0)
+    {
+        return 0;
+    }
+    return st.st_size / RECORD_SIZE;
+}
+
+static void read_close(void)
+{
+    if (read_fd >= 0)
+    {
+        close(read_fd);
+        read_fd = -1;
+    }
+    read_count = read_pos = 0;
+}
+
+/* unlink the head segment, counting whatever was left in it as dropped */
+static void seg_drop_head(rt_uint32_t remaining)
+{
+    char path[32];
+
+    read_close();
+    seg_path(path, sizeof(path), seg_head);
+    unlink(path);
+    seg_head++;
+    file_depth -= remaining;
+    stats.dropped += remaining;
+}
+
+int sample_store_init(void)
+{
+    struct dirent *ent;
+    rt_uint32_t id, lo = 0, hi = 0;
+    rt_bool_t found = RT_FALSE;
+    DIR *dir;
+
+    mkdir(SAMPLE_STORE_DIR, 0);
+    dir = opendir(SAMPLE_STORE_DIR);
+    if (dir == RT_NULL)
+    {
+        store_ready = RT_FALSE;
+        return -RT_ERROR;
+    }
+
+    while ((ent = readdir(dir)) != RT_NULL)
+    {
+        if (rt_strlen(ent->d_name) != 10 || strcmp(ent->d_name + 8, ".q"))
+        {
+            continue;
+        }
+        id = strtoul(ent->d_name, RT_NULL, 16);
+        if (!found || id < lo)
+        {
+            lo = id;
+        }
+        if (!found || id > hi)
+        {
+            hi = id;
+        }
+        found = RT_TRUE;
+    }
+    closedir(dir);
+
+    read_close();
+    file_depth = 0;
+    if (found)
+    {
+        seg_head = lo;
+        for (id = lo; id != hi + 1; id++)
+        {
+            file_depth += seg_records(id);
+        }
+        /* always append to a fresh segment, a torn record may end the last one */
+        seg_tail = hi + 1;
+    }
+    else
+    {
+        seg_head = seg_tail = 0;
+    }
+    tail_records = 0;
+    head_in_file = file_depth > 0;
+    store_ready = RT_TRUE;
+
+    return RT_EOK;
+}
+
+int sample_store_flush(void)
+{
+    rt_uint32_t n;
+    char path[32];
+    int fd, len;
+
+    while (batch_pos < batch_count)
+    {
+        if (!store_ready)
+        {
+            return -RT_ERROR;
+        }
+
+        if (tail_records >= SAMPLE_STORE_SEG_RECORDS)
+        {
+            seg_tail++;
+            tail_records = 0;
+        }
+        /* queue full: make room by dropping the oldest segment */
+        if (seg_tail - seg_head >= SAMPLE_STORE_SEGMENTS)
+        {
+            rt_uint32_t remaining = seg_records(seg_head);
+
+            if (read_fd >= 0)
+            {
+                remaining -= (lseek(read_fd, 0, SEEK_CUR) / RECORD_SIZE) - (read_count - read_pos);
+            }
+            seg_drop_head(remaining);
+        }
+
+        n = batch_count - batch_pos;
+        if (n > SAMPLE_STORE_SEG_RECORDS - tail_records)
+        {
+            n = SAMPLE_STORE_SEG_RECORDS - tail_records;
+        }
+
+        seg_path(path, sizeof(path), seg_tail);
+        fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0);
+        if (fd < 0)
+        {
+            stats.write_errors++;
+            return -RT_ERROR;
+        }
+        len = write(fd, &batch[batch_pos], n * RECORD_SIZE);
+        close(fd);
+        if (len != (int) (n * RECORD_SIZE))
+        {
+            /* the segment may now end in a torn record, do not append to it again */
+            stats.write_errors++;
+            tail_records = SAMPLE_STORE_SEG_RECORDS;
+            return -RT_ERROR;
+        }
+
+        stats.flushes++;
+        tail_records += n;
+        file_depth += n;
+        batch_pos += n;
+        head_in_file = RT_TRUE;
+    }
+
+    batch_count = batch_pos = 0;
+    return RT_EOK;
+}
+
+int sample_store_put(const struct sample *smp)
+{
+    if (batch_count == SAMPLE_STORE_BATCH)
+    {
+        if (batch_pos > 0)
+        {
+            /* drained from the front while online, compact instead of writing */
+            rt_memcpy(batch, &batch[batch_pos], (batch_count - batch_pos) * sizeof(struct sample));
+            batch_count -= batch_pos;
+            batch_pos = 0;
+        }
+        else if (sample_store_flush() != RT_EOK)
+        {
+            stats.dropped++;
+            return -RT_EFULL;
+        }
+    }
+
+    batch[batch_count++] = *smp;
+    stats.stored++;
+    return RT_EOK;
+}
+
+/* refill the read cache from the head segment, advancing over drained segments */
+static rt_bool_t read_fill(void)
+{
+    char path[32];
+    int len;
+
+    while (file_depth > 0)
+    {
+        if (read_fd < 0)
+        {
+            seg_path(path, sizeof(path), seg_head);
+            read_fd = open(path, O_RDONLY, 0);
+        }
+        if (read_fd >= 0)
+        {
+            len = read(read_fd, read_cache, sizeof(read_cache));
+            if (len >= (int) RECORD_SIZE)
+            {
+                /* never leave the file offset inside a record */
+                if (len % RECORD_SIZE)
+                {
+                    lseek(read_fd, -(len % RECORD_SIZE), SEEK_CUR);
+                }
+                read_count = len / RECORD_SIZE;
+                read_pos = 0;
+                return RT_TRUE;
+            }
+        }
+
+        if (seg_head == seg_tail)
+        {
+            /* caught up with the writer: restart both ends on a new segment */
+            seg_drop_head(0);
+            seg_tail = seg_head;
+            tail_records = 0;
+            file_depth = 0;
+            break;
+        }
+        /* segment exhausted (or unreadable): anything left in it is lost */
+        seg_drop_head(0);
+    }
+
+    head_in_file = RT_FALSE;
+    return RT_FALSE;
+}
+
+int sample_store_peek(struct sample *smp)
+{
+    if (head_in_file && (read_pos < read_count || read_fill()))
+    {
+        *smp = read_cache[read_pos];
+        return RT_EOK;
+    }
+    if (batch_pos < batch_count)
+    {
+        *smp = batch[batch_pos];
+        return RT_EOK;
+    }
+    return -RT_EEMPTY;
+}
+
+void sample_store_pop(void)
+{
+    if (head_in_file && read_pos < read_count)
+    {
+        read_pos++;
+        file_depth--;
+    }
+    else if (batch_pos < batch_count)
+    {
+        if (++batch_pos == batch_count)
+        {
+            batch_count = batch_pos = 0;
+        }
+    }
+    else
+    {
+        return;
+    }
+    stats.drained++;
+}
+
+rt_uint32_t sample_store_depth(void)
+{
+    return file_depth + batch_count - batch_pos;
+}
+
+void sample_store_stats_get(struct sample_store_stats *st)
+{
+    *st = stats;
+    st->depth = sample_store_depth();
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef APPLICATIONS_SAMPLE_STORE_H_
+#define APPLICATIONS_SAMPLE_STORE_H_
+
+#include <rtthread.h>
+#include "sample_codec.h"
+
+/*
+ * Bounded store-and-forward queue for samples that could not be published.
+ *
+ * Samples are collected in RAM and appended to the file system in batches
+ * of SAMPLE_STORE_BATCH records. The queue is a ring of segment files named
+ * by an increasing id; a drained segment is unlinked as a whole and is
+ * never rewritten, so flash is only ever appended to. When all segments are
+ * full the oldest one is dropped.
+ *
+ * The read position is kept in RAM only: after a reboot the oldest segment
+ * is sent again from its start (at-least-once).
+ */
+
+#define SAMPLE_STORE_DIR            "/mqtt_q"
+#define SAMPLE_STORE_SEGMENTS       8
+#define SAMPLE_STORE_SEG_RECORDS    256
+#define SAMPLE_STORE_BATCH          16
+
+struct sample_store_stats
+{
+    rt_uint32_t depth;          /* samples queued, in RAM and on flash */
+    rt_uint32_t stored;         /* samples accepted */
+    rt_uint32_t drained;        /* samples removed after a successful publish */
+    rt_uint32_t dropped;        /* samples lost to a full queue or write errors */
+    rt_uint32_t flushes;        /* batch appends to the file system */
+    rt_uint32_t write_errors;
+};
+
+/**
+ * Scan SAMPLE_STORE_DIR and restore the queue left by a previous run.
+ *
+ * @return RT_EOK, or -RT_ERROR if the file system is unavailable
+ * (samples are then only buffered in RAM)
+ */
+int sample_store_init(void);
+
+/**
+ * Queue one sample. Full RAM batches are appended to flash.
+ *
+ * @return RT_EOK, or -RT_EFULL if the sample was dropped
+ */
+int sample_store_put(const struct sample *smp);
+
+/**
+ * Append the pending RAM batch to flash.
+ */
+int sample_store_flush(void);
+
+/**
+ * Read the oldest sample without removing it.
+ *
+ * @return RT_EOK, or -RT_EEMPTY
+ */
+int sample_store_peek(struct sample *smp);
+
+/**
+ * Remove the sample returned by the last sample_store_peek().
+ */
+void sample_store_pop(void);
+
+rt_uint32_t sample_store_depth(void);
+
+void sample_store_stats_get(struct sample_store_stats *stats);
+
+#endif /* APPLICATIONS_SAMPLE_STORE_H_ */
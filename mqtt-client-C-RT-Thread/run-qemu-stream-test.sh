@@ -0,0 +1,56 @@
+#!/bin/bash
+# Round trip of 16 B..64 KB chunked messages (applications/msg_stream.c)
+# through a broker on the RT-Thread qemu-vexpress-a9 BSP, and exit non-zero
+# if any size did not come back complete and intact.
+#
+# Needs an RT-Thread checkout (RTT_ROOT), whose qemu-vexpress-a9 BSP is
+# configured with networking, the paho-mqtt package and utest
+# (RT_USING_UTEST), plus arm-none-eabi-gcc, scons and qemu-system-arm. The
+# broker runs on the host, qemu user networking reaches it as 10.0.2.2:
+#   mosquitto -p 1883 &
+#   RTT_ROOT=~/rt-thread ./run-qemu-stream-test.sh
+
+SCRIPT_DIR=$(cd -- "$(dirname -- "${BASH_SOURCE[0]}")" && pwd)
+RTT_ROOT=${RTT_ROOT:-"$SCRIPT_DIR/../rt-thread"}
+BSP_DIR=${BSP_DIR:-"$RTT_ROOT/bsp/qemu-vexpress-a9"}
+TEST_TIMEOUT=${TEST_TIMEOUT:-300}
+TEST_NAME="mqtt.msg_stream.round_trip"
+FILES="applications/msg_stream.c applications/msg_stream.h tests/test_msg_stream.c"
+
+if [[ ! -f "$BSP_DIR/SConstruct" ]]; then
+    echo "❌ qemu-vexpress-a9 BSP not found: $BSP_DIR"
+    echo "   Set RTT_ROOT to an RT-Thread checkout, or BSP_DIR to the BSP"
+    exit 1
+fi
+
+# the BSP builds every .c in its applications directory
+cleanup() {
+    for f in $FILES; do
+        rm -f "$BSP_DIR/applications/$(basename "$f")"
+    done
+}
+trap cleanup EXIT
+for f in $FILES; do
+    cp "$SCRIPT_DIR/$f" "$BSP_DIR/applications/"
+done
+
+echo "🟢 Building $BSP_DIR ..."
+if ! scons -C "$BSP_DIR" -j"$(nproc)"; then
+    echo "❌ Build failed"
+    exit 1
+fi
+
+echo "🟢 Running utest $TEST_NAME ..."
+
+LOG=$( { sleep 10; echo "utest_run $TEST_NAME"; sleep "$TEST_TIMEOUT"; } \
+    | timeout "$((TEST_TIMEOUT + 20))" qemu-system-arm -M vexpress-a9 -smp cpus=2 \
+        -kernel "$BSP_DIR/rtthread.bin" -nographic -net nic -net user 2>&1 \
+    | tee /dev/stderr | grep -m 1 -E "\[  (PASSED|FAILED)  \] \[ result   \] testcase \($TEST_NAME\)")
+
+if grep -q "PASSED" <<< "$LOG"; then
+    echo "✅ Stream round trip passed"
+    exit 0
+fi
+
+echo "❌ Stream round trip failed or did not finish"
+exit 1
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <rtthread.h>
+#include <utest.h>
+
+#include "paho_mqtt.h"
+#include "msg_stream.h"
+
+/*
+ * Round trip of msg_stream messages through a broker: 16 B..64 KB,
+ * doubling, published to our own subscription with 1 KB paho buffers, so
+ * everything above one chunk only arrives because it is chunked.
+ *
+ * Runs on the qemu-vexpress-a9 BSP, see run-qemu-stream-test.sh; with qemu
+ * user networking the host is 10.0.2.2.
+ */
+
+#ifndef STREAM_TEST_URI
+#define STREAM_TEST_URI         "tcp://10.0.2.2:1883"
+#endif
+#define STREAM_TEST_TOPIC       "/emqx/mqtt/stream_test"
+#define STREAM_TEST_BUF_SIZE    1024
+#define STREAM_TEST_MIN         16
+#define STREAM_TEST_MAX         (64 * 1024)
+#define STREAM_TEST_ONLINE_MS   10000
+#define STREAM_TEST_ECHO_MS     10000
+
+#define PAHO_THREAD_NAME        "mqtt"
+#define PAHO_EXIT_TIMEOUT_MS    5000
+
+static MQTTClient client;
+static rt_uint8_t tx_buf[STREAM_TEST_BUF_SIZE];
+static rt_uint8_t rx_buf[STREAM_TEST_BUF_SIZE];
+static struct rt_semaphore online_sem;
+
+static void stream_sub_callback(MQTTClient *c, MessageData *msg_data)
+{
+    msg_stream_feed(msg_data->message->payload, msg_data->message->payloadlen);
+}
+
+static void stream_online_callback(MQTTClient *c)
+{
+    rt_sem_release(&online_sem);
+}
+
+static void test_round_trip(void)
+{
+    struct msg_stream_stats before, after;
+    rt_uint32_t size, waited;
+
+    for (size = STREAM_TEST_MIN; size <= STREAM_TEST_MAX; size *= 2)
+    {
+        msg_stream_stats_get(&before);
+        uassert_int_equal(msg_stream_publish_test(&client, STREAM_TEST_TOPIC, size), RT_EOK);
+
+        for (waited = 0; waited < STREAM_TEST_ECHO_MS; waited += 10)
+        {
+            msg_stream_stats_get(&after);
+            if (after.completed != before.completed || after.aborted != before.aborted)
+            {
+                break;
+            }
+            rt_thread_mdelay(10);
+        }
+
+        rt_kprintf("stream %u bytes: completed %u, aborted %u, corrupted %u\n", size, after.completed - before.completed,
+                after.aborted - before.aborted, after.corrupted - before.corrupted);
+        uassert_int_equal(after.completed - before.completed, 1);
+        uassert_int_equal(after.aborted - before.aborted, 0);
+        uassert_int_equal(after.corrupted - before.corrupted, 0);
+        uassert_int_equal((rt_uint32_t) (after.bytes - before.bytes), size);
+    }
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    MQTTPacket_connectData condata = MQTTPacket_connectData_initializer;
+    static char client_id[32];
+
+    rt_sem_init(&online_sem, "stream", 0, RT_IPC_FLAG_FIFO);
+    msg_stream_set_sink(RT_NULL);
+
+    rt_memset(&client, 0, sizeof(MQTTClient));
+    client.uri = STREAM_TEST_URI;
+    rt_memcpy(&client.condata, &condata, sizeof(condata));
+    rt_snprintf(client_id, sizeof(client_id), "rtthread-stream%d", rt_tick_get());
+    client.condata.clientID.cstring = client_id;
+    client.condata.keepAliveInterval = 60;
+    client.condata.cleansession = 1;
+
+    client.buf_size = client.readbuf_size = STREAM_TEST_BUF_SIZE;
+    client.buf = tx_buf;
+    client.readbuf = rx_buf;
+
+    client.online_callback = stream_online_callback;
+    client.messageHandlers[0].topicFilter = rt_strdup(STREAM_TEST_TOPIC);
+    client.messageHandlers[0].callback = stream_sub_callback;
+    client.messageHandlers[0].qos = QOS1;
+    client.defaultMessageHandler = stream_sub_callback;
+
+    paho_mqtt_start(&client);
+    /* online is reported after the subscription is in place */
+    if (rt_sem_take(&online_sem, rt_tick_from_millisecond(STREAM_TEST_ONLINE_MS)) != RT_EOK)
+    {
+        rt_kprintf("stream test: no connection to %s\n", STREAM_TEST_URI);
+        return -RT_ETIMEOUT;
+    }
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    rt_uint32_t waited;
+
+    paho_mqtt_stop(&client);
+    /* the buffers are static, but the semaphore must outlive the thread */
+    for (waited = 0; rt_thread_find(PAHO_THREAD_NAME) != RT_NULL && waited < PAHO_EXIT_TIMEOUT_MS; waited += 10)
+    {
+        rt_thread_mdelay(10);
+    }
+    rt_sem_detach(&online_sem);
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_round_trip);
+}
+UTEST_TC_EXPORT(testcase, "mqtt.msg_stream.round_trip", utest_tc_init, utest_tc_cleanup, 300);
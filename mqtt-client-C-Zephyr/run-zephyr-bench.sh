@@ -0,0 +1,35 @@
+#!/bin/bash
+# Run `mqtt_cli bench` non-interactively and exit non-zero on regression.
+# Extra arguments are passed to the bench command, e.g.:
+#   ./run-zephyr-bench.sh -L 2000 -s 128 --min_rate 500
+# The built-in broker stand-in (--loopback) is always used, unless a real
+# broker is given with -h <host>.
+
+SCRIPT_DIR=$(cd -- "$(dirname -- "${BASH_SOURCE[0]}")" && pwd)
+BUILD_DIR=${BUILD_DIR:-"$SCRIPT_DIR/build-bench"}
+APP_PATH=${APP_PATH:-"$BUILD_DIR/zephyr/zephyr.exe"}
+BENCH_TIMEOUT=${BENCH_TIMEOUT:-60}
+BENCH_ARGS="$*"
+if [[ " $BENCH_ARGS " != *" -h "* && " $BENCH_ARGS " != *" --loopback "* ]]; then
+    BENCH_ARGS="--loopback${BENCH_ARGS:+ $BENCH_ARGS}"
+fi
+
+if [[ ! -x "$APP_PATH" ]]; then
+    echo "❌ Bench executable not found: $APP_PATH"
+    echo "   Run the build first:"
+    echo "   west build -d build-bench -p always -b native_sim/native/64 . -- -DOVERLAY_CONFIG=\"prj-nsos.conf;prj-bench.conf\""
+    exit 1
+fi
+
+echo "🟢 Running mqtt_cli bench $BENCH_ARGS ..."
+
+LOG=$( { sleep 1; echo "mqtt_cli bench $BENCH_ARGS"; sleep "$BENCH_TIMEOUT"; } \
+    | "$APP_PATH" --stop_at="$BENCH_TIMEOUT" 2>&1 | tee /dev/stderr | grep "\[BENCH\]")
+
+if grep -q "RESULT: PASS" <<< "$LOG"; then
+    echo "✅ Bench passed"
+    exit 0
+fi
+
+echo "❌ Bench failed or did not finish"
+exit 1
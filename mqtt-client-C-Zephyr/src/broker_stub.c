@@ -0,0 +1,375 @@
+/**
+ * @file broker_stub.c
+ * @brief 回环 MQTT broker 替身实现
+ *
+ * 单线程、一次服务一个客户端：accept 后将数据追加到接收缓冲，逐个解析
+ * 完整的固定报头 + 剩余长度，按报文类型回复应答。客户端断开后继续
+ * accept 下一个连接。
+ */
+
+#include "broker_stub.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/logging/log.h>
+#include <errno.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(broker_stub, LOG_LEVEL_INF);
+
+#define BROKER_STUB_STACK_SIZE 3072
+#define BROKER_STUB_PRIORITY   7
+#define BROKER_STUB_RX_SIZE    2048
+/** MQTT 5 CONNACK 中声明的 Topic Alias Maximum */
+#define BROKER_STUB_ALIAS_MAX  16
+
+/** MQTT 5 属性标识 */
+#define PROP_TOPIC_ALIAS       0x23
+
+/** MQTT 控制报文类型（固定报头高 4 位） */
+enum {
+    PKT_CONNECT = 1,
+    PKT_PUBLISH = 3,
+    PKT_PUBREL = 6,
+    PKT_SUBSCRIBE = 8,
+    PKT_PINGREQ = 12,
+    PKT_DISCONNECT = 14,
+};
+
+K_THREAD_STACK_DEFINE(broker_stub_stack, BROKER_STUB_STACK_SIZE);
+static struct k_thread broker_stub_thread;
+static bool broker_stub_running;
+static int broker_stub_listen_fd = -1;
+
+static struct broker_stub_stats stub_stats;
+
+/** 接收缓冲：全局分配，避免占用线程栈 */
+static uint8_t stub_rx[BROKER_STUB_RX_SIZE];
+
+/** 当前连接的协议版本（CONNECT 中的 Protocol Level） */
+static uint8_t conn_version;
+
+/** 当前连接的别名 → 主题长度映射（只记录长度，用于校验别名已绑定） */
+static uint16_t alias_topic_len[BROKER_STUB_ALIAS_MAX + 1];
+
+/**
+ * @brief 解码变长整数
+ * @return 占用字节数，数据不足或非法时返回 0
+ */
+static size_t decode_varint(const uint8_t *buf, size_t len, size_t *value)
+{
+    size_t v = 0;
+
+    for (size_t i = 0; i < len && i < 4; i++) {
+        v |= (size_t)(buf[i] & 0x7F) << (7 * i);
+        if (!(buf[i] & 0x80)) {
+            *value = v;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 在 PUBLISH 属性中查找 Topic Alias
+ * @return 别名，未携带时返回 0，属性格式无法识别时返回 -1
+ */
+static int find_topic_alias(const uint8_t *props, size_t len)
+{
+    size_t off = 0;
+
+    while (off < len) {
+        uint8_t id = props[off++];
+        size_t skip;
+
+        switch (id) {
+        case PROP_TOPIC_ALIAS:
+            return off + 2 <= len ? (props[off] << 8) | props[off + 1] : -1;
+        case 0x01:                 /* Payload Format Indicator */
+            skip = 1;
+            break;
+        case 0x02:                 /* Message Expiry Interval */
+            skip = 4;
+            break;
+        case 0x03: case 0x08: case 0x09:  /* Content Type / Response Topic / Correlation Data */
+            if (off + 2 > len) {
+                return -1;
+            }
+            skip = 2 + ((props[off] << 8) | props[off + 1]);
+            break;
+        case 0x26:                 /* User Property：两个字符串 */
+            if (off + 2 > len) {
+                return -1;
+            }
+            skip = 2 + ((props[off] << 8) | props[off + 1]);
+            if (off + skip + 2 > len) {
+                return -1;
+            }
+            skip += 2 + ((props[off + skip] << 8) | props[off + skip + 1]);
+            break;
+        case 0x0B: {               /* Subscription Identifier */
+            size_t v;
+            skip = decode_varint(props + off, len - off, &v);
+            if (skip == 0) {
+                return -1;
+            }
+            break;
+        }
+        default:
+            return -1;
+        }
+        off += skip;
+    }
+    return 0;
+}
+
+/**
+ * @brief 按 MQTT 5 规则处理 PUBLISH 中的主题与别名，更新统计
+ */
+static void track_topic_alias(const uint8_t *body, size_t len, size_t topic_len, size_t props_off)
+{
+    size_t props_len;
+    size_t n = decode_varint(body + props_off, len - props_off, &props_len);
+    if (n == 0 || props_off + n + props_len > len) {
+        stub_stats.alias_errors++;
+        return;
+    }
+
+    int alias = find_topic_alias(body + props_off + n, props_len);
+    if (alias < 0 || alias > BROKER_STUB_ALIAS_MAX) {
+        stub_stats.alias_errors++;
+    } else if (alias > 0 && topic_len > 0) {
+        alias_topic_len[alias] = topic_len;   /* 绑定或重新绑定 */
+    } else if (alias > 0) {
+        if (alias_topic_len[alias] == 0) {
+            stub_stats.alias_errors++;       /* 引用了未绑定的别名 */
+        } else {
+            stub_stats.alias_hits++;
+        }
+    } else if (topic_len == 0) {
+        stub_stats.alias_errors++;           /* 空主题却没有别名 */
+    }
+}
+
+static int send_all(int fd, const uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = zsock_send(fd, buf, len, 0);
+        if (n < 0) {
+            return -errno;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/** 发送 "类型 + 0x02 + 报文 ID" 形式的两字节应答（PUBACK / PUBREC / PUBCOMP） */
+static int send_id_ack(int fd, uint8_t header, const uint8_t *id)
+{
+    const uint8_t ack[4] = { header, 0x02, id[0], id[1] };
+
+    return send_all(fd, ack, sizeof(ack));
+}
+
+/**
+ * @brief 处理一个完整报文
+ * @param hdr  固定报头首字节
+ * @param body 可变报头 + 载荷
+ * @param len  剩余长度
+ * @return 0 继续，负值表示关闭连接
+ */
+static int handle_packet(int fd, uint8_t hdr, const uint8_t *body, size_t len)
+{
+    switch (hdr >> 4) {
+    case PKT_CONNECT: {
+        static const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+        /* MQTT 5：flags, reason, 属性长度 3, Topic Alias Maximum */
+        static const uint8_t connack_v5[] = {
+            0x20, 0x06, 0x00, 0x00, 0x03, PROP_TOPIC_ALIAS, 0x00, BROKER_STUB_ALIAS_MAX
+        };
+
+        stub_stats.connects++;
+        /* 可变报头：协议名 "MQTT"（2 + 4 字节）之后是 Protocol Level */
+        conn_version = len > 6 ? body[6] : 4;
+        memset(alias_topic_len, 0, sizeof(alias_topic_len));
+        if (conn_version == 5) {
+            return send_all(fd, connack_v5, sizeof(connack_v5));
+        }
+        return send_all(fd, connack, sizeof(connack));
+    }
+    case PKT_PUBLISH: {
+        uint8_t qos = (hdr >> 1) & 0x03;
+
+        stub_stats.publishes++;
+        if (len < 2) {
+            return -EBADMSG;
+        }
+        size_t topic_len = (body[0] << 8) | body[1];
+        size_t id_off = 2 + topic_len;
+        size_t props_off = id_off + (qos > 0 ? 2 : 0);
+        if (props_off > len) {
+            return -EBADMSG;
+        }
+        if (conn_version == 5) {
+            track_topic_alias(body, len, topic_len, props_off);
+        }
+        if (qos == 0) {
+            return 0;
+        }
+        /* MQTT 5 中 reason 为 0 且无属性时可使用与 3.1.1 相同的短应答 */
+        return send_id_ack(fd, qos == 1 ? 0x40 : 0x50, body + id_off);
+    }
+    case PKT_PUBREL:
+        return len < 2 ? -EBADMSG : send_id_ack(fd, 0x70, body);
+    case PKT_SUBSCRIBE: {
+        uint8_t suback[5 + 16] = { 0x90, 0x02 };
+        size_t ack_len = 4;
+        size_t off = 2;
+        size_t count = 0;
+
+        if (len < 2) {
+            return -EBADMSG;
+        }
+        suback[2] = body[0];
+        suback[3] = body[1];
+        if (conn_version == 5) {
+            /* 跳过 SUBSCRIBE 属性，SUBACK 属性长度为 0 */
+            size_t props_len;
+            size_t n = decode_varint(body + off, len - off, &props_len);
+            if (n == 0) {
+                return -EBADMSG;
+            }
+            off += n + props_len;
+            suback[ack_len++] = 0x00;
+        }
+        /* 逐个跳过 filter，按请求的 QoS 授予 */
+        for (; off + 2 < len && count < 16; count++) {
+            off += 2 + ((body[off] << 8) | body[off + 1]);
+            if (off >= len) {
+                return -EBADMSG;
+            }
+            suback[ack_len + count] = body[off] & 0x03;
+            off++;
+        }
+        suback[1] = ack_len - 2 + count;
+        return send_all(fd, suback, ack_len + count);
+    }
+    case PKT_PINGREQ: {
+        static const uint8_t pingresp[] = { 0xD0, 0x00 };
+
+        stub_stats.pings++;
+        return send_all(fd, pingresp, sizeof(pingresp));
+    }
+    case PKT_DISCONNECT:
+        return -ECONNRESET;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief 服务单个客户端直到断开
+ */
+static void serve_client(int fd)
+{
+    size_t have = 0;
+
+    while (true) {
+        ssize_t n = zsock_recv(fd, stub_rx + have, sizeof(stub_rx) - have, 0);
+        if (n <= 0) {
+            return;
+        }
+        have += n;
+        stub_stats.rx_bytes += n;
+
+        size_t pos = 0;
+        while (have - pos >= 2) {
+            /* 解码剩余长度（变长整数，最多 4 字节） */
+            size_t rl = 0, hl = 1;
+            uint8_t b;
+            do {
+                if (pos + hl >= have) {
+                    goto need_more;
+                }
+                b = stub_rx[pos + hl];
+                rl |= (size_t)(b & 0x7F) << (7 * (hl - 1));
+                hl++;
+            } while ((b & 0x80) && hl <= 4);
+
+            if (hl + rl > sizeof(stub_rx)) {
+                LOG_ERR("packet too large: %u", (unsigned)rl);
+                return;
+            }
+            if (pos + hl + rl > have) {
+                break;
+            }
+            if (handle_packet(fd, stub_rx[pos], stub_rx + pos + hl, rl) < 0) {
+                return;
+            }
+            pos += hl + rl;
+        }
+need_more:
+        memmove(stub_rx, stub_rx + pos, have - pos);
+        have -= pos;
+    }
+}
+
+static void broker_stub_main(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    while (true) {
+        int fd = zsock_accept(broker_stub_listen_fd, NULL, NULL);
+        if (fd < 0) {
+            LOG_ERR("accept failed: %d", errno);
+            k_msleep(100);
+            continue;
+        }
+        serve_client(fd);
+        zsock_close(fd);
+    }
+}
+
+int broker_stub_start(uint16_t port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    int opt = 1;
+
+    if (broker_stub_running) {
+        return 0;
+    }
+
+    zsock_inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    int fd = zsock_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        return -errno;
+    }
+    zsock_setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (zsock_bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        zsock_listen(fd, 1) < 0) {
+        int rc = -errno;
+        zsock_close(fd);
+        return rc;
+    }
+
+    broker_stub_listen_fd = fd;
+    k_thread_create(&broker_stub_thread, broker_stub_stack,
+                    K_THREAD_STACK_SIZEOF(broker_stub_stack),
+                    broker_stub_main, NULL, NULL, NULL,
+                    BROKER_STUB_PRIORITY, 0, K_NO_WAIT);
+    k_thread_name_set(&broker_stub_thread, "broker_stub");
+    broker_stub_running = true;
+    return 0;
+}
+
+void broker_stub_stats_get(struct broker_stub_stats *stats)
+{
+    *stats = stub_stats;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file broker_stub.h
+ * @brief 进程内回环 MQTT broker 替身，供 mqtt_cli bench 离线测量使用
+ *
+ * 只实现基准测试所需的最小报文集合：CONNECT → CONNACK、PUBLISH → PUBACK /
+ * PUBREC、PUBREL → PUBCOMP、SUBSCRIBE → SUBACK、PINGREQ → PINGRESP。
+ * 收到的 PUBLISH 不做转发，仅计数。支持 MQTT 3.1.1 与 5.0：5.0 连接的
+ * CONNACK 声明 Topic Alias Maximum，并校验客户端发来的别名能否还原主题。
+ */
+
+#ifndef BROKER_STUB_H_
+#define BROKER_STUB_H_
+
+#include <stdint.h>
+
+/**
+ * @brief broker 替身的运行统计
+ */
+struct broker_stub_stats {
+    uint32_t connects;     /**< 已处理的 CONNECT 数 */
+    uint32_t publishes;    /**< 已收到的 PUBLISH 数 */
+    uint32_t pings;        /**< 已处理的 PINGREQ 数 */
+    uint32_t alias_hits;   /**< 仅凭别名还原出主题的 PUBLISH 数 */
+    uint32_t alias_errors; /**< 别名非法或未绑定的 PUBLISH 数 */
+    uint64_t rx_bytes;     /**< 已接收的报文字节数 */
+};
+
+/**
+ * @brief 在 127.0.0.1:port 上启动 broker 替身线程（重复调用无副作用）
+ * @return 0 成功，负值为 errno
+ */
+int broker_stub_start(uint16_t port);
+
+/**
+ * @brief 读取运行统计快照
+ */
+void broker_stub_stats_get(struct broker_stub_stats *stats);
+
+#endif /* BROKER_STUB_H_ */
@@ -2,7 +2,7 @@
  * @file main.c
  * @brief Zephyr MQTT 多功能 Shell 客户端
  *
- * 通过 Zephyr Shell 提供 mqtt_cli conn / sub / pub 三个子命令，支持：
+ * 通过 Zephyr Shell 提供 mqtt_cli conn / sub / pub / bench 子命令，支持：
  *   - NSOS/TCP-only 模式（prj-nsos.conf overlay）：明文 MQTT，无需证书
  *   - TAP+TLS 模式（prj-tap-tls.conf overlay）：TLS 1.2 + mTLS 双向认证
  *
@@ -11,7 +11,8 @@
  *   → 轮询等待 CONNACK → 打印 Connection successful!
  *
  * 事件回调 mqtt_evt_handler() 处理 CONNACK / DISCONNECT / PUBLISH，
- * 收到消息时通过全局 shell 指针使用 shell_print 输出（避免 native_sim
+ * 收到消息后经 topic_dispatch 通配符 trie 路由到注册的处理函数，默认
+ * 处理函数通过全局 shell 指针使用 shell_print 输出（避免 native_sim
  * 上 LOG_INF / printk 的双通道输出重复问题）。
  */
 
@@ -27,6 +28,10 @@
 #include <stdlib.h>
 #include <errno.h>
 
+#include "broker_stub.h"
+#include "topic_alias.h"
+#include "topic_dispatch.h"
+
 /* ── TLS 凭据管理（仅 TAP+TLS 模式编译） ─────────────────────────────── */
 
 #ifdef CONFIG_MQTT_LIB_TLS
@@ -35,12 +40,20 @@
 /** Zephyr 凭据安全标签，所有 CA/Cert/Key 均注入到 tag 101 */
 static sec_tag_t sec_tag_list[] = { 101 };
 
+/** 单个凭据文件的最大长度（不含 NUL 终止符） */
+#define CREDENTIAL_MAX_LEN 3072
+
 /**
- * @brief 记录已注入凭据的类型和缓冲区指针，用于跨连接清理
+ * @brief 记录已注入凭据的类型、缓冲区与来源路径，用于跨连接复用与清理
+ *
+ * 重连时若路径相同、文件内容与 buf 中已注册的字节完全一致，则直接复用
+ * 已注册到 sec_tag 101 的凭据，跳过 malloc / tls_credential_add。
  */
 struct credential_slot {
     enum tls_credential_type type;   /**< 凭据类型（CA / 公钥证书 / 私钥） */
     uint8_t *buf;                    /**< malloc 分配的缓冲区指针 */
+    size_t len;                      /**< 已注册长度（含 NUL） */
+    char path[128];                  /**< 来源文件路径 */
 };
 
 static struct credential_slot ca_credential = {
@@ -75,9 +88,33 @@ enum mqtt_cli_opt {
     OPT_CA,
     OPT_INSECURE,
     OPT_KEY_PASSWORD,
-    OPT_NO_CLEAN
+    OPT_NO_CLEAN,
+    OPT_LOOPBACK,
+    OPT_MAX_CONNECT_MS,
+    OPT_MIN_RATE,
+    OPT_MQTT5,
+    OPT_BATCH_AGE,
+    OPT_PACK
 };
 
+/* bench 默认参数与回归阈值 */
+#define BENCH_DEFAULT_PORT           18830
+#define BENCH_DEFAULT_COUNT          1000
+#define BENCH_DEFAULT_SIZE           64
+#define BENCH_MAX_SIZE               896
+#define BENCH_DEFAULT_MAX_CONNECT_MS 500
+#define BENCH_DEFAULT_MIN_RATE       200
+#define BENCH_ACK_TIMEOUT_MS         5000
+/** 缓冲区水位探测用的填充字节 */
+#define BENCH_PAINT_BYTE             0xA5
+
+/* pub 批量模式：RAM 环形缓冲容量与打包 payload 上限 */
+#define PUB_BATCH_MAX       16
+#define PUB_BATCH_MSG_LEN   128
+#define PUB_PACK_MAX        896
+/** flush 后等待 QoS 1/2 确认的最长时间 */
+#define PUB_BATCH_ACK_MS    200
+
 /** MQTT 接收 / 发送缓冲区：全局分配，避免 shell 线程栈溢出 */
 static uint8_t rx_buffer[1024];
 static uint8_t tx_buffer[1024];
@@ -94,6 +131,15 @@ static char client_id_global[32];
 /** 连接状态标志：MQTT_EVT_CONNACK 后置 true，DISCONNECT 后置 false */
 static volatile bool is_connected = false;
 
+/** 已完成确认的 QoS 1 / QoS 2 发布数（PUBACK / PUBCOMP），供 bench 统计 */
+static volatile uint32_t pub_acked_count;
+
+/** 单次 sub 命令最多可订阅的 topic filter 数量 */
+#define MQTT_SUB_MAX_TOPICS 8
+
+/** 订阅的 topic filter：全局保存，订阅期间供 mqtt_topic 列表引用 */
+static char sub_filters[MQTT_SUB_MAX_TOPICS][64];
+
 /* ── 数据结构 ────────────────────────────────────────────────────────── */
 
 /**
@@ -113,6 +159,7 @@ struct mqtt_conn_params {
     bool insecure;           /**< 是否跳过服务端证书验证 */
     char key_password[64];   /**< 私钥密码（若加密） */
     bool no_clean;           /**< 是否禁用 Clean Session */
+    bool mqtt5;              /**< 是否使用 MQTT 5.0（启用 Topic Alias） */
 };
 
 /** getopt 长选项表，三个子命令共用 */
@@ -136,6 +183,14 @@ static const struct sys_getopt_option long_options[] = {
     {"insecure",    0, NULL, OPT_INSECURE},
     {"key_password",1, NULL, OPT_KEY_PASSWORD},
     {"no_clean",    0, NULL, OPT_NO_CLEAN},
+    {"size",        1, NULL, 's'},
+    {"loopback",    0, NULL, OPT_LOOPBACK},
+    {"max_connect_ms", 1, NULL, OPT_MAX_CONNECT_MS},
+    {"min_rate",    1, NULL, OPT_MIN_RATE},
+    {"mqtt5",       0, NULL, OPT_MQTT5},
+    {"batch",       1, NULL, 'B'},
+    {"batch_age",   1, NULL, OPT_BATCH_AGE},
+    {"pack",        0, NULL, OPT_PACK},
     {"help",        0, NULL, OPT_HELP},
     {0, 0, 0, 0}
 };
@@ -157,6 +212,9 @@ static void print_common_options_help(const struct shell *sh)
     shell_print(sh, "  -k, --keepalive <SEC>    Keepalive interval in seconds (default: 60)");
     shell_print(sh, "  -u, --username <USER>    Username for broker authentication");
     shell_print(sh, "  -P, --password <PASS>    Password for broker authentication");
+#if defined(CONFIG_MQTT_VERSION_5_0)
+    shell_print(sh, "  --mqtt5                  Use MQTT 5.0 with client-assigned topic aliases");
+#endif
 
 #ifdef CONFIG_MQTT_LIB_TLS
     shell_print(sh, "TLS Options:");
@@ -183,9 +241,10 @@ static void print_conn_help(const struct shell *sh)
  */
 static void print_sub_help(const struct shell *sh)
 {
-    shell_print(sh, "Usage: mqtt_cli sub -t <TOPIC> [options]");
+    shell_print(sh, "Usage: mqtt_cli sub -t <TOPIC> [-t <TOPIC> ...] [options]");
     shell_print(sh, "Options:");
-    shell_print(sh, "  -t, --topic <STRING>     [Required] MQTT topic to subscribe to");
+    shell_print(sh, "  -t, --topic <STRING>     [Required] MQTT topic filter, repeat for up to %d filters",
+                MQTT_SUB_MAX_TOPICS);
     shell_print(sh, "  -q, --qos <0|1|2>        QoS level (default: 0)");
     print_common_options_help(sh);
 }
@@ -204,6 +263,28 @@ static void print_pub_help(const struct shell *sh)
     shell_print(sh, "  -L, --limit <NUMBER>     Total number of messages to publish (default: 1)");
     shell_print(sh, "  -r, --retain             Set Retain flag (default: false)");
     shell_print(sh, "  -d, --dup                Set Duplicate flag (default: false)");
+    shell_print(sh, "Batching Options (low-power mode):");
+    shell_print(sh, "  -B, --batch <NUMBER>     Buffer messages and flush every N (max: %d)", PUB_BATCH_MAX);
+    shell_print(sh, "  --batch_age <MS>         Also flush once the oldest buffered message is this old");
+    shell_print(sh, "  --pack                   Send each flush as one newline-separated PUBLISH");
+    print_common_options_help(sh);
+}
+
+/**
+ * @brief 打印 mqtt_cli bench 帮助
+ */
+static void print_bench_help(const struct shell *sh)
+{
+    shell_print(sh, "Usage: mqtt_cli bench [options]");
+    shell_print(sh, "Options:");
+    shell_print(sh, "  --loopback               Start the built-in broker stand-in on 127.0.0.1");
+    shell_print(sh, "  -L, --limit <NUMBER>     Messages per QoS level (default: %d)", BENCH_DEFAULT_COUNT);
+    shell_print(sh, "  -s, --size <BYTES>       Payload size (default: %d, max: %d)",
+                BENCH_DEFAULT_SIZE, BENCH_MAX_SIZE);
+    shell_print(sh, "  --max_connect_ms <MS>    Fail if connect latency exceeds this (default: %d)",
+                BENCH_DEFAULT_MAX_CONNECT_MS);
+    shell_print(sh, "  --min_rate <MSG/S>       Fail if any QoS level publishes slower (default: %d)",
+                BENCH_DEFAULT_MIN_RATE);
     print_common_options_help(sh);
 }
 
@@ -233,7 +314,7 @@ static struct credential_slot *credential_slot_for_type(enum tls_credential_type
 /**
  * @brief 清除已注册的 TLS 凭据（删除 Zephyr 缓存 + 释放 malloc 缓冲）
  *
- * 每次连接前必须清理旧凭据，避免跨连接的证书残留导致 mTLS 握手失败
+ * 凭据来源变化或不再使用时调用，避免跨连接的证书残留导致 mTLS 握手失败
  * （-0x4e / -103）。
  */
 static void clear_registered_credential(enum tls_credential_type type)
@@ -242,25 +323,30 @@ static void clear_registered_credential(enum tls_credential_type type)
 
     tls_credential_delete(101, type);
 
-    if (slot && slot->buf) {
+    if (slot) {
         free(slot->buf);
         slot->buf = NULL;
+        slot->len = 0;
+        slot->path[0] = '\0';
     }
 }
 
 /**
  * @brief 从文件加载证书并注入 Zephyr 凭据缓存（sec_tag 101）
  *
- * 为每类凭据 malloc 独立缓冲（不能用 static buffer，因后续调用会覆盖），
- * 末尾补 NUL（crt_is_pem() 需要），调用前先 clear 旧凭据。
+ * 文件先读入 static 暂存区；若路径相同且内容与已注册缓冲逐字节
+ * 一致则直接复用，不再 malloc、不再 delete/add。否则为该凭据 malloc
+ * 独立缓冲（暂存区会被后续调用覆盖，不能直接注册），末尾补 NUL
+ * （crt_is_pem() 需要），替换旧凭据。
  *
  * @param sh   Shell 实例
  * @param path 证书文件路径
  * @param type 凭据类型
- * @return 0 成功，负值为 errno
+ * @return 1 复用已注册凭据，0 重新装载成功，负值为 errno
  */
 static int load_and_register_credential(const struct shell *sh, const char *path, enum tls_credential_type type)
 {
+    static uint8_t scratch[CREDENTIAL_MAX_LEN + 1];
     struct credential_slot *slot = credential_slot_for_type(type);
     FILE *f = fopen(path, "rb");
     if (!f) {
@@ -268,25 +354,29 @@ static int load_and_register_credential(const struct shell *sh, const char *path
         return -ENOENT;
     }
 
-    /* Use malloc: each credential needs its own persistent buffer.
-     * static buffer would be overwritten by subsequent calls (CA → cert → key). */
-    uint8_t *file_buf = malloc(3073); /* +1 for null terminator (crt_is_pem requires it) */
-    if (!file_buf) {
-        fclose(f);
-        shell_error(sh, "Error: Out of memory loading credential: %s", path);
-        return -ENOMEM;
-    }
-
-    size_t br = fread(file_buf, 1, 3072, f);
+    size_t br = fread(scratch, 1, CREDENTIAL_MAX_LEN, f);
     fclose(f);
 
     if (br == 0) {
         shell_error(sh, "Error: Credential file is empty: %s", path);
-        free(file_buf);
         return -EIO;
     }
 
-    file_buf[br] = '\0';  /* crt_is_pem() checks buf[len-1] == '\0' */
+    scratch[br] = '\0';  /* crt_is_pem() checks buf[len-1] == '\0' */
+
+    if (slot && slot->buf && slot->len == br + 1 &&
+        memcmp(slot->buf, scratch, br + 1) == 0 &&
+        strcmp(slot->path, path) == 0) {
+        return 1;
+    }
+
+    uint8_t *file_buf = malloc(br + 1);
+    if (!file_buf) {
+        shell_error(sh, "Error: Out of memory loading credential: %s", path);
+        return -ENOMEM;
+    }
+    memcpy(file_buf, scratch, br + 1);
+
     clear_registered_credential(type);
     int rc = tls_credential_add(101, type, file_buf, br + 1);  /* include null */
     if (rc < 0) {
@@ -297,21 +387,57 @@ static int load_and_register_credential(const struct shell *sh, const char *path
 
     if (slot) {
         slot->buf = file_buf;
+        slot->len = br + 1;
+        strncpy(slot->path, path, sizeof(slot->path) - 1);
     }
 
     return 0;
 }
+
+/**
+ * @brief 按连接参数同步一类凭据：路径为空则清除，否则按内容复用或重装
+ *
+ * @return 1 复用，0 装载或清除，负值为 errno
+ */
+static int sync_credential(const struct shell *sh, const char *path, enum tls_credential_type type)
+{
+    struct credential_slot *slot = credential_slot_for_type(type);
+
+    if (strlen(path) == 0) {
+        if (slot && slot->buf) {
+            clear_registered_credential(type);
+        }
+        return 0;
+    }
+    return load_and_register_credential(sh, path, type);
+}
 #endif
 
 /* ==================================================================== */
 /* MQTT 事件回调                                                        */
 /* ==================================================================== */
 
+/**
+ * @brief 默认主题处理函数：通过 shell_print 输出收到的消息
+ */
+static void print_msg_handler(const struct topic_msg *msg, const char *filter, void *user_data)
+{
+    ARG_UNUSED(user_data);
+
+    if (mqtt_evt_shell) {
+        shell_print(mqtt_evt_shell,
+            "[Received Msg] Topic: %.*s | Filter: %s | Payload: %.*s",
+            (int)msg->topic_len, msg->topic, filter,
+            (int)msg->payload_len, (const char *)msg->payload);
+    }
+}
+
 /**
  * @brief Zephyr MQTT 库异步事件回调
  *
  * 处理 CONNACK（设置连接标志）、DISCONNECT（清除连接标志）、
- * PUBLISH（读取 payload 并通过 shell_print 输出）。
+ * PUBLISH（读取 payload 并交给 topic_dispatch 路由到匹配的处理函数，
+ * 无匹配时直接通过 shell_print 输出）。
  * QoS 1 消息自动发送 PUBACK，QoS 2 消息发送 PUBREC。
  *
  * @param client MQTT 客户端实例
@@ -322,6 +448,14 @@ void mqtt_evt_handler(struct mqtt_client *client, const struct mqtt_evt *evt)
     switch (evt->type) {
     case MQTT_EVT_CONNACK:
         if (evt->result == 0) {
+            uint16_t alias_max = 0;
+#if defined(CONFIG_MQTT_VERSION_5_0)
+            if (client->protocol_version == MQTT_VERSION_5_0) {
+                alias_max = evt->param.connack.prop.topic_alias_maximum;
+            }
+#endif
+            /* 别名映射只在当前网络连接内有效，每次 CONNACK 后重建 */
+            topic_alias_reset(alias_max);
             is_connected = true;
         } else {
             LOG_ERR("MQTT connection refused: %d", evt->result);
@@ -330,6 +464,26 @@ void mqtt_evt_handler(struct mqtt_client *client, const struct mqtt_evt *evt)
     case MQTT_EVT_DISCONNECT:
         is_connected = false;
         break;
+    case MQTT_EVT_PUBACK:
+        pub_acked_count++;
+        break;
+    case MQTT_EVT_PUBREC: {
+        /* QoS 2 发布流程第二步：收到 PUBREC 后必须回复 PUBREL */
+        const struct mqtt_pubrel_param rel_param = {
+            .message_id = evt->param.pubrec.message_id};
+        mqtt_publish_qos2_release(client, &rel_param);
+        break;
+    }
+    case MQTT_EVT_PUBREL: {
+        /* QoS 2 接收流程：收到 PUBREL 后回复 PUBCOMP */
+        const struct mqtt_pubcomp_param comp_param = {
+            .message_id = evt->param.pubrel.message_id};
+        mqtt_publish_qos2_complete(client, &comp_param);
+        break;
+    }
+    case MQTT_EVT_PUBCOMP:
+        pub_acked_count++;
+        break;
     case MQTT_EVT_PUBLISH: {
         const struct mqtt_publish_param *pub = &evt->param.publish;
 
@@ -353,7 +507,14 @@ void mqtt_evt_handler(struct mqtt_client *client, const struct mqtt_evt *evt)
         int rc = mqtt_read_publish_payload(client, payload_buf, len);
         if (rc >= 0) {
             payload_buf[rc] = '\0';
-            if (mqtt_evt_shell) {
+            const struct topic_msg msg = {
+                .topic = (const char *)pub->message.topic.topic.utf8,
+                .topic_len = pub->message.topic.topic.size,
+                .payload = payload_buf,
+                .payload_len = rc,
+                .qos = pub->message.topic.qos,
+            };
+            if (topic_dispatch_publish(&msg) == 0 && mqtt_evt_shell) {
                 shell_print(mqtt_evt_shell,
                     "[Received Msg] Topic: %.*s | Payload: %s",
                     pub->message.topic.topic.size,
@@ -367,6 +528,71 @@ void mqtt_evt_handler(struct mqtt_client *client, const struct mqtt_evt *evt)
     }
 }
 
+/**
+ * @brief MQTT 5 下为发布报文填充 Topic Alias
+ *
+ * 已绑定别名的主题以空字符串 + 别名发送，省去重复的主题字节。
+ * MQTT 3.1.1 连接或未启用 CONFIG_MQTT_VERSION_5_0 时不做任何修改。
+ */
+static void apply_topic_alias(struct mqtt_publish_param *param)
+{
+#if defined(CONFIG_MQTT_VERSION_5_0)
+    if (client_ctx.protocol_version != MQTT_VERSION_5_0) {
+        return;
+    }
+
+    bool send_topic;
+    uint16_t alias = topic_alias_resolve((const char *)param->message.topic.topic.utf8,
+                                         param->message.topic.topic.size, &send_topic);
+    param->prop.topic_alias = alias;
+    if (alias != 0 && !send_topic) {
+        param->message.topic.topic.size = 0;
+    }
+#else
+    ARG_UNUSED(param);
+#endif
+}
+
+/**
+ * @brief 填充 Topic Alias 后发布，发布成功才计入节省的字节
+ */
+static int mqtt_publish_aliased(struct mqtt_publish_param *param)
+{
+    size_t topic_len = param->message.topic.topic.size;
+
+    apply_topic_alias(param);
+    int rc = mqtt_publish(&client_ctx, param);
+
+#if defined(CONFIG_MQTT_VERSION_5_0)
+    if (client_ctx.protocol_version == MQTT_VERSION_5_0) {
+        topic_alias_commit(param->prop.topic_alias, topic_len,
+                           param->message.topic.topic.size != 0, rc == 0);
+    }
+#else
+    ARG_UNUSED(topic_len);
+#endif
+    return rc;
+}
+
+/**
+ * @brief 打印 Topic Alias 统计（仅 MQTT 5 连接）
+ */
+static void print_topic_alias_stats(const struct shell *sh)
+{
+#if defined(CONFIG_MQTT_VERSION_5_0)
+    if (client_ctx.protocol_version != MQTT_VERSION_5_0) {
+        return;
+    }
+
+    struct topic_alias_stats st;
+    topic_alias_stats_get(&st);
+    shell_print(sh, "[MQTT5] topic_alias assigned=%u hits=%u misses=%u bytes_saved=%lld",
+                st.assigned, st.hits, st.misses, (long long)st.bytes_saved);
+#else
+    ARG_UNUSED(sh);
+#endif
+}
+
 /**
  * @brief 获取当前传输层的 socket 文件描述符（兼容 TCP / TLS 两种模式）
  */
@@ -380,6 +606,36 @@ static int get_client_fd(struct mqtt_client *client)
     return client->transport.tcp.sock;
 }
 
+/**
+ * @brief 处理 socket 上已到达的输入，最多阻塞 timeout_ms
+ */
+static void mqtt_pump_input(int timeout_ms)
+{
+    struct zsock_pollfd fds[1] = { { .fd = get_client_fd(&client_ctx), .events = ZSOCK_POLLIN } };
+
+    if (zsock_poll(fds, 1, timeout_ms) > 0 && (fds[0].revents & ZSOCK_POLLIN)) {
+        mqtt_input(&client_ctx);
+    }
+}
+
+/**
+ * @brief 不阻塞地处理 socket 上已到达的全部输入
+ *
+ * mqtt_input() 每次只处理一个报文；QoS 2 每条消息会回来 PUBREC 与 PUBCOMP
+ * 两个报文，只收一个会让 ACK 在 socket 中越积越多，对端写满 TCP 缓冲后
+ * 双方互相阻塞。
+ */
+static void mqtt_drain_input(void)
+{
+    struct zsock_pollfd fds[1] = { { .fd = get_client_fd(&client_ctx), .events = ZSOCK_POLLIN } };
+
+    while (is_connected && zsock_poll(fds, 1, 0) > 0 && (fds[0].revents & ZSOCK_POLLIN)) {
+        if (mqtt_input(&client_ctx) != 0) {
+            break;
+        }
+    }
+}
+
 /* ==================================================================== */
 /* 通用 MQTT 连接引擎                                                   */
 /* ==================================================================== */
@@ -391,9 +647,9 @@ static int get_client_fd(struct mqtt_client *client)
  *   1. 随机 Client ID（若未指定）
  *   2. DNS 解析（zsock_getaddrinfo）
  *   3. mqtt_client_init + 参数绑定
- *   4. TLS 凭据装载（若 use_tls）
+ *   4. TLS 凭据装载（若 use_tls；路径与内容未变时复用已注册凭据）
  *   5. mqtt_connect 发送 CONNECT 报文
- *   6. 100ms 间隔轮询等待 CONNACK（超时 5 秒）
+ *   6. 轮询等待 CONNACK（单次最多阻塞 100ms，总超时 5 秒）
  *
  * @param sh Shell 实例
  * @param p  连接参数
@@ -402,6 +658,7 @@ static int get_client_fd(struct mqtt_client *client)
 static int common_mqtt_connect(const struct shell *sh, struct mqtt_conn_params *p)
 {
     int rc;
+    int64_t connect_start = k_uptime_get();
     is_connected = false;
 
     mqtt_evt_shell = sh;  /* 记录 shell 指针供事件回调使用 */
@@ -431,7 +688,16 @@ static int common_mqtt_connect(const struct shell *sh, struct mqtt_conn_params *
     client_ctx.evt_cb = mqtt_evt_handler;
     client_ctx.client_id.utf8 = (uint8_t *)client_id_global;
     client_ctx.client_id.size = strlen(client_id_global);
-    client_ctx.protocol_version = MQTT_VERSION_3_1_1;
+    if (p->mqtt5) {
+#if defined(CONFIG_MQTT_VERSION_5_0)
+        client_ctx.protocol_version = MQTT_VERSION_5_0;
+#else
+        shell_error(sh, "Error: --mqtt5 requires CONFIG_MQTT_VERSION_5_0=y (see prj-mqtt5.conf)");
+        return -ENOTSUP;
+#endif
+    } else {
+        client_ctx.protocol_version = MQTT_VERSION_3_1_1;
+    }
     client_ctx.rx_buf = rx_buffer;
     client_ctx.rx_buf_size = sizeof(rx_buffer);
     client_ctx.tx_buf = tx_buffer;
@@ -454,24 +720,24 @@ static int common_mqtt_connect(const struct shell *sh, struct mqtt_conn_params *
 
     if (p->use_tls) {
 #ifdef CONFIG_MQTT_LIB_TLS
-        shell_print(sh, "[TLS] Loading credentials...");
-        clear_registered_credential(TLS_CREDENTIAL_CA_CERTIFICATE);
-        clear_registered_credential(TLS_CREDENTIAL_PUBLIC_CERTIFICATE);
-        clear_registered_credential(TLS_CREDENTIAL_PRIVATE_KEY);
+        int reused = 0;
+        int64_t cred_start = k_uptime_get();
 
+        shell_print(sh, "[TLS] Loading credentials...");
+        rc = sync_credential(sh, p->ca_path, TLS_CREDENTIAL_CA_CERTIFICATE);
+        if (rc < 0) { shell_error(sh, "[TLS] CA load failed: %d", rc); return rc; }
+        reused += rc;
         if (strlen(p->ca_path) > 0) {
-            rc = load_and_register_credential(sh, p->ca_path, TLS_CREDENTIAL_CA_CERTIFICATE);
-            if (rc < 0) { shell_error(sh, "[TLS] CA load failed: %d", rc); return rc; }
-            shell_print(sh, "[TLS] CA certificate loaded OK (tag 101)");
-        }
-        if (strlen(p->cert_path) > 0) {
-            rc = load_and_register_credential(sh, p->cert_path, TLS_CREDENTIAL_PUBLIC_CERTIFICATE);
-            if (rc < 0) { shell_error(sh, "[TLS] Cert load failed: %d", rc); return rc; }
-        }
-        if (strlen(p->key_path) > 0) {
-            rc = load_and_register_credential(sh, p->key_path, TLS_CREDENTIAL_PRIVATE_KEY);
-            if (rc < 0) { shell_error(sh, "[TLS] Key load failed: %d", rc); return rc; }
+            shell_print(sh, "[TLS] CA certificate %s (tag 101)", rc ? "reused" : "loaded OK");
         }
+        rc = sync_credential(sh, p->cert_path, TLS_CREDENTIAL_PUBLIC_CERTIFICATE);
+        if (rc < 0) { shell_error(sh, "[TLS] Cert load failed: %d", rc); return rc; }
+        reused += rc;
+        rc = sync_credential(sh, p->key_path, TLS_CREDENTIAL_PRIVATE_KEY);
+        if (rc < 0) { shell_error(sh, "[TLS] Key load failed: %d", rc); return rc; }
+        reused += rc;
+        shell_print(sh, "[TLS] Credentials ready: %d reused, took %lld ms",
+                    reused, (long long)(k_uptime_get() - cred_start));
 
         /* 👈 【核心修复】完全对接官方规范名称的 tls.config 参数组 */
         client_ctx.transport.type = MQTT_TRANSPORT_SECURE;
@@ -500,14 +766,16 @@ static int common_mqtt_connect(const struct shell *sh, struct mqtt_conn_params *
         return rc;
     }
 
-    uint32_t timeout = 0;
-    while (!is_connected && timeout < 5000) {
+    /* poll 本身即为等待，CONNACK 到达后立即处理，不再额外 sleep */
+    int64_t deadline = k_uptime_get() + 5000;
+    while (!is_connected && k_uptime_get() < deadline) {
         struct zsock_pollfd fds[1] = { { .fd = get_client_fd(&client_ctx), .events = ZSOCK_POLLIN } };
-        if (zsock_poll(fds, 1, 100) > 0) {
+        int res = zsock_poll(fds, 1, 100);
+        if (res > 0) {
             mqtt_input(&client_ctx);
+        } else if (res < 0) {
+            break;
         }
-        k_msleep(100);
-        timeout += 100;
     }
 
     if (!is_connected) {
@@ -515,7 +783,8 @@ static int common_mqtt_connect(const struct shell *sh, struct mqtt_conn_params *
         return -ETIMEDOUT;
     }
 
-    shell_print(sh, "Connection successful!");
+    shell_print(sh, "Connection successful! (%lld ms)",
+                (long long)(k_uptime_get() - connect_start));
     return 0;
 }
 
@@ -556,6 +825,7 @@ static int cmd_mqtt_conn(const struct shell *sh, size_t argc, char **argv)
             case OPT_INSECURE: p.insecure = true; break;
             case OPT_KEY_PASSWORD: strncpy(p.key_password, state->optarg, sizeof(p.key_password) - 1); break;
             case OPT_NO_CLEAN: p.no_clean = true; break;
+            case OPT_MQTT5: p.mqtt5 = true; break;
             case OPT_HELP: help_requested = true; break;
         }
     }
@@ -598,7 +868,7 @@ static int cmd_mqtt_sub(const struct shell *sh, size_t argc, char **argv)
     p.insecure = false;
     p.no_clean = false;
 
-    char topic[64] = "";
+    size_t topic_count = 0;
     int qos = 0;
 
     while ((c = sys_getopt_long(argc, argv, "i:h:p:k:u:P:t:q:", long_options, &option_index)) != -1) {
@@ -610,7 +880,15 @@ static int cmd_mqtt_sub(const struct shell *sh, size_t argc, char **argv)
             case 'k': p.keepalive = atoi(state->optarg); break;
             case 'u': strncpy(p.username, state->optarg, sizeof(p.username) - 1); break;
             case 'P': strncpy(p.password, state->optarg, sizeof(p.password) - 1); break;
-            case 't': strncpy(topic, state->optarg, sizeof(topic) - 1); break;
+            case 't':
+                if (topic_count >= MQTT_SUB_MAX_TOPICS) {
+                    shell_error(sh, "Error: At most %d topic filters are supported", MQTT_SUB_MAX_TOPICS);
+                    return -EINVAL;
+                }
+                memset(sub_filters[topic_count], 0, sizeof(sub_filters[topic_count]));
+                strncpy(sub_filters[topic_count], state->optarg, sizeof(sub_filters[topic_count]) - 1);
+                topic_count++;
+                break;
             case 'q': qos = atoi(state->optarg); break;
             case OPT_KEY: strncpy(p.key_path, state->optarg, sizeof(p.key_path) - 1); p.use_tls = true; break;
             case OPT_CERT: strncpy(p.cert_path, state->optarg, sizeof(p.cert_path) - 1); p.use_tls = true; break;
@@ -618,6 +896,7 @@ static int cmd_mqtt_sub(const struct shell *sh, size_t argc, char **argv)
             case OPT_INSECURE: p.insecure = true; break;
             case OPT_KEY_PASSWORD: strncpy(p.key_password, state->optarg, sizeof(p.key_password) - 1); break;
             case OPT_NO_CLEAN: p.no_clean = true; break;
+            case OPT_MQTT5: p.mqtt5 = true; break;
             case OPT_HELP: help_requested = true; break;
         }
     }
@@ -627,26 +906,39 @@ static int cmd_mqtt_sub(const struct shell *sh, size_t argc, char **argv)
         return 0;
     }
 
-    if (strlen(topic) == 0) { 
+    if (topic_count == 0) { 
         shell_error(sh, "Error: Subscription requires topic parameter -t or --topic"); 
         return -EINVAL; 
     }
 
-    int rc = common_mqtt_connect(sh, &p);
+    /* 先建立分发表，filter 非法时无需连接 broker */
+    int rc;
+    topic_dispatch_reset();
+    for (size_t i = 0; i < topic_count; i++) {
+        rc = topic_dispatch_add(sub_filters[i], print_msg_handler, NULL);
+        if (rc != 0) {
+            shell_error(sh, "Error: Invalid or too many topic filters '%s': %d", sub_filters[i], rc);
+            return rc;
+        }
+    }
+
+    rc = common_mqtt_connect(sh, &p);
     if (rc != 0) { return rc; }
 
-    static struct mqtt_topic sub_topic;
-    sub_topic.topic.utf8 = (uint8_t *)topic;
-    sub_topic.topic.size = strlen(topic);
-    sub_topic.qos = qos;
+    static struct mqtt_topic sub_topics[MQTT_SUB_MAX_TOPICS];
+    for (size_t i = 0; i < topic_count; i++) {
+        sub_topics[i].topic.utf8 = (uint8_t *)sub_filters[i];
+        sub_topics[i].topic.size = strlen(sub_filters[i]);
+        sub_topics[i].qos = qos;
+        shell_print(sh, "Subscribing to topic: '%s' (QoS %d) ...", sub_filters[i], qos);
+    }
 
     struct mqtt_subscription_list sub_list = {
-        .list = &sub_topic,
-        .list_count = 1,
+        .list = sub_topics,
+        .list_count = topic_count,
         .message_id = sys_rand32_get() % 65535 + 1
     };
 
-    shell_print(sh, "Subscribing to topic: '%s' (QoS %d) ...", topic, qos);
     rc = mqtt_subscribe(&client_ctx, &sub_list);
     if (rc != 0) { shell_error(sh, "Error: Failed to send subscription request: %d", rc); return rc; }
 
@@ -662,8 +954,251 @@ static int cmd_mqtt_sub(const struct shell *sh, size_t argc, char **argv)
     return 0;
 }
 
+/* ==================================================================== */
+/* pub 批量发送（低功耗模式）                                           */
+/* ==================================================================== */
+
+/**
+ * @brief 批量模式参数
+ */
+struct pub_batch_cfg {
+    const char *topic;       /**< 发布主题 */
+    const char *message;     /**< 每条消息内容 */
+    int qos;                 /**< QoS 等级 */
+    bool retain;             /**< Retain 标志 */
+    bool dup;                /**< DUP 标志（-d） */
+    uint32_t interval;       /**< 消息产生间隔（ms） */
+    uint32_t limit;          /**< 消息总数 */
+    uint32_t batch_size;     /**< 达到该条数即 flush */
+    uint32_t batch_age;      /**< 最老消息达到该时长即 flush（ms，0 表示不限） */
+    bool pack;               /**< 是否打包为单条 PUBLISH */
+};
+
+/**
+ * @brief 环形缓冲中的一条待发消息
+ */
+struct pub_ring_slot {
+    int64_t ts;                           /**< 入队时间（ms） */
+    uint16_t len;                         /**< 消息长度 */
+    uint8_t data[PUB_BATCH_MSG_LEN];      /**< 消息内容 */
+};
+
+/** 待发消息环形缓冲：全局分配，避免 shell 线程栈溢出 */
+static struct pub_ring_slot pub_ring[PUB_BATCH_MAX];
+static uint32_t pub_ring_head;
+static uint32_t pub_ring_count;
+
+/** 打包模式的 payload 缓冲 */
+static uint8_t pub_pack_buf[PUB_PACK_MAX];
+static size_t pub_pack_len;
+
 /**
- * @brief mqtt_cli pub — 连接 → 发布 N 条消息（支持批量定时）→ 优雅断开
+ * @brief 批量模式统计：wakeups 为唤醒射频发送的次数
+ */
+struct pub_batch_stats {
+    uint32_t messages;       /**< 已发送消息数 */
+    uint32_t dropped;        /**< 未能发出而丢弃的消息数 */
+    uint32_t publishes;      /**< 实际 PUBLISH 报文数 */
+    uint32_t wakeups;        /**< flush 次数（每次 flush 唤醒一次射频） */
+    int64_t radio_on_ms;     /**< flush 期间累计耗时 */
+};
+
+static struct pub_ring_slot *pub_ring_at(uint32_t i)
+{
+    return &pub_ring[(pub_ring_head + i) % PUB_BATCH_MAX];
+}
+
+/**
+ * @brief 丢弃最老的一条缓冲消息并计数
+ */
+static void pub_ring_drop_oldest(struct pub_batch_stats *st)
+{
+    pub_ring_head = (pub_ring_head + 1) % PUB_BATCH_MAX;
+    pub_ring_count--;
+    st->dropped++;
+}
+
+/**
+ * @brief 打包模式下缓冲消息合并后的长度（含换行分隔符）
+ */
+static size_t pub_ring_packed_len(void)
+{
+    size_t packed = 0;
+
+    for (uint32_t j = 0; j < pub_ring_count; j++) {
+        packed += pub_ring_at(j)->len + 1;
+    }
+    return packed;
+}
+
+static int pub_batch_send(const struct pub_batch_cfg *cfg, const uint8_t *data, size_t len)
+{
+    struct mqtt_publish_param param = {
+        .message.topic.qos = cfg->qos,
+        .message.topic.topic.utf8 = (uint8_t *)cfg->topic,
+        .message.topic.topic.size = strlen(cfg->topic),
+        .message.payload.data = (uint8_t *)data,
+        .message.payload.len = len,
+        .message_id = sys_rand32_get() % 65535 + 1,
+        .dup_flag = cfg->dup ? 1U : 0U,
+        .retain_flag = cfg->retain ? 1U : 0U
+    };
+    return mqtt_publish_aliased(&param);
+}
+
+/**
+ * @brief 一次性发出环形缓冲中的全部消息，随后处理确认与心跳
+ *
+ * 逐条模式下 PUBLISH 背靠背发送；打包模式下所有消息以换行分隔合并为
+ * 一条 PUBLISH。mqtt_live() 只在 flush 时调用，使 PINGREQ（若需要）与
+ * 数据发送落在同一次唤醒中。发送失败时未发出的消息留在缓冲中，
+ * 由下一次 flush 重试。
+ */
+static int pub_batch_flush(const struct shell *sh, const struct pub_batch_cfg *cfg,
+                           struct pub_batch_stats *st)
+{
+    if (pub_ring_count == 0) {
+        return 0;
+    }
+
+    int64_t start = k_uptime_get();
+    uint32_t acked_start = pub_acked_count;
+    uint32_t sent = 0;
+    int rc = 0;
+
+    if (cfg->pack) {
+        pub_pack_len = 0;
+        for (uint32_t i = 0; i < pub_ring_count; i++) {
+            struct pub_ring_slot *slot = pub_ring_at(i);
+
+            if (i > 0) {
+                pub_pack_buf[pub_pack_len++] = '\n';
+            }
+            memcpy(pub_pack_buf + pub_pack_len, slot->data, slot->len);
+            pub_pack_len += slot->len;
+        }
+        rc = pub_batch_send(cfg, pub_pack_buf, pub_pack_len);
+        sent = rc == 0 ? 1 : 0;
+    } else {
+        for (uint32_t i = 0; i < pub_ring_count && rc == 0; i++) {
+            struct pub_ring_slot *slot = pub_ring_at(i);
+
+            rc = pub_batch_send(cfg, slot->data, slot->len);
+            if (rc == 0) {
+                sent++;
+            }
+        }
+    }
+
+    if (cfg->qos > 0) {
+        int64_t deadline = k_uptime_get() + PUB_BATCH_ACK_MS;
+        while (is_connected && pub_acked_count - acked_start < sent &&
+               k_uptime_get() < deadline) {
+            mqtt_pump_input(10);
+        }
+    } else {
+        mqtt_pump_input(0);
+    }
+    mqtt_live(&client_ctx);
+
+    int64_t took = k_uptime_get() - start;
+    st->wakeups++;
+    st->publishes += sent;
+    st->radio_on_ms += took;
+    if (rc == 0) {
+        st->messages += pub_ring_count;
+        shell_print(sh, "[Batch] Flushed %u msgs in %u PUBLISH (%lld ms)", pub_ring_count, sent,
+                    (long long)took);
+        pub_ring_head = 0;
+        pub_ring_count = 0;
+    } else {
+        /* 逐条模式下已发出的消息出队，其余保留；打包模式整批保留 */
+        uint32_t done = cfg->pack ? 0 : sent;
+
+        st->messages += done;
+        pub_ring_head = (pub_ring_head + done) % PUB_BATCH_MAX;
+        pub_ring_count -= done;
+        shell_error(sh, "Error: Batch flush failed, error code: %d, %u msgs kept for retry",
+                    rc, pub_ring_count);
+    }
+    return rc;
+}
+
+/**
+ * @brief 批量发布：消息先写入 RAM 环形缓冲，达到条数或时长阈值后集中发送
+ *
+ * 两次 flush 之间不轮询 socket、不调用 mqtt_live()，让射频保持空闲。
+ * 消息按 -I 的固定节拍产生，flush 耗时不会拉长间隔。flush 失败时消息
+ * 留在缓冲中等待下次 flush；缓冲满或结束时仍未发出的消息计入 dropped。
+ */
+static int publish_batched(const struct shell *sh, const struct pub_batch_cfg *cfg)
+{
+    struct pub_batch_stats st = { 0 };
+    size_t msg_len = strlen(cfg->message);
+    int64_t next = k_uptime_get();
+    int err = 0;
+    int rc;
+
+    pub_ring_head = 0;
+    pub_ring_count = 0;
+
+    for (uint32_t i = 0; i < cfg->limit; i++) {
+        if (!is_connected) { shell_error(sh, "Publish aborted: Network disconnected!"); break; }
+
+        /* 打包模式下新消息放不下时先 flush（含换行分隔符） */
+        if (cfg->pack && pub_ring_count > 0 && pub_ring_packed_len() + msg_len > PUB_PACK_MAX) {
+            rc = pub_batch_flush(sh, cfg, &st);
+            if (rc != 0) {
+                err = rc;
+                /* 仍放不下：丢弃最老的消息腾出空间 */
+                while (pub_ring_count > 0 && pub_ring_packed_len() + msg_len > PUB_PACK_MAX) {
+                    pub_ring_drop_oldest(&st);
+                }
+            }
+        }
+        if (pub_ring_count == PUB_BATCH_MAX) {
+            pub_ring_drop_oldest(&st);
+        }
+
+        struct pub_ring_slot *slot = pub_ring_at(pub_ring_count++);
+        slot->ts = k_uptime_get();
+        slot->len = msg_len;
+        memcpy(slot->data, cfg->message, msg_len);
+
+        bool last = (i == cfg->limit - 1);
+        bool aged = cfg->batch_age > 0 &&
+                    k_uptime_get() - pub_ring_at(0)->ts >= cfg->batch_age;
+        if (last || aged || pub_ring_count >= cfg->batch_size) {
+            rc = pub_batch_flush(sh, cfg, &st);
+            if (rc != 0) {
+                err = rc;
+            }
+        }
+
+        if (!last && cfg->interval > 0) {
+            next += cfg->interval;
+            int64_t wait = next - k_uptime_get();
+            if (wait > 0) {
+                k_msleep((int32_t)wait);
+            }
+        }
+    }
+
+    /* 结束时仍未发出的消息 */
+    st.dropped += pub_ring_count;
+    pub_ring_count = 0;
+
+    /* 与逐条发送相比，每条消息本需唤醒一次射频 */
+    shell_print(sh, "[Batch] messages=%u dropped=%u publishes=%u wakeups=%u wakeups_saved=%u "
+                "radio_on_ms=%lld",
+                st.messages, st.dropped, st.publishes, st.wakeups,
+                st.messages > st.wakeups ? st.messages - st.wakeups : 0,
+                (long long)st.radio_on_ms);
+    return st.dropped > 0 ? (err != 0 ? err : -EIO) : 0;
+}
+
+/**
+ * @brief mqtt_cli pub — 连接 → 发布 N 条消息（支持定时与低功耗批量）→ 优雅断开
  */
 static int cmd_mqtt_pub(const struct shell *sh, size_t argc, char **argv)
 {
@@ -687,8 +1222,11 @@ static int cmd_mqtt_pub(const struct shell *sh, size_t argc, char **argv)
     uint32_t limit = 1; 
     bool retain = false;
     bool dup = false;
+    uint32_t batch = 0;
+    uint32_t batch_age = 0;
+    bool pack = false;
 
-    while ((c = sys_getopt_long(argc, argv, "i:h:p:k:u:P:t:m:q:I:L:rd", long_options, &option_index)) != -1) {
+    while ((c = sys_getopt_long(argc, argv, "i:h:p:k:u:P:t:m:q:I:L:rdB:", long_options, &option_index)) != -1) {
         state = sys_getopt_state_get();
         switch (c) {
             case 'i': strncpy(p.client_id, state->optarg, sizeof(p.client_id) - 1); break;
@@ -704,12 +1242,16 @@ static int cmd_mqtt_pub(const struct shell *sh, size_t argc, char **argv)
             case 'L': limit = strtoul(state->optarg, NULL, 10); break;
             case 'r': retain = true; break;
             case 'd': dup = true; break;
+            case 'B': batch = strtoul(state->optarg, NULL, 10); break;
+            case OPT_BATCH_AGE: batch_age = strtoul(state->optarg, NULL, 10); break;
+            case OPT_PACK: pack = true; break;
             case OPT_KEY: strncpy(p.key_path, state->optarg, sizeof(p.key_path) - 1); p.use_tls = true; break;
             case OPT_CERT: strncpy(p.cert_path, state->optarg, sizeof(p.cert_path) - 1); p.use_tls = true; break;
             case OPT_CA: strncpy(p.ca_path, state->optarg, sizeof(p.ca_path) - 1); p.use_tls = true; break;
             case OPT_INSECURE: p.insecure = true; break;
             case OPT_KEY_PASSWORD: strncpy(p.key_password, state->optarg, sizeof(p.key_password) - 1); break;
             case OPT_NO_CLEAN: p.no_clean = true; break;
+            case OPT_MQTT5: p.mqtt5 = true; break;
             case OPT_HELP: help_requested = true; break;
         }
     }
@@ -724,57 +1266,314 @@ static int cmd_mqtt_pub(const struct shell *sh, size_t argc, char **argv)
         return -EINVAL;
     }
 
+    if (batch > PUB_BATCH_MAX || (batch == 0 && (batch_age > 0 || pack))) {
+        shell_error(sh, "Error: Batching requires -B 1..%d", PUB_BATCH_MAX);
+        return -EINVAL;
+    }
+
+    if (batch > 0) {
+        /* 每次 flush 都有报文发出；keepalive 不短于 flush 周期，
+         * 中途就无需为 PINGREQ 额外唤醒射频 */
+        uint32_t period_ms = interval * batch;
+        if (batch_age > 0 && (period_ms == 0 || batch_age < period_ms)) {
+            period_ms = batch_age;
+        }
+        int aligned = DIV_ROUND_UP(period_ms, 1000);
+        if (aligned > p.keepalive) {
+            shell_print(sh, "[Batch] Keepalive raised from %d to %d s to match the flush period",
+                        p.keepalive, aligned);
+            p.keepalive = aligned;
+        }
+    }
+
     int rc = common_mqtt_connect(sh, &p);
     if (rc != 0) { return rc; }
 
-    for (uint32_t i = 0; i < limit; i++) {
-        if (!is_connected) { shell_error(sh, "Publish aborted: Network disconnected!"); break; }
-
-        struct mqtt_publish_param param = {
-            .message.topic.qos = qos,
-            .message.topic.topic.utf8 = (uint8_t *)topic,
-            .message.topic.topic.size = strlen(topic),
-            .message.payload.data = message,
-            .message.payload.len = strlen(message),
-            .message_id = sys_rand32_get() % 65535 + 1,
-            .dup_flag = dup ? 1U : 0U,
-            .retain_flag = retain ? 1U : 0U
+    if (batch > 0) {
+        const struct pub_batch_cfg cfg = {
+            .topic = topic,
+            .message = message,
+            .qos = qos,
+            .retain = retain,
+            .dup = dup,
+            .interval = interval,
+            .limit = limit,
+            .batch_size = batch,
+            .batch_age = batch_age,
+            .pack = pack,
         };
+        rc = publish_batched(sh, &cfg);
+    } else {
+        /* 任一条发布失败或中途断线时，命令以该错误码退出 */
+        int err = 0;
+
+        for (uint32_t i = 0; i < limit; i++) {
+            if (!is_connected) {
+                shell_error(sh, "Publish aborted: Network disconnected!");
+                err = -ENOTCONN;
+                break;
+            }
 
-        rc = mqtt_publish(&client_ctx, &param);
-        if (rc == 0) {
-            shell_print(sh, "[Published %d/%d] Topic='%s' | Payload='%s'", i + 1, limit, topic, message);
-        } else {
-            shell_error(sh, "Error: Publish failed, error code: %d", rc);
-        }
+            struct mqtt_publish_param param = {
+                .message.topic.qos = qos,
+                .message.topic.topic.utf8 = (uint8_t *)topic,
+                .message.topic.topic.size = strlen(topic),
+                .message.payload.data = message,
+                .message.payload.len = strlen(message),
+                .message_id = sys_rand32_get() % 65535 + 1,
+                .dup_flag = dup ? 1U : 0U,
+                .retain_flag = retain ? 1U : 0U
+            };
+            rc = mqtt_publish_aliased(&param);
+            if (rc == 0) {
+                shell_print(sh, "[Published %d/%d] Topic='%s' | Payload='%s'", i + 1, limit, topic, message);
+            } else {
+                shell_error(sh, "Error: Publish failed, error code: %d", rc);
+                err = rc;
+            }
 
-        if (interval > 0 && i < (limit - 1)) {
-            uint32_t elapsed = 0;
-            while (elapsed < interval) {
-                struct zsock_pollfd fds[1] = { { .fd = get_client_fd(&client_ctx), .events = ZSOCK_POLLIN } };
-                if (zsock_poll(fds, 1, 50) > 0) {
-                    mqtt_input(&client_ctx);
+            if (interval > 0 && i < (limit - 1)) {
+                uint32_t elapsed = 0;
+                while (elapsed < interval) {
+                    struct zsock_pollfd fds[1] = { { .fd = get_client_fd(&client_ctx), .events = ZSOCK_POLLIN } };
+                    if (zsock_poll(fds, 1, 50) > 0) {
+                        mqtt_input(&client_ctx);
+                    }
+                    mqtt_live(&client_ctx);
+                    k_msleep(50);
+                    elapsed += 50;
                 }
-                mqtt_live(&client_ctx);
-                k_msleep(50);
-                elapsed += 50;
             }
         }
+        rc = err;
     }
 
+    print_topic_alias_stats(sh);
     shell_print(sh, "Publish finished, gracefully disconnecting and exiting...");
     mqtt_disconnect(&client_ctx, NULL);
     k_msleep(200); 
+    return rc;
+}
+
+/* ==================================================================== */
+/* 基准测量                                                             */
+/* ==================================================================== */
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && (CONFIG_HEAP_MEM_POOL_SIZE > 0)
+#include <zephyr/sys/sys_heap.h>
+/** 内核系统堆（CONFIG_HEAP_MEM_POOL_SIZE），由 kernel/mempool.c 定义 */
+extern struct k_heap _system_heap;
+#endif
+
+/** bench 发布的 payload：一次性填充，测量期间不再格式化 */
+static uint8_t bench_payload[BENCH_MAX_SIZE];
+
+/**
+ * @brief 返回缓冲区中被写过的最高位置（从尾部找第一个非填充字节）
+ */
+static size_t buffer_high_water(const uint8_t *buf, size_t size)
+{
+    while (size > 0 && buf[size - 1] == BENCH_PAINT_BYTE) {
+        size--;
+    }
+    return size;
+}
+
+/**
+ * @brief 以指定 QoS 连续发布 count 条消息并等待全部确认
+ * @param rate 输出：每秒完成的消息数
+ * @return 0 成功，负值为 errno
+ */
+static int bench_publish_run(const struct shell *sh, int qos, uint32_t count, size_t size, uint32_t *rate)
+{
+    static const char topic[] = "zephyr/bench";
+    uint32_t acked_start = pub_acked_count;
+    int64_t start = k_uptime_get();
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!is_connected) {
+            return -ENOTCONN;
+        }
+
+        struct mqtt_publish_param param = {
+            .message.topic.qos = qos,
+            .message.topic.topic.utf8 = (uint8_t *)topic,
+            .message.topic.topic.size = sizeof(topic) - 1,
+            .message.payload.data = bench_payload,
+            .message.payload.len = size,
+            .message_id = (i % 65535) + 1,
+        };
+        int rc = mqtt_publish_aliased(&param);
+        if (rc != 0) {
+            shell_error(sh, "[BENCH] qos%d publish %u failed: %d", qos, i, rc);
+            return rc;
+        }
+        /* 随发随收，避免 ACK 堆积在 socket 中 */
+        mqtt_drain_input();
+    }
+
+    if (qos > 0) {
+        int64_t deadline = k_uptime_get() + BENCH_ACK_TIMEOUT_MS;
+        while (pub_acked_count - acked_start < count) {
+            if (!is_connected || k_uptime_get() >= deadline) {
+                shell_error(sh, "[BENCH] qos%d acked %u/%u before timeout", qos,
+                            pub_acked_count - acked_start, count);
+                return -ETIMEDOUT;
+            }
+            mqtt_pump_input(10);
+        }
+    }
+
+    int64_t elapsed = MAX(k_uptime_get() - start, 1);
+    *rate = (uint32_t)((uint64_t)count * 1000 / elapsed);
+    shell_print(sh, "[BENCH] qos%d msgs=%u size=%u ms=%lld rate=%u", qos, count,
+                (unsigned)size, (long long)elapsed, *rate);
     return 0;
 }
 
 /**
- * @brief mqtt_cli 命令注册，包含 conn / sub / pub 三个子命令
+ * @brief mqtt_cli bench — 测量连接延迟、QoS 0/1/2 发布吞吐与内存水位
+ *
+ * 超出阈值时输出 RESULT: FAIL 并返回 -EIO，可直接用于脚本化回归检查。
+ */
+static int cmd_mqtt_bench(const struct shell *sh, size_t argc, char **argv)
+{
+    sys_getopt_init();
+    int c, option_index = 0;
+    struct sys_getopt_state *state;
+    bool help_requested = false;
+
+    struct mqtt_conn_params p;
+    memset(&p, 0, sizeof(p));
+    strcpy(p.host, "127.0.0.1");
+    p.port = BENCH_DEFAULT_PORT;
+    p.keepalive = 60;
+
+    bool loopback = false;
+    uint32_t count = BENCH_DEFAULT_COUNT;
+    size_t size = BENCH_DEFAULT_SIZE;
+    uint32_t max_connect_ms = BENCH_DEFAULT_MAX_CONNECT_MS;
+    uint32_t min_rate = BENCH_DEFAULT_MIN_RATE;
+
+    while ((c = sys_getopt_long(argc, argv, "i:h:p:k:u:P:L:s:", long_options, &option_index)) != -1) {
+        state = sys_getopt_state_get();
+        switch (c) {
+            case 'i': strncpy(p.client_id, state->optarg, sizeof(p.client_id) - 1); break;
+            case 'h': strncpy(p.host, state->optarg, sizeof(p.host) - 1); break;
+            case 'p': p.port = atoi(state->optarg); break;
+            case 'k': p.keepalive = atoi(state->optarg); break;
+            case 'u': strncpy(p.username, state->optarg, sizeof(p.username) - 1); break;
+            case 'P': strncpy(p.password, state->optarg, sizeof(p.password) - 1); break;
+            case 'L': count = strtoul(state->optarg, NULL, 10); break;
+            case 's': size = strtoul(state->optarg, NULL, 10); break;
+            case OPT_LOOPBACK: loopback = true; break;
+            case OPT_MAX_CONNECT_MS: max_connect_ms = strtoul(state->optarg, NULL, 10); break;
+            case OPT_MIN_RATE: min_rate = strtoul(state->optarg, NULL, 10); break;
+            case OPT_KEY: strncpy(p.key_path, state->optarg, sizeof(p.key_path) - 1); p.use_tls = true; break;
+            case OPT_CERT: strncpy(p.cert_path, state->optarg, sizeof(p.cert_path) - 1); p.use_tls = true; break;
+            case OPT_CA: strncpy(p.ca_path, state->optarg, sizeof(p.ca_path) - 1); p.use_tls = true; break;
+            case OPT_INSECURE: p.insecure = true; break;
+            case OPT_NO_CLEAN: p.no_clean = true; break;
+            case OPT_MQTT5: p.mqtt5 = true; break;
+            case OPT_HELP: help_requested = true; break;
+        }
+    }
+
+    if (help_requested) {
+        print_bench_help(sh);
+        return 0;
+    }
+
+    if (count == 0 || count > 65535 || size == 0 || size > BENCH_MAX_SIZE) {
+        shell_error(sh, "Error: -L must be 1..65535 and -s must be 1..%d", BENCH_MAX_SIZE);
+        return -EINVAL;
+    }
+
+    int rc;
+    if (loopback) {
+        strcpy(p.host, "127.0.0.1");
+        rc = broker_stub_start(p.port);
+        if (rc != 0) {
+            shell_error(sh, "Error: Failed to start broker stand-in on port %d: %d", p.port, rc);
+            return rc;
+        }
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        bench_payload[i] = 'a' + (i % 26);
+    }
+    /* 填充收发缓冲区，测量结束后从尾部扫描得到实际使用水位 */
+    memset(rx_buffer, BENCH_PAINT_BYTE, sizeof(rx_buffer));
+    memset(tx_buffer, BENCH_PAINT_BYTE, sizeof(tx_buffer));
+
+    int64_t start = k_uptime_get();
+    rc = common_mqtt_connect(sh, &p);
+    if (rc != 0) { return rc; }
+    uint32_t connect_ms = (uint32_t)(k_uptime_get() - start);
+    shell_print(sh, "[BENCH] connect_ms=%u", connect_ms);
+
+    bool pass = connect_ms <= max_connect_ms;
+    for (int qos = 0; qos <= 2; qos++) {
+        uint32_t rate = 0;
+
+        rc = bench_publish_run(sh, qos, count, size, &rate);
+        if (rc != 0 || rate < min_rate) {
+            pass = false;
+        }
+        if (rc != 0) {
+            break;
+        }
+    }
+
+    print_topic_alias_stats(sh);
+    mqtt_disconnect(&client_ctx, NULL);
+
+    size_t rx_hw = buffer_high_water(rx_buffer, sizeof(rx_buffer));
+    size_t tx_hw = buffer_high_water(tx_buffer, sizeof(tx_buffer));
+    shell_print(sh, "[BENCH] rx_buffer_hw=%u/%u tx_buffer_hw=%u/%u",
+                (unsigned)rx_hw, (unsigned)sizeof(rx_buffer),
+                (unsigned)tx_hw, (unsigned)sizeof(tx_buffer));
+    /* 水位触顶意味着缓冲区已无余量，视为回归 */
+    if (rx_hw >= sizeof(rx_buffer) || tx_hw >= sizeof(tx_buffer)) {
+        pass = false;
+    }
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && (CONFIG_HEAP_MEM_POOL_SIZE > 0)
+    struct sys_memory_stats heap_stats;
+    sys_heap_runtime_stats_get(&_system_heap.heap, &heap_stats);
+    shell_print(sh, "[BENCH] heap_max_allocated=%u/%u heap_allocated=%u",
+                (unsigned)heap_stats.max_allocated_bytes, (unsigned)CONFIG_HEAP_MEM_POOL_SIZE,
+                (unsigned)heap_stats.allocated_bytes);
+    if (heap_stats.max_allocated_bytes * 10 > (size_t)CONFIG_HEAP_MEM_POOL_SIZE * 9) {
+        pass = false;
+    }
+#else
+    shell_print(sh, "[BENCH] heap stats unavailable (enable CONFIG_SYS_HEAP_RUNTIME_STATS)");
+#endif
+
+    if (loopback) {
+        struct broker_stub_stats stub;
+        broker_stub_stats_get(&stub);
+        shell_print(sh, "[BENCH] stub_publishes=%u stub_rx_bytes=%llu stub_alias_errors=%u",
+                    stub.publishes, (unsigned long long)stub.rx_bytes, stub.alias_errors);
+        /* 替身 broker 无法还原别名说明客户端别名分配有误 */
+        if (stub.alias_errors > 0) {
+            pass = false;
+        }
+    }
+
+    shell_print(sh, "[BENCH] RESULT: %s", pass ? "PASS" : "FAIL");
+    return pass ? 0 : -EIO;
+}
+
+/**
+ * @brief mqtt_cli 命令注册，包含 conn / sub / pub / bench 四个子命令
  */
 SHELL_STATIC_SUBCMD_SET_CREATE(mqtt_subcmds,
     SHELL_CMD(conn, NULL, "Test connection. Params: [-i ID] [-h HOST] [-p PORT] [-k KEEP] [-u USER] [-P PASS]", cmd_mqtt_conn),
-    SHELL_CMD(sub,  NULL, "Connect and subscribe. Params: -t <TOPIC> [-q QOS] [-h HOST] [-p PORT]", cmd_mqtt_sub),
-    SHELL_CMD(pub,  NULL, "Connect, publish and exit. Params: -t <TOPIC> -m <MSG> [-I ms] [-L limit]", cmd_mqtt_pub),
+    SHELL_CMD(sub,  NULL, "Connect and subscribe. Params: -t <TOPIC> [-t <TOPIC> ...] [-q QOS] [-h HOST] [-p PORT]", cmd_mqtt_sub),
+    SHELL_CMD(pub,  NULL, "Connect, publish and exit. Params: -t <TOPIC> -m <MSG> [-I ms] [-L limit] [-B batch]", cmd_mqtt_pub),
+    SHELL_CMD(bench, NULL, "Measure connect latency, QoS 0/1/2 throughput and memory. Params: [--loopback] [-L N] [-s BYTES]", cmd_mqtt_bench),
     SHELL_SUBCMD_SET_END
 );
 
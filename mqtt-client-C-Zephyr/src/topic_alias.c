@@ -0,0 +1,109 @@
+/**
+ * @file topic_alias.c
+ * @brief MQTT 5 Topic Alias 分配表实现
+ *
+ * 别名编号即表项下标 + 1。别名映射只在单个网络连接内有效，因此每次
+ * CONNACK 后都要调用 topic_alias_reset()。
+ */
+
+#include "topic_alias.h"
+
+#include <string.h>
+
+/** Topic Alias 属性开销：属性标识 0x23 + 2 字节别名 */
+#define TOPIC_ALIAS_PROP_LEN 3
+
+/**
+ * @brief 别名表项
+ */
+struct alias_entry {
+    char topic[TOPIC_ALIAS_TOPIC_LEN];
+    uint16_t len;     /**< 主题长度，0 表示空闲 */
+    uint16_t uses;    /**< 使用计数，用于 LFU 淘汰 */
+};
+
+static struct alias_entry entries[TOPIC_ALIAS_LOCAL_MAX];
+static uint16_t alias_max;
+static struct topic_alias_stats alias_stats;
+
+void topic_alias_reset(uint16_t server_max)
+{
+    memset(entries, 0, sizeof(entries));
+    alias_max = server_max < TOPIC_ALIAS_LOCAL_MAX ? server_max : TOPIC_ALIAS_LOCAL_MAX;
+}
+
+uint16_t topic_alias_resolve(const char *topic, size_t len, bool *send_topic)
+{
+    int free_idx = -1;
+    int victim = -1;
+
+    *send_topic = true;
+    if (alias_max == 0 || len == 0 || len >= TOPIC_ALIAS_TOPIC_LEN) {
+        alias_stats.misses++;
+        return 0;
+    }
+
+    for (int i = 0; i < alias_max; i++) {
+        struct alias_entry *e = &entries[i];
+
+        if (e->len == 0) {
+            if (free_idx < 0) {
+                free_idx = i;
+            }
+            continue;
+        }
+        if (e->len == len && memcmp(e->topic, topic, len) == 0) {
+            if (e->uses < UINT16_MAX) {
+                e->uses++;
+            }
+            *send_topic = false;
+            alias_stats.hits++;
+            return i + 1;
+        }
+        if (victim < 0 || e->uses < entries[victim].uses) {
+            victim = i;
+        }
+    }
+
+    int idx = free_idx;
+    if (idx < 0) {
+        /* 表已满：重新绑定最少使用的别名，并老化全部计数 */
+        idx = victim;
+        for (int i = 0; i < alias_max; i++) {
+            entries[i].uses /= 2;
+        }
+    }
+
+    memcpy(entries[idx].topic, topic, len);
+    entries[idx].len = len;
+    entries[idx].uses = 1;
+    alias_stats.assigned++;
+    alias_stats.misses++;
+    return idx + 1;
+}
+
+void topic_alias_commit(uint16_t alias, size_t len, bool sent_topic, bool ok)
+{
+    if (alias == 0 || alias > alias_max) {
+        return;
+    }
+    if (!ok) {
+        /* 绑定报文未发出，broker 不知道该别名：解除绑定，下次重新携带主题 */
+        if (sent_topic) {
+            entries[alias - 1].len = 0;
+            entries[alias - 1].uses = 0;
+        }
+        return;
+    }
+    if (sent_topic) {
+        /* 首次绑定仍携带完整主题，额外付出别名属性开销 */
+        alias_stats.bytes_saved -= TOPIC_ALIAS_PROP_LEN;
+    } else {
+        alias_stats.bytes_saved += (int64_t)len - TOPIC_ALIAS_PROP_LEN;
+    }
+}
+
+void topic_alias_stats_get(struct topic_alias_stats *stats)
+{
+    *stats = alias_stats;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file topic_alias.h
+ * @brief MQTT 5 客户端侧 Topic Alias 分配表
+ *
+ * 连接建立后按 CONNACK 中的 Topic Alias Maximum 初始化。发布时为主题分配
+ * 别名：首次发送携带完整主题 + 别名，之后只发送别名（主题为空字符串）。
+ * 表满时淘汰使用次数最少的别名，并对所有计数减半以适应负载变化。
+ */
+
+#ifndef TOPIC_ALIAS_H_
+#define TOPIC_ALIAS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** 客户端本地最多维护的别名数量 */
+#ifndef TOPIC_ALIAS_LOCAL_MAX
+#define TOPIC_ALIAS_LOCAL_MAX 8
+#endif
+
+/** 可分配别名的主题最大长度（含 NUL） */
+#ifndef TOPIC_ALIAS_TOPIC_LEN
+#define TOPIC_ALIAS_TOPIC_LEN 64
+#endif
+
+/**
+ * @brief 别名使用统计（跨连接累计）
+ */
+struct topic_alias_stats {
+    uint32_t assigned;     /**< 分配 / 重新绑定别名次数 */
+    uint32_t hits;         /**< 仅发送别名的 PUBLISH 次数 */
+    uint32_t misses;       /**< 未使用别名的 PUBLISH 次数 */
+    int64_t bytes_saved;   /**< 线上节省的字节数（已扣除别名属性开销） */
+};
+
+/**
+ * @brief 新连接建立后重置别名表
+ * @param server_max CONNACK 中 broker 允许的 Topic Alias Maximum（0 表示禁用）
+ */
+void topic_alias_reset(uint16_t server_max);
+
+/**
+ * @brief 为即将发送的主题解析别名
+ * @param topic      主题
+ * @param len        主题长度
+ * @param send_topic 输出：本次是否仍需携带完整主题
+ * @return 别名（1..N），0 表示本次不使用别名
+ */
+uint16_t topic_alias_resolve(const char *topic, size_t len, bool *send_topic);
+
+/**
+ * @brief 报告 topic_alias_resolve() 之后的发布结果
+ *
+ * 发布成功才计入 bytes_saved；携带完整主题的绑定报文发送失败时解除绑定，
+ * 避免之后只发别名而 broker 并不认识它。
+ * @param alias      topic_alias_resolve() 返回的别名，0 时忽略
+ * @param len        主题长度
+ * @param sent_topic 本次是否携带了完整主题
+ * @param ok         mqtt_publish() 是否成功
+ */
+void topic_alias_commit(uint16_t alias, size_t len, bool sent_topic, bool ok);
+
+/**
+ * @brief 读取统计快照
+ */
+void topic_alias_stats_get(struct topic_alias_stats *stats);
+
+#endif /* TOPIC_ALIAS_H_ */
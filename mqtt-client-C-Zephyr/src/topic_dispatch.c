@@ -0,0 +1,215 @@
+/**
+ * @file topic_dispatch.c
+ * @brief MQTT 主题分发 trie 实现
+ *
+ * 每个节点对应 filter 的一个层级，精确匹配的子节点以兄弟链表组织，
+ * '+' 子节点和以 '#' 结尾的路由单独挂在父节点上，匹配时无需遍历。
+ * 节点的层级字符串直接指向路由中保存的 filter 副本，不额外复制。
+ */
+
+#include "topic_dispatch.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define TRIE_NONE (-1)
+
+/**
+ * @brief trie 节点
+ */
+struct trie_node {
+    const char *level;    /**< 层级字符串（指向路由 filter 副本） */
+    uint16_t level_len;   /**< 层级长度 */
+    int16_t child;        /**< 第一个精确匹配子节点 */
+    int16_t sibling;      /**< 下一个兄弟节点 */
+    int16_t plus;         /**< '+' 子节点 */
+    int16_t route;        /**< 在本节点结束的路由 */
+    int16_t hash_route;   /**< 本节点下 '#' 对应的路由 */
+};
+
+/**
+ * @brief 路由：filter 副本 + 处理函数
+ */
+struct trie_route {
+    char filter[TOPIC_DISPATCH_FILTER_LEN];
+    topic_handler_t handler;
+    void *user_data;
+};
+
+static struct trie_node nodes[TOPIC_DISPATCH_MAX_NODES];
+static struct trie_route routes[TOPIC_DISPATCH_MAX_ROUTES];
+static int node_count;
+static int route_count;
+
+/** 分配一个空节点，调用方需保证池内有余量 */
+static int16_t node_alloc(const char *level, size_t len)
+{
+    struct trie_node *n = &nodes[node_count];
+
+    n->level = level;
+    n->level_len = len;
+    n->child = TRIE_NONE;
+    n->sibling = TRIE_NONE;
+    n->plus = TRIE_NONE;
+    n->route = TRIE_NONE;
+    n->hash_route = TRIE_NONE;
+    return node_count++;
+}
+
+void topic_dispatch_reset(void)
+{
+    node_count = 0;
+    route_count = 0;
+    node_alloc("", 0);  /* 根节点 */
+}
+
+/**
+ * @brief 校验 filter 合法性并返回层级数
+ *
+ * '+' 与 '#' 必须独占一个层级，'#' 只能出现在最后一层。
+ * @return 层级数，非法时返回 -EINVAL
+ */
+static int filter_levels(const char *filter)
+{
+    size_t len = strlen(filter);
+    int levels = 1;
+
+    if (len == 0 || len >= TOPIC_DISPATCH_FILTER_LEN) {
+        return -EINVAL;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char ch = filter[i];
+        bool level_start = (i == 0 || filter[i - 1] == '/');
+        bool level_end = (i + 1 == len || filter[i + 1] == '/');
+
+        if (ch == '/') {
+            levels++;
+        } else if (ch == '+' && !(level_start && level_end)) {
+            return -EINVAL;
+        } else if (ch == '#' && !(level_start && i + 1 == len)) {
+            return -EINVAL;
+        }
+    }
+    return levels;
+}
+
+int topic_dispatch_add(const char *filter, topic_handler_t handler, void *user_data)
+{
+    if (node_count == 0) {
+        topic_dispatch_reset();
+    }
+
+    int levels = filter_levels(filter);
+    if (levels < 0 || handler == NULL) {
+        return -EINVAL;
+    }
+    /* 预先检查节点余量，避免插入到一半失败留下悬空节点 */
+    if (route_count >= TOPIC_DISPATCH_MAX_ROUTES ||
+        node_count + levels > TOPIC_DISPATCH_MAX_NODES) {
+        return -ENOMEM;
+    }
+
+    /* 暂存到下一个空闲路由槽；若 filter 已存在则不会有节点引用它 */
+    struct trie_route *r = &routes[route_count];
+    strcpy(r->filter, filter);
+
+    int16_t idx = 0;
+    int16_t *slot = NULL;
+    const char *level = r->filter;
+
+    while (level) {
+        const char *sep = strchr(level, '/');
+        size_t len = sep ? (size_t)(sep - level) : strlen(level);
+        struct trie_node *n = &nodes[idx];
+
+        if (len == 1 && level[0] == '#') {
+            slot = &n->hash_route;
+            break;
+        }
+        if (len == 1 && level[0] == '+') {
+            if (n->plus == TRIE_NONE) {
+                n->plus = node_alloc(level, len);
+            }
+            idx = n->plus;
+        } else {
+            int16_t c = n->child;
+            while (c != TRIE_NONE &&
+                   !(nodes[c].level_len == len && memcmp(nodes[c].level, level, len) == 0)) {
+                c = nodes[c].sibling;
+            }
+            if (c == TRIE_NONE) {
+                c = node_alloc(level, len);
+                nodes[c].sibling = n->child;
+                nodes[idx].child = c;
+            }
+            idx = c;
+        }
+        level = sep ? sep + 1 : NULL;
+    }
+    if (slot == NULL) {
+        slot = &nodes[idx].route;
+    }
+
+    if (*slot == TRIE_NONE) {
+        *slot = route_count++;
+    }
+    routes[*slot].handler = handler;
+    routes[*slot].user_data = user_data;
+    return 0;
+}
+
+static int route_invoke(int16_t route, const struct topic_msg *msg)
+{
+    const struct trie_route *r = &routes[route];
+
+    r->handler(msg, r->filter, r->user_data);
+    return 1;
+}
+
+/**
+ * @brief 从节点 idx 开始匹配剩余主题
+ * @param level 当前层级起点；NULL 表示主题已全部消费
+ * @param end   主题结束位置
+ */
+static int trie_match(int16_t idx, const char *level, const char *end, const struct topic_msg *msg)
+{
+    const struct trie_node *n = &nodes[idx];
+    /* 以 '$' 开头的系统主题不参与根层级通配符匹配 */
+    bool wildcard_ok = !(idx == 0 && level < end && level[0] == '$');
+    int hits = 0;
+
+    /* "a/#" 同时匹配 "a" 本身及其所有子层级 */
+    if (n->hash_route != TRIE_NONE && wildcard_ok) {
+        hits += route_invoke(n->hash_route, msg);
+    }
+    if (level == NULL) {
+        if (n->route != TRIE_NONE) {
+            hits += route_invoke(n->route, msg);
+        }
+        return hits;
+    }
+
+    const char *sep = memchr(level, '/', end - level);
+    size_t len = sep ? (size_t)(sep - level) : (size_t)(end - level);
+    const char *next = sep ? sep + 1 : NULL;
+
+    for (int16_t c = n->child; c != TRIE_NONE; c = nodes[c].sibling) {
+        if (nodes[c].level_len == len && memcmp(nodes[c].level, level, len) == 0) {
+            hits += trie_match(c, next, end, msg);
+            break;
+        }
+    }
+    if (n->plus != TRIE_NONE && wildcard_ok) {
+        hits += trie_match(n->plus, next, end, msg);
+    }
+    return hits;
+}
+
+int topic_dispatch_publish(const struct topic_msg *msg)
+{
+    if (node_count == 0 || msg->topic_len == 0) {
+        return 0;
+    }
+    return trie_match(0, msg->topic, msg->topic + msg->topic_len, msg);
+}
@@ -0,0 +1,70 @@
+/**
+ * @file topic_dispatch.h
+ * @brief 基于通配符前缀树（trie）的 MQTT 主题分发表
+ *
+ * 订阅时通过 topic_dispatch_add() 注册 topic filter 与处理函数，收到
+ * PUBLISH 后调用 topic_dispatch_publish() 将消息路由到所有匹配的处理函数。
+ * 匹配按主题层级逐级下降，支持 '+' 单层与 '#' 多层通配符，开销只与主题
+ * 层数及每层分支数相关，不随订阅数量线性增长。
+ *
+ * 所有节点与路由均来自静态池，不使用堆内存。
+ */
+
+#ifndef TOPIC_DISPATCH_H_
+#define TOPIC_DISPATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** 分发表最多容纳的 topic filter 数量 */
+#ifndef TOPIC_DISPATCH_MAX_ROUTES
+#define TOPIC_DISPATCH_MAX_ROUTES 16
+#endif
+
+/** trie 节点池大小（每个 filter 层级最多占用一个节点） */
+#ifndef TOPIC_DISPATCH_MAX_NODES
+#define TOPIC_DISPATCH_MAX_NODES 64
+#endif
+
+/** 单个 topic filter 的最大长度（含 NUL） */
+#ifndef TOPIC_DISPATCH_FILTER_LEN
+#define TOPIC_DISPATCH_FILTER_LEN 64
+#endif
+
+/**
+ * @brief 分发给处理函数的消息视图（指针仅在回调期间有效）
+ */
+struct topic_msg {
+    const char *topic;        /**< 实际主题（非 NUL 结尾） */
+    size_t topic_len;         /**< 主题长度 */
+    const uint8_t *payload;   /**< 已读取的 payload */
+    size_t payload_len;       /**< payload 长度 */
+    uint8_t qos;              /**< 消息 QoS */
+};
+
+/**
+ * @brief 主题处理函数
+ * @param msg       消息视图
+ * @param filter    命中的 topic filter
+ * @param user_data 注册时传入的上下文
+ */
+typedef void (*topic_handler_t)(const struct topic_msg *msg, const char *filter, void *user_data);
+
+/**
+ * @brief 清空分发表，释放所有节点与路由
+ */
+void topic_dispatch_reset(void);
+
+/**
+ * @brief 注册 topic filter 与处理函数；相同 filter 重复注册时覆盖处理函数
+ * @return 0 成功，-EINVAL filter 非法，-ENOMEM 静态池不足
+ */
+int topic_dispatch_add(const char *filter, topic_handler_t handler, void *user_data);
+
+/**
+ * @brief 将消息分发到所有匹配的处理函数
+ * @return 命中的处理函数数量
+ */
+int topic_dispatch_publish(const struct topic_msg *msg);
+
+#endif /* TOPIC_DISPATCH_H_ */
@@ -14,6 +14,8 @@
 #include <nng/supplemental/util/options.h>
 #include <nng/supplemental/util/platform.h>
 
+#include "stamp.h"
+
 static void
 fatal(const char *msg, ...)
 {
@@ -45,6 +47,9 @@ typedef struct {
 	bool    enable_sqlite;
 	char *  username;
 	char *  password;
+	bool    stamp;
+	bool    stats;
+	bool    reuse_msg;
 } client_opts;
 
 enum options {
@@ -60,6 +65,9 @@ enum options {
 	OPT_USERNAME,
 	OPT_PASSWORD,
 	OPT_SQLITE,
+	OPT_STAMP,
+	OPT_STATS,
+	OPT_REUSE_MSG,
 };
 
 static nng_optspec cmd_opts[] = {
@@ -74,6 +82,9 @@ static nng_optspec cmd_opts[] = {
 	    .o_arg   = true },
 	{ .o_name = "url", .o_val = OPT_URL, .o_arg = true },
 	{ .o_name = "sqlite", .o_val = OPT_SQLITE },
+	{ .o_name = "stamp", .o_val = OPT_STAMP },
+	{ .o_name = "stats", .o_val = OPT_STATS },
+	{ .o_name = "reuse-msg", .o_val = OPT_REUSE_MSG },
 	{ .o_name = "secure", .o_short = 's', .o_val = OPT_SECURE },
 	{ .o_name = "cacert", .o_val = OPT_CACERT, .o_arg = true },
 	{ .o_name = "key", .o_val = OPT_KEYFILE, .o_arg = true },
@@ -156,6 +167,15 @@ client_parse_opts(int argc, char **argv, client_opts *opt)
 		case OPT_SQLITE:
 			opt->enable_sqlite = true;
 			break;
+		case OPT_STAMP:
+			opt->stamp = true;
+			break;
+		case OPT_STATS:
+			opt->stats = true;
+			break;
+		case OPT_REUSE_MSG:
+			opt->reuse_msg = true;
+			break;
 		case OPT_SECURE:
 			opt->enable_ssl = true;
 			break;
@@ -239,6 +259,75 @@ struct work {
 #define SUB_TOPIC2 "/nanomq/msg/2"
 #define SUB_TOPIC3 "/nanomq/msg/3"
 
+#define FORWARD_TOPIC "/nanomq/msg/transfer"
+#define REPORT_MS 10000
+
+// Every forwarded PUBLISH is a fresh nng_mqtt_msg_alloc() message, so the
+// received message still holds the payload while it is copied in, and
+// nothing is shared between messages in flight. --reuse-msg clears and
+// reuses the received message instead, which needs the payload copied out
+// to a temporary buffer first.
+static bool reuse_msg = false;
+
+// The works run in parallel, the counters below are shared under stats_mtx.
+static nng_mtx *stats_mtx;
+
+// --stats: forwarded messages and their CPU time, instead of a line per
+// message. forward_cpu_ns is thread CPU spent in the WAIT state.
+static bool     reporting      = false;
+static uint64_t forwarded      = 0;
+static uint64_t forward_cpu_ns = 0;
+
+// --stamp: parse the send stamp (stamp.h) of received messages, and put a
+// fresh one on every forwarded message.
+static bool        stamping = false;
+static stamp_stats stamp_recv;
+static uint32_t    stamp_seq      = 0;
+static uint64_t    stamp_write_ns = 0;
+
+static uint64_t
+cpu_now_ns(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec);
+}
+
+// Called every REPORT_MS with stats_mtx held
+static void
+report(void)
+{
+	static uint64_t last_forwarded = 0;
+	static uint64_t last_cpu_ns    = 0;
+	static uint64_t last_proc_ns   = 0;
+
+	uint64_t proc_ns = cpu_now_ns(CLOCK_PROCESS_CPUTIME_ID);
+	uint64_t n       = forwarded - last_forwarded;
+
+	if (reporting) {
+		printf("forward: %llu msgs, %llu msg/s, build %llu ns/msg, "
+		       "process %llu ns/msg CPU (msg %s)\n",
+		    (unsigned long long) forwarded,
+		    (unsigned long long) (n * 1000 / REPORT_MS),
+		    (unsigned long long) (n ? (forward_cpu_ns - last_cpu_ns) / n
+		                            : 0),
+		    (unsigned long long) (n ? (proc_ns - last_proc_ns) / n : 0),
+		    reuse_msg ? "reused" : "fresh");
+	}
+	last_forwarded = forwarded;
+	last_cpu_ns    = forward_cpu_ns;
+	last_proc_ns   = proc_ns;
+
+	if (stamping) {
+		printf("stamp: forwarded %u, write cost %llu ns/msg\n",
+		    stamp_seq,
+		    (unsigned long long) (stamp_seq ? stamp_write_ns / stamp_seq
+		                                    : 0));
+		stamp_stats_print(stdout, "stamp", &stamp_recv);
+	}
+	fflush(stdout);
+}
+
 void
 client_cb(void *arg)
 {
@@ -268,6 +357,8 @@ client_cb(void *arg)
 
 	case WAIT:
 		msg = work->msg;
+		uint64_t cpu_start =
+		    reporting ? cpu_now_ns(CLOCK_THREAD_CPUTIME_ID) : 0;
 
 		// Get PUBLISH payload and topic from msg;
 		uint32_t payload_len;
@@ -277,26 +368,75 @@ client_cb(void *arg)
 		const char *recv_topic =
 		    nng_mqtt_msg_get_publish_topic(msg, &topic_len);
 
-		printf("RECV: '%.*s' FROM: '%.*s'\n", payload_len,
-		    (char *) payload, topic_len, recv_topic);
+		uint32_t send_len = payload_len;
+		uint32_t skip     = 0;
+		uint32_t seq      = 0;
+		uint64_t start;
+		if (stamping) {
+			nng_mtx_lock(stats_mtx);
+			skip = stamp_stats_receive(
+			    &stamp_recv, payload, payload_len);
+			seq = stamp_seq++;
+			nng_mtx_unlock(stats_mtx);
+			payload += skip;
+			payload_len -= skip;
+			send_len = STAMP_SIZE + payload_len;
+		}
 
-		uint8_t *send_data = nng_alloc(payload_len);
-		memcpy(send_data, payload, payload_len);
+		if (!reporting) {
+			printf("RECV: '%.*s' FROM: '%.*s'\n", payload_len,
+			    (char *) payload, topic_len, recv_topic);
+		}
+
+		// nng_mqtt_msg_set_publish_payload copies the payload into the
+		// outgoing message. A temporary copy is only needed to stamp
+		// it, or when msg is reused below (clearing it frees the payload)
+		uint8_t *send_data = payload;
+		if (stamping) {
+			send_data = nng_alloc(send_len);
+			start     = stamp_now_ns();
+			stamp_write(send_data, seq);
+			memcpy(send_data + STAMP_SIZE, payload, payload_len);
+			nng_mtx_lock(stats_mtx);
+			stamp_write_ns += stamp_now_ns() - start;
+			nng_mtx_unlock(stats_mtx);
+		} else if (reuse_msg) {
+			send_data = nng_alloc(send_len);
+			memcpy(send_data, payload, payload_len);
+		}
 
-		nng_msg_header_clear(work->msg);
-		nng_msg_clear(work->msg);
+		if (reuse_msg) {
+			nng_msg_header_clear(work->msg);
+			nng_msg_clear(work->msg);
+		} else if ((rv = nng_mqtt_msg_alloc(&work->msg, 0)) != 0) {
+			fatal("nng_mqtt_msg_alloc: %s", nng_strerror(rv));
+		}
 
-		// Send payload to topic "/nanomq/msg/transfer"
-		char *topic = "/nanomq/msg/transfer";
+		// Send payload to FORWARD_TOPIC
 		nng_mqtt_msg_set_packet_type(work->msg, NNG_MQTT_PUBLISH);
-		nng_mqtt_msg_set_publish_topic(work->msg, topic);
-		nng_mqtt_msg_set_publish_payload(
-		    work->msg, send_data, payload_len);
+		nng_mqtt_msg_set_publish_topic(work->msg, FORWARD_TOPIC);
+		nng_mqtt_msg_set_publish_payload(work->msg, send_data, send_len);
 
-		printf("SEND: '%.*s' TO:   '%s'\n", payload_len,
-		    (char *) send_data, topic);
+		if (!reporting) {
+			printf("SEND: '%.*s' TO:   '%s'\n", payload_len,
+			    (char *) send_data + (send_len - payload_len),
+			    FORWARD_TOPIC);
+		}
 
-		nng_free(send_data, payload_len);
+		if (send_data != payload) {
+			nng_free(send_data, send_len);
+		}
+		if (work->msg != msg) {
+			nng_msg_free(msg);
+		}
+		if (reporting) {
+			uint64_t cpu_ns =
+			    cpu_now_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+			nng_mtx_lock(stats_mtx);
+			forwarded++;
+			forward_cpu_ns += cpu_ns;
+			nng_mtx_unlock(stats_mtx);
+		}
 		nng_aio_set_msg(work->aio, work->msg);
 		work->msg   = NULL;
 		work->state = SEND;
@@ -429,6 +569,17 @@ client(client_opts *opts)
 	}
 #endif
 
+	if ((rv = nng_mtx_alloc(&stats_mtx)) != 0) {
+		fatal("nng_mtx_alloc: %s", nng_strerror(rv));
+	}
+	if (opts->stamp) {
+		stamp_stats_init(&stamp_recv);
+		stamping = true;
+	}
+	reporting = opts->stats;
+
+	reuse_msg = opts->reuse_msg;
+
 	for (i = 0; i < opts->parallel; i++) {
 		works[i] = alloc_work(sock);
 	}
@@ -472,7 +623,15 @@ client(client_opts *opts)
 	}
 
 	for (;;) {
-		nng_msleep(3600000); // neither pause() nor sleep() portable
+		if (!reporting && !stamping) {
+			// neither pause() nor sleep() portable
+			nng_msleep(3600000);
+			continue;
+		}
+		nng_msleep(REPORT_MS);
+		nng_mtx_lock(stats_mtx);
+		report();
+		nng_mtx_unlock(stats_mtx);
 	}
 
 #if defined(NNG_SUPP_SQLITE)
@@ -591,6 +750,12 @@ usage(void)
 	printf("    -u, --username   <username>\n");
 	printf("    -P, --password   <password>\n");
 	printf("    --sqlite         enable sqlite cache (default: false)\n");
+	printf("    --stamp          send stamp on forwarded messages,\n"
+	       "                     one-way latency report (default: false)\n");
+	printf("    --stats          report msg/s and CPU per forwarded\n"
+	       "                     message instead of printing each one\n");
+	printf("    --reuse-msg      forward in the received message,\n"
+	       "                     not a fresh one (extra payload copy)\n");
 	printf(
 	    "    -s, --secure     enable ssl/tls mode (default: disable)\n");
 	printf("    --cacert         <cafile path>\n");
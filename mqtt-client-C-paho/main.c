@@ -2,6 +2,7 @@
 #include "string.h"
 #include "unistd.h"
 #include "MQTTClient.h"
+#include "stamp.h"
 
 #define ADDRESS     "tcp://broker.emqx.io:1883"
 #define USERNAME    "emqx"
@@ -11,10 +12,27 @@
 #define TOPIC       "emqx/c-test"
 #define TIMEOUT     10000L
 
+// --stamp: prefix every payload with a send stamp (stamp.h) and report the
+// one-way latency, gaps and reordering of the received ones at the end
+static int stamping = 0;
+static uint32_t stamp_seq = 0;
+static uint64_t stamp_write_ns = 0;
+static stamp_stats received_stats;
+
 void publish(MQTTClient client, char *topic, char *payload) {
+    char buf[STAMP_SIZE + 64];
+    int len = strlen(payload);
     MQTTClient_message message = MQTTClient_message_initializer;
     message.payload = payload;
-    message.payloadlen = strlen(payload);
+    message.payloadlen = len;
+    if (stamping && len <= 64) {
+        uint64_t start = stamp_now_ns();
+        stamp_write((uint8_t *) buf, stamp_seq++);
+        memcpy(buf + STAMP_SIZE, payload, len);
+        stamp_write_ns += stamp_now_ns() - start;
+        message.payload = buf;
+        message.payloadlen = STAMP_SIZE + len;
+    }
     message.qos = QOS;
     message.retained = 0;
     MQTTClient_deliveryToken token;
@@ -25,7 +43,13 @@ void publish(MQTTClient client, char *topic, char *payload) {
 
 int on_message(void *context, char *topicName, int topicLen, MQTTClient_message *message) {
     char *payload = message->payload;
-    printf("Received `%s` from `%s` topic \n", payload, topicName);
+    int len = message->payloadlen;
+    if (stamping) {
+        size_t skip = stamp_stats_receive(&received_stats, payload, len);
+        payload += skip;
+        len -= (int) skip;
+    }
+    printf("Received `%.*s` from `%s` topic \n", len, payload, topicName);
     MQTTClient_freeMessage(&message);
     MQTTClient_free(topicName);
     return 1;
@@ -35,6 +59,8 @@ int main(int argc, char *argv[]) {
     int rc;
     MQTTClient client;
 
+    stamping = argc > 1 && strcmp(argv[1], "--stamp") == 0;
+    stamp_stats_init(&received_stats);
     MQTTClient_create(&client, ADDRESS, CLIENTID, 0, NULL);
     MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer;
     conn_opts.username = USERNAME;
@@ -57,5 +83,10 @@ int main(int argc, char *argv[]) {
     }
     MQTTClient_disconnect(client, TIMEOUT);
     MQTTClient_destroy(&client);
+    if (stamping) {
+        printf("stamp: sent %u, write cost %llu ns/msg\n", stamp_seq,
+               (unsigned long long) (stamp_seq ? stamp_write_ns / stamp_seq : 0));
+        stamp_stats_print(stdout, "stamp", &received_stats);
+    }
     return rc;
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+/*
+ * stamp.h - optional send stamp at the front of a payload
+ *
+ * 16 bytes, multi-byte fields big-endian:
+ *
+ *   0   'M' 'S'   magic
+ *   2   1         version
+ *   3   0         flags, reserved
+ *   4   uint32    sequence number, +1 per message of one publisher
+ *   8   uint64    send time, CLOCK_MONOTONIC in ns
+ *
+ * The Qt and nng examples use the same layout. CLOCK_MONOTONIC is shared by
+ * all processes of one host, so the one-way latency is only meaningful when
+ * publisher and subscriber run on the same machine (any broker in between).
+ *
+ * stamp_stats keeps a log-linear latency histogram (16 linear sub-buckets
+ * per power of two, percentiles within ~6%) and follows the sequence
+ * numbers: a jump forward is a gap, an older number a late (reordered)
+ * message, which also fills one missing slot of an earlier gap. A duplicate
+ * (e.g. a QoS 1 redelivery) looks like a late message too.
+ */
+#ifndef STAMP_H
+#define STAMP_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define STAMP_SIZE      16
+#define STAMP_VERSION   1
+#define STAMP_SUB_BITS  4
+#define STAMP_SUB       (1 << STAMP_SUB_BITS)
+#define STAMP_BUCKETS   ((64 - STAMP_SUB_BITS + 1) * STAMP_SUB)
+
+typedef struct {
+    uint64_t buckets[STAMP_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t unstamped;     // messages without a stamp
+    uint32_t next_seq;      // expected next sequence number
+    uint64_t gaps;          // jumps forward
+    uint64_t missing;       // skipped numbers that never showed up (yet)
+    uint64_t reordered;     // numbers older than expected
+    uint64_t cost_ns;       // time spent in stamp_stats_receive, clock reads included
+    uint64_t cost_count;
+} stamp_stats;
+
+static inline uint64_t stamp_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static inline void stamp_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) v;
+}
+
+static inline uint32_t stamp_get32(const uint8_t *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+// Writes the stamp to buf, which must hold STAMP_SIZE bytes
+static inline void stamp_write(uint8_t *buf, uint32_t seq) {
+    uint64_t now = stamp_now_ns();
+    buf[0] = 'M';
+    buf[1] = 'S';
+    buf[2] = STAMP_VERSION;
+    buf[3] = 0;
+    stamp_put32(buf + 4, seq);
+    stamp_put32(buf + 8, (uint32_t) (now >> 32));
+    stamp_put32(buf + 12, (uint32_t) now);
+}
+
+// 1 and the fields if payload starts with a stamp, 0 otherwise
+static inline int stamp_read(const void *payload, size_t len, uint32_t *seq, uint64_t *sent_ns) {
+    const uint8_t *p = payload;
+    if (len < STAMP_SIZE || p[0] != 'M' || p[1] != 'S' || p[2] != STAMP_VERSION)
+        return 0;
+    *seq = stamp_get32(p + 4);
+    *sent_ns = ((uint64_t) stamp_get32(p + 8) << 32) | stamp_get32(p + 12);
+    return 1;
+}
+
+static inline void stamp_stats_init(stamp_stats *s) {
+    memset(s, 0, sizeof(*s));
+}
+
+static inline int stamp_bucket(uint64_t v) {
+    int shift = 0;
+    if (v < STAMP_SUB)
+        return (int) v;
+    while ((v >> shift) >= 2 * STAMP_SUB)
+        shift++;
+    return (shift + 1) * STAMP_SUB + (int) ((v >> shift) & (STAMP_SUB - 1));
+}
+
+static inline uint64_t stamp_bucket_upper(int bucket) {
+    int shift;
+    if (bucket < STAMP_SUB)
+        return (uint64_t) bucket;
+    shift = bucket / STAMP_SUB - 1;
+    return (((uint64_t) STAMP_SUB | (uint64_t) (bucket % STAMP_SUB)) << shift) + ((uint64_t) 1 << shift) - 1;
+}
+
+// Parses a received payload and records latency and sequence; returns the
+// number of bytes to skip to get to the application payload
+static inline size_t stamp_stats_receive(stamp_stats *s, const void *payload, size_t len) {
+    uint64_t start = stamp_now_ns();
+    uint32_t seq;
+    uint64_t sent_ns;
+    uint64_t latency;
+
+    if (!stamp_read(payload, len, &seq, &sent_ns)) {
+        s->unstamped++;
+        return 0;
+    }
+    // Clamped: a stamp from another host's clock can be ahead of ours
+    latency = start > sent_ns ? start - sent_ns : 0;
+    s->buckets[stamp_bucket(latency)]++;
+    if (s->count == 0 || latency < s->min)
+        s->min = latency;
+    if (latency > s->max)
+        s->max = latency;
+    s->sum += latency;
+
+    if (s->count > 0 && seq != s->next_seq) {
+        if ((int32_t) (seq - s->next_seq) > 0) {
+            s->gaps++;
+            s->missing += seq - s->next_seq;
+        } else {
+            s->reordered++;
+            if (s->missing > 0)
+                s->missing--;
+        }
+    }
+    if (s->count == 0 || (int32_t) (seq - s->next_seq) >= 0)
+        s->next_seq = seq + 1;
+    s->count++;
+
+    s->cost_ns += stamp_now_ns() - start;
+    s->cost_count++;
+    return STAMP_SIZE;
+}
+
+// Upper bound of the bucket holding the p-th percentile (0..100), in ns
+static inline uint64_t stamp_stats_percentile(const stamp_stats *s, double p) {
+    uint64_t rank = (uint64_t) (p / 100.0 * (double) s->count + 0.5);
+    uint64_t seen = 0;
+    int i;
+    if (s->count == 0)
+        return 0;
+    if (rank < 1)
+        rank = 1;
+    for (i = 0; i < STAMP_BUCKETS; i++) {
+        seen += s->buckets[i];
+        if (seen >= rank) {
+            uint64_t upper = stamp_bucket_upper(i);
+            return upper < s->max ? upper : s->max;
+        }
+    }
+    return s->max;
+}
+
+static inline void stamp_stats_print(FILE *out, const char *prefix, const stamp_stats *s) {
+    fprintf(out, "%s: stamped %llu, unstamped %llu, one-way latency min %llu p50 %llu p90 %llu "
+                 "p99 %llu max %llu us\n",
+            prefix, (unsigned long long) s->count, (unsigned long long) s->unstamped,
+            (unsigned long long) (s->min / 1000),
+            (unsigned long long) (stamp_stats_percentile(s, 50) / 1000),
+            (unsigned long long) (stamp_stats_percentile(s, 90) / 1000),
+            (unsigned long long) (stamp_stats_percentile(s, 99) / 1000),
+            (unsigned long long) (s->max / 1000));
+    fprintf(out, "%s: gaps %llu, missing %llu, reordered %llu, parse cost %llu ns/msg\n",
+            prefix, (unsigned long long) s->gaps, (unsigned long long) s->missing,
+            (unsigned long long) s->reordered,
+            (unsigned long long) (s->cost_count ? s->cost_ns / s->cost_count : 0));
+}
+
+#endif // STAMP_H
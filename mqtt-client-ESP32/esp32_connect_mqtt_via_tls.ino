@@ -1,6 +1,6 @@
 #include <WiFi.h>
 #include <PubSubClient.h>
-#include <WiFiClientSecure.h>
+#include <TlsSessionClient.h>
 
 // WiFi credentials
 const char *ssid = "WIFI_SSID";             // Replace with your WiFi name
@@ -14,7 +14,7 @@ const char *mqtt_password = "public";
 const int mqtt_port = 8883;
 
 // WiFi and MQTT client initialization
-WiFiClientSecure esp_client;
+TlsSessionClient esp_client; // Parses the CA once and resumes the TLS session on reconnect
 PubSubClient mqtt_client(esp_client);
 
 // Root CA Certificate
@@ -1,7 +1,9 @@
 #include <WiFi.h>
 #include <PubSubClient.h>
-#include <WiFiClientSecure.h>
-#include <ArduinoJson.h>
+#include <TlsSessionClient.h>
+#include <MqttReconnect.h>
+#include <SampleRing.h>
+#include <TelemetryJson.h>
 
 // WiFi credentials
 const char *ssid = "WIFI_SSID"; // Replace with your WiFi name
@@ -15,12 +17,49 @@ const char *mqtt_password = "public";
 const int mqtt_port = 8883;
 
 // WiFi and MQTT client initialization
-WiFiClientSecure esp_client;
+TlsSessionClient esp_client; // Parses the CA once and resumes the TLS session on reconnect
 PubSubClient mqtt_client(esp_client);
+char client_id[40];
+MqttReconnect mqtt_connection(mqtt_client, client_id, mqtt_username, mqtt_password);
 
 // GPIO pin for Soil Moisture, ESP32 pin GPIO36 (ADC0) that connects to AOUT pin of moisture sensor
 #define sensorPIN 36
 
+// Sampling
+const unsigned long sample_interval_ms = 60000; // Delay between readings
+unsigned long last_sample_ms = 0;
+bool has_sampled = false;
+
+// Readings wait here until they are published, so nothing is lost while offline
+struct Reading {
+    unsigned long ts;   // millis() when sampled
+    int moisture;
+};
+SampleRing<Reading, 32> pending_readings;
+
+// Deep-sleep batch mode: keep readings in RTC memory between deep sleeps and
+// only bring up Wi-Fi/TLS once every batch_size readings. 0 = stay connected.
+#define DEEP_SLEEP_BATCH 0
+
+#if DEEP_SLEEP_BATCH
+#include <SleepBatch.h>
+
+const uint16_t batch_size = 10;               // Readings per PUBLISH
+const uint16_t batch_retry_wakes = 5;         // Wakes to wait after a failed publish
+const unsigned long wifi_timeout_ms = 10000;  // Give up and sleep after this
+RTC_DATA_ATTR SleepBatch<Reading, 30> sleep_batch;
+
+// One PUBLISH carries at most batch_size readings; more are waiting after
+// failed attempts and go out in several messages. Sized for the widest
+// fields: 10-digit ts and awake_ms_per_sample, moisture as "-2147483648",
+// tls_per_hour as "-8999999999.99" (TelemetryJson writes null beyond
+// that), plus NUL.
+const size_t batch_json_size = sizeof("{\"readings\":[]}") - 1
+    + batch_size * (sizeof("{\"ts\":,\"moisture\":},") - 1 + 10 + 11)
+    + sizeof(",\"awake_ms_per_sample\":") - 1 + 10
+    + sizeof(",\"tls_per_hour\":") - 1 + 14 + 1;
+#endif
+
 // Root CA Certificate
 // Load DigiCert Global Root G2, which is used by EMQX Public Broker: broker.emqx.io
 const char *ca_cert = R"EOF(
@@ -79,16 +118,25 @@ CAUw7C29C79Fv1C5qfPrmAESrciIxpg0X40KPMbp1ZWVbd4=
 // Function Declarations
 void connectToWiFi();
 
-void connectToMQTT();
+void setupMQTT();
+
+bool publishSensorData(const Reading &reading);
+
+void publishPendingReadings();
 
-void initializeSensors();
+#if DEEP_SLEEP_BATCH
+void runSleepCycle();
 
-void publishSensorData();
+bool publishBatch();
+#endif
 
 void setup() {
     Serial.begin(115200);
+#if DEEP_SLEEP_BATCH
+    runSleepCycle(); // Ends in deep sleep, the next wake starts over in setup()
+#endif
     connectToWiFi();
-    connectToMQTT();
+    setupMQTT();
 }
 
 void connectToWiFi() {
@@ -101,44 +149,130 @@ void connectToWiFi() {
     Serial.println("\nConnected to WiFi");
 }
 
-void connectToMQTT() {
+void setupMQTT() {
     esp_client.setCACert(ca_cert);
     mqtt_client.setServer(mqtt_broker, mqtt_port);
     mqtt_client.setKeepAlive(60);
+    snprintf(client_id, sizeof(client_id), "esp32-client-%s", WiFi.macAddress().c_str());
+    // The connection itself is made from loop() by mqtt_connection
+}
+
 
-    while (!mqtt_client.connected()) {
-        String client_id = "esp32-client-" + String(WiFi.macAddress());
-        Serial.printf("Connecting to MQTT Broker as %s...\n", client_id.c_str());
-        if (mqtt_client.connect(client_id.c_str(), mqtt_username, mqtt_password)) {
-            Serial.println("Connected to MQTT Broker");
-        } else {
-            Serial.print("Failed to connect, rc=");
-            Serial.print(mqtt_client.state());
-            Serial.println(" Retrying in 5 seconds.");
-            delay(5000);
+bool publishSensorData(const Reading &reading) {
+    static char json_buffer[64];
+    unsigned long encode_start = micros();
+    TelemetryJson json(json_buffer, sizeof(json_buffer));
+    json.add("moisture", reading.moisture);
+    json.add("ts", reading.ts);
+    const char *payload = json.finish();
+    unsigned long encode_us = micros() - encode_start;
+
+    if (!payload || !mqtt_client.publish(mqtt_topic, (const uint8_t *) payload, json.length(), false)) {
+        return false;
+    }
+    Serial.printf("Published to %s: %d (encoded in %lu us)\n", mqtt_topic, reading.moisture, encode_us);
+    return true;
+}
+
+void publishPendingReadings() {
+    // Oldest first, keep the rest for the next pass if a publish fails
+    while (!pending_readings.empty() && mqtt_connection.connected()) {
+        if (!publishSensorData(pending_readings.front())) {
+            break;
         }
+        pending_readings.pop();
+    }
+}
+
+#if DEEP_SLEEP_BATCH
+void runSleepCycle() {
+    if (sleep_batch.begin()) {
+        Serial.println("[SLEEP] Cold boot, batch cleared");
+    }
+    sleep_batch.add({(unsigned long) sleep_batch.now(), analogRead(sensorPIN)});
+
+    if (sleep_batch.due(batch_size)) {
+        bool ok = publishBatch();
+        sleep_batch.published(ok, batch_retry_wakes);
+        WiFi.disconnect(true);
     }
+    sleep_batch.report();
+    sleep_batch.sleep(sample_interval_ms);
 }
 
+bool publishBatch() {
+    unsigned long start = millis();
+    WiFi.begin(ssid, password);
+    while (WiFi.status() != WL_CONNECTED) {
+        if (millis() - start > wifi_timeout_ms) {
+            Serial.println("[SLEEP] WiFi timeout, keeping the batch");
+            return false;
+        }
+        delay(100);
+    }
 
-void publishSensorData() {
-    StaticJsonDocument<200> json_doc;
-    int moistureValue = analogRead(sensorPIN);
-    json_doc["moisture"] = moistureValue;
+    setupMQTT();
+    mqtt_client.setBufferSize(MQTT_MAX_HEADER_SIZE + 2 + strlen(mqtt_topic) + batch_json_size);
+    sleep_batch.handshakes++;
+    unsigned long connect_start = millis();
+    if (!mqtt_client.connect(client_id, mqtt_username, mqtt_password)) {
+        Serial.printf("[SLEEP] MQTT connect failed, rc=%d\n", mqtt_client.state());
+        return false;
+    }
+    Serial.printf("[SLEEP] TLS + MQTT connect took %lu ms\n", millis() - connect_start);
+
+    // {"readings":[{"ts":..,"moisture":..},...],"awake_ms_per_sample":..,"tls_per_hour":..}
+    static char json_buffer[batch_json_size];
+    bool ok = true;
+    while (ok && sleep_batch.count > 0) {
+        uint16_t n = sleep_batch.count < batch_size ? sleep_batch.count : batch_size;
+        unsigned long encode_start = micros();
+        TelemetryJson json(json_buffer, sizeof(json_buffer));
+        json.beginArray("readings");
+        for (uint16_t i = 0; i < n; i++) {
+            json.beginObject();
+            json.add("ts", sleep_batch.items[i].ts);
+            json.add("moisture", sleep_batch.items[i].moisture);
+            json.end();
+        }
+        json.end();
+        json.add("awake_ms_per_sample", sleep_batch.awakeMsPerSample());
+        json.add("tls_per_hour", sleep_batch.handshakesPerHour());
+        const char *payload = json.finish();
+        unsigned long encode_us = micros() - encode_start;
 
-    char json_buffer[512];
-    serializeJson(json_doc, json_buffer);
-    mqtt_client.publish(mqtt_topic, json_buffer);
-    Serial.printf("Published to %s: %d\n", mqtt_topic, moistureValue);
+        if (!payload) {
+            // Not a network problem: these readings will never fit, so drop
+            // them instead of retrying forever
+            Serial.printf("[SLEEP] %u readings do not fit in %u bytes, dropped\n",
+                          n, (unsigned) sizeof(json_buffer));
+            sleep_batch.discard(n);
+            continue;
+        }
+        ok = mqtt_client.publish(mqtt_topic, (const uint8_t *) payload, json.length(), false);
+        Serial.printf("[SLEEP] Published %u readings (%u bytes, encoded in %lu us): %s\n",
+                      n, json.length(), encode_us, ok ? "ok" : "failed");
+        if (ok) {
+            sleep_batch.consume(n);
+        }
+    }
+    mqtt_client.disconnect();
+    delay(20); // Let lwIP push the last segments before the radio powers down
+    return ok;
 }
+#endif
 
 
 void loop() {
-    if (!mqtt_client.connected()) {
-        connectToMQTT();
+    // Never blocks: reconnects with backoff while sampling continues
+    mqtt_connection.loop();
+
+    unsigned long now = millis();
+    if (!has_sampled || now - last_sample_ms >= sample_interval_ms) {
+        has_sampled = true;
+        last_sample_ms = now;
+        pending_readings.push({now, analogRead(sensorPIN)});
     }
-    mqtt_client.loop();
 
-    publishSensorData();
-    delay(60000); // Delay between readings
+    publishPendingReadings();
 }
\ No newline at end of file
@@ -0,0 +1,138 @@
+// Host-side tests for TelemetryJson: make && ./test_telemetry_json
+#include <TelemetryJson.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Linked with -Wl,--wrap=malloc so every heap allocation is counted
+static unsigned long malloc_calls;
+extern "C" void *__real_malloc(size_t size);
+extern "C" void *__wrap_malloc(size_t size) {
+    malloc_calls++;
+    return __real_malloc(size);
+}
+
+static int failures;
+
+static void expect(const char *name, const char *got, const char *want) {
+    bool ok = got && want ? strcmp(got, want) == 0 : got == want;
+    if (!ok) {
+        failures++;
+        printf("FAIL %s: got %s, want %s\n", name, got ? got : "(null)", want ? want : "(null)");
+    }
+}
+
+static void testNumbers() {
+    char buf[192];
+    TelemetryJson json(buf, sizeof(buf));
+
+    json.add("temp", 21.5f);
+    json.add("hum", 55.0f);
+    json.add("small", 0.05, 2);
+    json.add("round", 1.005f, 1);
+    json.add("neg", -3.25);
+    json.add("negzero", -0.001);
+    json.add("six", 1.234567, 6);
+    json.add("ts", 4294967295UL);
+    json.add("moisture", 612);
+    json.add("offset", -40L);
+    expect("numbers", json.finish(),
+           "{\"temp\":21.5,\"hum\":55,\"small\":0.05,\"round\":1,\"neg\":-3.25,\"negzero\":0,"
+           "\"six\":1.234567,\"ts\":4294967295,\"moisture\":612,\"offset\":-40}");
+}
+
+static void testNonFinite() {
+    char buf[64];
+    TelemetryJson json(buf, sizeof(buf));
+
+    json.add("temp", NAN);
+    json.add("hum", INFINITY);
+    json.add("big", 1.0e12);
+    expect("non-finite", json.finish(), "{\"temp\":null,\"hum\":null,\"big\":null}");
+}
+
+static void testStringsAndNesting() {
+    char buf[160];
+    TelemetryJson json(buf, sizeof(buf));
+
+    json.add("id", "esp32-\"a\"\\b\n");
+    json.add("ok", true);
+    json.beginArray("readings");
+    for (int i = 0; i < 2; i++) {
+        json.beginObject();
+        json.add("ts", (unsigned long) i * 60000);
+        json.add("temp", 20.0 + i);
+        json.end();
+    }
+    json.end();
+    json.add("tls_per_hour", 6.0);
+    expect("nesting", json.finish(),
+           "{\"id\":\"esp32-\\\"a\\\"\\\\b\\u000a\",\"ok\":true,"
+           "\"readings\":[{\"ts\":0,\"temp\":20},{\"ts\":60000,\"temp\":21}],\"tls_per_hour\":6}");
+}
+
+static void testOverflow() {
+    char buf[16];
+    TelemetryJson json(buf, sizeof(buf));
+
+    json.add("temp", 21.5f);
+    expect("fits", json.finish(), "{\"temp\":21.5}");
+
+    json.reset();
+    json.add("temperature", 21.5f);
+    expect("overflow", json.finish(), nullptr);
+    if (json.length() != 0 || !json.overflowed()) {
+        failures++;
+        printf("FAIL overflow: length %zu\n", json.length());
+    }
+
+    // Exactly full: 15 characters plus the NUL
+    json.reset();
+    json.add("t", 123456.0);
+    expect("exact", json.finish(), "{\"t\":123456}");
+}
+
+static void benchmark() {
+    const int rounds = 1000000;
+    char buf[128];
+    volatile size_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        TelemetryJson json(buf, sizeof(buf));
+        json.add("temp", 20.0f + (i & 7) * 0.25f);
+        json.add("hum", 55.5f);
+        json.add("ts", (unsigned long) i);
+        json.finish();
+        sink += json.length();
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        sink += snprintf(buf, sizeof(buf), "{\"temp\":%.2f,\"hum\":%.2f,\"ts\":%d}",
+                         20.0f + (i & 7) * 0.25f, 55.5f, i);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    printf("encode: TelemetryJson %.0f ns, snprintf %.0f ns per payload (host)\n",
+           std::chrono::duration<double, std::nano>(mid - start).count() / rounds,
+           std::chrono::duration<double, std::nano>(end - mid).count() / rounds);
+    (void) sink;
+}
+
+int main() {
+    unsigned long before = malloc_calls;
+    testNumbers();
+    testNonFinite();
+    testStringsAndNesting();
+    testOverflow();
+    if (malloc_calls != before) {
+        failures++;
+        printf("FAIL heap: %lu malloc calls while encoding\n", malloc_calls - before);
+    }
+
+    benchmark();
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
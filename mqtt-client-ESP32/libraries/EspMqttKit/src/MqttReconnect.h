@@ -0,0 +1,135 @@
+#ifndef MQTT_RECONNECT_H
+#define MQTT_RECONNECT_H
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+
+// Non-blocking MQTT connection state machine.
+//
+// Call loop() on every pass of the sketch's loop(). While the connection
+// is down it makes at most one connect attempt when the backoff delay has
+// expired and returns immediately otherwise, so sampling keeps running.
+// Retry delays grow exponentially from min_ms to max_ms, and each delay is
+// randomized between 50% and 100% so a fleet does not reconnect in lockstep.
+class MqttReconnect {
+public:
+    typedef void (*Callback)(PubSubClient &client);
+
+    MqttReconnect(PubSubClient &client, const char *client_id, const char *username, const char *password)
+        : client_(client), client_id_(client_id), username_(username), password_(password) {}
+
+    void setBackoff(uint32_t min_ms, uint32_t max_ms) {
+        min_ms_ = min_ms;
+        max_ms_ = max_ms;
+    }
+
+    // Called after every successful (re)connect, e.g. to subscribe.
+    void onConnected(Callback callback) {
+        on_connected_ = callback;
+    }
+
+    // Called after every failed attempt, e.g. to log the TLS error.
+    void onConnectFailed(Callback callback) {
+        on_failed_ = callback;
+    }
+
+    // Returns true while connected.
+    bool loop() {
+        if (client_.connected()) {
+            client_.loop();
+            return true;
+        }
+
+        uint32_t now = millis();
+        if (online_) {
+            online_ = false;
+            outage_start_ = now;
+            attempt_ = 0;
+            next_attempt_ = now;
+            Serial.printf("[MQTT] Connection lost, rc=%d\n", client_.state());
+        }
+
+        // Wi-Fi reconnects by itself, no point in trying MQTT without it
+        if (WiFi.status() != WL_CONNECTED || (int32_t) (now - next_attempt_) < 0) {
+            return false;
+        }
+
+        attempt_++;
+        Serial.printf("[MQTT] Connecting as %s (attempt %u)...\n", client_id_, attempt_);
+        if (client_.connect(client_id_, username_, password_)) {
+            online_ = true;
+            if (ever_connected_) {
+                last_outage_ms_ = millis() - outage_start_;
+                reconnects_++;
+                Serial.printf("[MQTT] Reconnected after %lu ms outage, %u attempts\n",
+                              (unsigned long) last_outage_ms_, attempt_);
+            } else {
+                ever_connected_ = true;
+                Serial.println("[MQTT] Connected");
+            }
+            if (on_connected_) {
+                on_connected_(client_);
+            }
+            return true;
+        }
+
+        uint32_t delay_ms = backoff(attempt_);
+        next_attempt_ = millis() + delay_ms;
+        Serial.printf("[MQTT] Failed, rc=%d, retrying in %lu ms\n", client_.state(), (unsigned long) delay_ms);
+        if (on_failed_) {
+            on_failed_(client_);
+        }
+        return false;
+    }
+
+    bool connected() {
+        return online_ && client_.connected();
+    }
+
+    // Duration of the last outage, from losing the connection to the next CONNACK.
+    uint32_t lastOutageMs() const {
+        return last_outage_ms_;
+    }
+
+    uint32_t reconnects() const {
+        return reconnects_;
+    }
+
+private:
+    uint32_t backoff(uint32_t attempt) const {
+        uint32_t delay_ms = min_ms_;
+        while (--attempt > 0 && delay_ms < max_ms_) {
+            delay_ms *= 2;
+        }
+        if (delay_ms > max_ms_) {
+            delay_ms = max_ms_;
+        }
+        return delay_ms / 2 + random(delay_ms / 2 + 1);
+    }
+
+    PubSubClient &client_;
+    const char *client_id_;
+    const char *username_;
+    const char *password_;
+    Callback on_connected_ = nullptr;
+    Callback on_failed_ = nullptr;
+
+    uint32_t min_ms_ = 1000;
+    uint32_t max_ms_ = 60000;
+
+    bool online_ = false;
+    bool ever_connected_ = false;
+    uint32_t attempt_ = 0;
+    uint32_t next_attempt_ = 0;
+    uint32_t outage_start_ = 0;
+    uint32_t last_outage_ms_ = 0;
+    uint32_t reconnects_ = 0;
+};
+
+#endif // MQTT_RECONNECT_H
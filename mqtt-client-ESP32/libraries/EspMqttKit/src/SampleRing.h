@@ -0,0 +1,52 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stddef.h>
+
+// Fixed-size FIFO for readings taken while MQTT is offline. When full the
+// oldest reading is overwritten, so the newest N samples survive an outage.
+template<typename T, size_t N>
+class SampleRing {
+public:
+    void push(const T &sample) {
+        if (count_ == N) {
+            head_ = (head_ + 1) % N;
+            count_--;
+            dropped_++;
+        }
+        buf_[(head_ + count_) % N] = sample;
+        count_++;
+    }
+
+    // Oldest reading, only valid if !empty()
+    const T &front() const {
+        return buf_[head_];
+    }
+
+    void pop() {
+        if (count_ > 0) {
+            head_ = (head_ + 1) % N;
+            count_--;
+        }
+    }
+
+    bool empty() const {
+        return count_ == 0;
+    }
+
+    size_t size() const {
+        return count_;
+    }
+
+    unsigned long dropped() const {
+        return dropped_;
+    }
+
+private:
+    T buf_[N];
+    size_t head_ = 0;
+    size_t count_ = 0;
+    unsigned long dropped_ = 0;
+};
+
+#endif // SAMPLE_RING_H
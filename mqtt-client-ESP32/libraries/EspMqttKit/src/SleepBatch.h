@@ -0,0 +1,133 @@
+#ifndef SLEEP_BATCH_H
+#define SLEEP_BATCH_H
+
+#if !defined(ESP32)
+#error "SleepBatch needs the ESP32 RTC memory and deep sleep timer"
+#endif
+
+#include <Arduino.h>
+#include <esp_sleep.h>
+#include <string.h>
+
+// Readings kept in RTC slow memory across deep-sleep cycles.
+//
+// Declare exactly one instance with RTC_DATA_ATTR. It has to stay a plain
+// struct: a constructor would run again on every wake and wipe the
+// readings, so begin() tells a cold boot from a wake by the magic value.
+//
+// Time since cold boot is tracked here as well, because millis() restarts
+// from zero on every wake. It only covers the awake time measured by
+// millis() plus the requested sleep, not the ROM/bootloader start-up.
+template<typename T, size_t N>
+struct SleepBatch {
+    static const uint32_t kMagic = 0x5EE9BA7C;
+
+    uint32_t magic;
+    uint16_t count;
+    uint16_t skip_wakes;     // wakes to wait before retrying a failed publish
+    uint32_t wakes;
+    uint32_t samples;        // readings taken since cold boot
+    uint32_t dropped;        // oldest readings overwritten while full
+    uint32_t handshakes;     // TLS handshakes since cold boot
+    uint32_t batches;        // batches published since cold boot
+    uint32_t last_awake_ms;  // awake time of the previous cycle
+    uint64_t elapsed_ms;     // awake + asleep since cold boot
+    uint64_t awake_ms;       // awake only
+    T items[N];
+
+    // Call first in setup(); returns true on a cold boot
+    bool begin() {
+        bool cold = magic != kMagic;
+        if (cold) {
+            memset(this, 0, sizeof(*this));
+            magic = kMagic;
+        }
+        wakes++;
+        return cold;
+    }
+
+    // Milliseconds since cold boot, usable as a reading timestamp
+    uint64_t now() const {
+        return elapsed_ms + millis();
+    }
+
+    void add(const T &item) {
+        if (count == N) {
+            memmove(items, items + 1, sizeof(T) * (N - 1));
+            count--;
+            dropped++;
+        }
+        items[count++] = item;
+        samples++;
+    }
+
+    // True when batch_size readings are waiting and no retry delay is pending
+    bool due(uint16_t batch_size) {
+        if (count < batch_size) {
+            return false;
+        }
+        if (skip_wakes > 0) {
+            skip_wakes--;
+            return false;
+        }
+        return true;
+    }
+
+    // Remove the n oldest readings after they went out in one PUBLISH
+    void consume(uint16_t n) {
+        remove(n);
+        batches++;
+    }
+
+    // Give up on the n oldest readings, e.g. because they cannot be
+    // encoded; retrying would fail the same way on every wake
+    void discard(uint16_t n) {
+        dropped += remove(n);
+    }
+
+    // Record the outcome of a publish attempt. Published readings are
+    // already gone through consume(); a failure delays the next attempt.
+    void published(bool ok, uint16_t retry_wakes) {
+        skip_wakes = ok ? 0 : retry_wakes;
+    }
+
+    uint32_t awakeMsPerSample() const {
+        return samples ? (uint32_t) (awake_ms / samples) : 0;
+    }
+
+    float handshakesPerHour() const {
+        return elapsed_ms ? handshakes * 3600000.0f / elapsed_ms : 0.0f;
+    }
+
+    void report() const {
+        Serial.printf("[SLEEP] wake %u: %u/%u buffered, last cycle awake %u ms, "
+                      "%u ms awake per sample, %.2f TLS handshakes/hour\n",
+                      wakes, count, (unsigned) N, last_awake_ms, awakeMsPerSample(), handshakesPerHour());
+    }
+
+    // Sleep for the rest of interval_ms, so samples stay on a fixed period.
+    // Does not return: the next wake starts again in setup().
+    void sleep(uint32_t interval_ms) {
+        uint32_t awake = millis();
+        uint32_t sleep_ms = interval_ms > awake ? interval_ms - awake : 1;
+
+        last_awake_ms = awake;
+        awake_ms += awake;
+        elapsed_ms += (uint64_t) awake + sleep_ms;
+        Serial.flush();
+        esp_sleep_enable_timer_wakeup((uint64_t) sleep_ms * 1000);
+        esp_deep_sleep_start();
+    }
+
+private:
+    uint16_t remove(uint16_t n) {
+        if (n > count) {
+            n = count;
+        }
+        memmove(items, items + n, sizeof(T) * (count - n));
+        count -= n;
+        return n;
+    }
+};
+
+#endif // SLEEP_BATCH_H
@@ -0,0 +1,244 @@
+#ifndef TELEMETRY_JSON_H
+#define TELEMETRY_JSON_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// JSON encoder that writes straight into a caller-provided buffer.
+//
+// No heap, no printf: numbers are formatted by hand, because newlib's
+// float printf goes through _dtoa_r, which allocates. Floats are written
+// with a fixed number of decimals and trailing zeros trimmed, NaN and
+// infinity become null (a failed DHT read returns NaN). If the buffer is
+// too small the encoder stops writing and finish() returns nullptr, so a
+// truncated payload is never published.
+//
+//   char buf[64];
+//   TelemetryJson json(buf, sizeof(buf));
+//   json.add("temp", 21.5f);
+//   json.add("ts", millis());
+//   mqtt_client.publish(topic, (const uint8_t *) json.finish(), json.length());
+class TelemetryJson {
+public:
+    static const uint8_t kMaxDepth = 4;
+    static const uint8_t kMaxDecimals = 6;
+
+    TelemetryJson(char *buf, size_t size) : buf_(buf), size_(size) {
+        reset();
+    }
+
+    // Starts a new top-level object in the same buffer
+    void reset() {
+        len_ = 0;
+        depth_ = 0;
+        overflow_ = size_ == 0;
+        open('{');
+    }
+
+    void add(const char *key, const char *value) {
+        this->key(key);
+        string(value);
+    }
+
+    void add(const char *key, bool value) {
+        this->key(key);
+        raw(value ? "true" : "false");
+    }
+
+    void add(const char *key, long value) {
+        this->key(key);
+        integer(value);
+    }
+
+    void add(const char *key, unsigned long value) {
+        this->key(key);
+        uinteger(value);
+    }
+
+    void add(const char *key, int value) {
+        add(key, (long) value);
+    }
+
+    void add(const char *key, unsigned int value) {
+        add(key, (unsigned long) value);
+    }
+
+    void add(const char *key, double value, uint8_t decimals = 2) {
+        this->key(key);
+        number(value, decimals);
+    }
+
+    // Nested containers; add() inside an array ignores a null key
+    void beginArray(const char *key) {
+        this->key(key);
+        open('[');
+    }
+
+    void beginObject(const char *key = nullptr) {
+        this->key(key);
+        open('{');
+    }
+
+    void end() {
+        if (depth_ > 1) {
+            close();
+        }
+    }
+
+    // Closes all open containers and NUL-terminates. nullptr on overflow.
+    const char *finish() {
+        while (depth_ > 0) {
+            close();
+        }
+        if (len_ < size_) {
+            buf_[len_] = '\0';
+        } else {
+            overflow_ = true;
+        }
+        return overflow_ ? nullptr : buf_;
+    }
+
+    size_t length() const {
+        return overflow_ ? 0 : len_;
+    }
+
+    bool overflowed() const {
+        return overflow_;
+    }
+
+private:
+    void put(char c) {
+        // Keep one byte for the terminating NUL
+        if (len_ + 1 < size_) {
+            buf_[len_++] = c;
+        } else {
+            overflow_ = true;
+        }
+    }
+
+    void raw(const char *s) {
+        while (*s) {
+            put(*s++);
+        }
+    }
+
+    void open(char c) {
+        put(c);
+        if (depth_ < kMaxDepth) {
+            closer_[depth_] = c == '{' ? '}' : ']';
+            first_[depth_] = true;
+            depth_++;
+        } else {
+            overflow_ = true;
+        }
+    }
+
+    void close() {
+        depth_--;
+        put(closer_[depth_]);
+    }
+
+    // Comma, and "key": when the current container is an object
+    void key(const char *name) {
+        if (depth_ == 0) {
+            overflow_ = true;
+            return;
+        }
+        if (!first_[depth_ - 1]) {
+            put(',');
+        }
+        first_[depth_ - 1] = false;
+        if (closer_[depth_ - 1] == '}' && name) {
+            string(name);
+            put(':');
+        }
+    }
+
+    void string(const char *s) {
+        static const char hex[] = "0123456789abcdef";
+
+        put('"');
+        for (; *s; s++) {
+            unsigned char c = (unsigned char) *s;
+            if (c == '"' || c == '\\') {
+                put('\\');
+                put(c);
+            } else if (c < 0x20) {
+                raw("\\u00");
+                put(hex[c >> 4]);
+                put(hex[c & 0x0F]);
+            } else {
+                put(c);
+            }
+        }
+        put('"');
+    }
+
+    void uinteger(unsigned long long v) {
+        char digits[20];
+        uint8_t n = 0;
+        do {
+            digits[n++] = '0' + v % 10;
+            v /= 10;
+        } while (v);
+        while (n) {
+            put(digits[--n]);
+        }
+    }
+
+    void integer(long long v) {
+        if (v < 0) {
+            put('-');
+            uinteger(0ULL - (unsigned long long) v);
+        } else {
+            uinteger(v);
+        }
+    }
+
+    void number(double v, uint8_t decimals) {
+        static const uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+        if (decimals > kMaxDecimals) {
+            decimals = kMaxDecimals;
+        }
+        // Beyond 2^53 / 10^6 the scaled value no longer fits exactly
+        if (isnan(v) || isinf(v) || fabs(v) >= 9.0e9) {
+            raw("null");
+            return;
+        }
+        if (v < 0) {
+            v = -v;
+            // Only print the sign if something non-zero follows
+            if (v * pow10[decimals] >= 0.5) {
+                put('-');
+            }
+        }
+        uint64_t scaled = (uint64_t) (v * pow10[decimals] + 0.5);
+        uint64_t whole = scaled / pow10[decimals];
+        uint32_t frac = scaled % pow10[decimals];
+
+        uinteger(whole);
+        if (frac == 0) {
+            return;
+        }
+        while (frac % 10 == 0) {
+            frac /= 10;
+            decimals--;
+        }
+        put('.');
+        for (uint32_t div = pow10[decimals - 1]; div > 0; div /= 10) {
+            put('0' + frac / div % 10);
+        }
+    }
+
+    char *buf_;
+    size_t size_;
+    size_t len_;
+    uint8_t depth_;
+    bool overflow_;
+    char closer_[kMaxDepth];
+    bool first_[kMaxDepth];
+};
+
+#endif // TELEMETRY_JSON_H
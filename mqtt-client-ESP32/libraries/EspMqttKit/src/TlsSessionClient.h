@@ -0,0 +1,362 @@
+#ifndef TLS_SESSION_CLIENT_H
+#define TLS_SESSION_CLIENT_H
+
+#if !defined(ESP32)
+#error "TlsSessionClient is built on the ESP32 mbedTLS"
+#endif
+
+#include <Arduino.h>
+#include <Client.h>
+#include <string.h>
+#include <mbedtls/version.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+
+#if __has_include(<esp_random.h>)
+#include <esp_random.h>
+#else
+#include <esp_system.h>
+#endif
+
+#ifndef MBEDTLS_PRIVATE
+#define MBEDTLS_PRIVATE(member) member
+#endif
+
+// TLS client for PubSubClient that makes reconnects cheap.
+//
+// WiFiClientSecure parses the PEM root again and runs a full handshake on
+// every connect. This client parses the CA once in setCACert() and keeps
+// the mbedTLS config across connections. After each handshake it keeps the
+// session and offers its ID on the next connect, so a broker that still has
+// the session cached (EMQX does by default) skips the certificate exchange
+// and the RSA/ECDHE work. A broker that refuses simply gets a full
+// handshake.
+//
+// Every handshake is logged with its duration and heap use, split into
+// full and resumed. Heap use is the drop in free heap from before the
+// connect (so it includes the mbedTLS record buffers) to the lowest value
+// seen between handshake steps; short peaks inside one step are missed.
+class TlsSessionClient : public Client {
+public:
+    struct HandshakeStats {
+        uint32_t count;
+        uint32_t total_ms;
+        uint32_t max_ms;
+        uint32_t max_heap;  // bytes
+    };
+
+    TlsSessionClient() {
+        mbedtls_net_init(&net_);
+        mbedtls_ssl_init(&ssl_);
+        mbedtls_ssl_config_init(&conf_);
+        mbedtls_x509_crt_init(&ca_);
+        mbedtls_ssl_session_init(&session_);
+    }
+
+    ~TlsSessionClient() {
+        stop();
+        mbedtls_ssl_session_free(&session_);
+        mbedtls_ssl_config_free(&conf_);
+        mbedtls_x509_crt_free(&ca_);
+    }
+
+    // Parses the PEM root once; calling again with the same pointer is free.
+    bool setCACert(const char *pem) {
+        if (pem == ca_pem_) {
+            return ca_ok_;
+        }
+        mbedtls_x509_crt_free(&ca_);
+        mbedtls_x509_crt_init(&ca_);
+        ca_pem_ = pem;
+        ca_ok_ = mbedtls_x509_crt_parse(&ca_, (const unsigned char *) pem, strlen(pem) + 1) == 0;
+        if (!ca_ok_) {
+            Serial.println("[TLS] Failed to parse CA certificate");
+        }
+        // The config points at the old chain, rebuild it on the next connect
+        mbedtls_ssl_config_free(&conf_);
+        mbedtls_ssl_config_init(&conf_);
+        conf_ready_ = false;
+        forgetSession();
+        return ca_ok_;
+    }
+
+    void setSessionReuse(bool enabled) {
+        reuse_ = enabled;
+        if (!enabled) {
+            forgetSession();
+        }
+    }
+
+    void forgetSession() {
+        mbedtls_ssl_session_free(&session_);
+        mbedtls_ssl_session_init(&session_);
+        has_session_ = false;
+    }
+
+    void setTimeout(uint32_t timeout_ms) {
+        timeout_ms_ = timeout_ms;
+    }
+
+    const HandshakeStats &fullHandshakes() const {
+        return full_;
+    }
+
+    const HandshakeStats &resumedHandshakes() const {
+        return resumed_;
+    }
+
+    int lastError() const {
+        return last_error_;
+    }
+
+    int connect(IPAddress ip, uint16_t port) override {
+        return connect(ip.toString().c_str(), port);
+    }
+
+    int connect(const char *host, uint16_t port) override {
+        stop();
+        uint32_t heap_before = ESP.getFreeHeap();
+        if (!ca_ok_ || (!conf_ready_ && !setupConfig())) {
+            return 0;
+        }
+
+        char port_str[6];
+        snprintf(port_str, sizeof(port_str), "%u", port);
+        // Blocks for the TCP connect, like WiFiClientSecure does
+        last_error_ = mbedtls_net_connect(&net_, host, port_str, MBEDTLS_NET_PROTO_TCP);
+        if (last_error_ != 0) {
+            return 0;
+        }
+        mbedtls_net_set_nonblock(&net_);
+
+        last_error_ = mbedtls_ssl_setup(&ssl_, &conf_);
+        if (last_error_ == 0) {
+            last_error_ = mbedtls_ssl_set_hostname(&ssl_, host);
+        }
+        if (last_error_ != 0) {
+            stop();
+            return 0;
+        }
+        mbedtls_ssl_set_bio(&ssl_, &net_, mbedtls_net_send, mbedtls_net_recv, nullptr);
+
+        bool offered = reuse_ && has_session_ && mbedtls_ssl_set_session(&ssl_, &session_) == 0;
+        if (!handshake(offered, heap_before)) {
+            Serial.printf("[TLS] Handshake failed: -0x%04x\n", -last_error_);
+            stop();
+            return 0;
+        }
+        connected_ = true;
+        return 1;
+    }
+
+    using Print::write;
+
+    size_t write(uint8_t b) override {
+        return write(&b, 1);
+    }
+
+    size_t write(const uint8_t *buf, size_t size) override {
+        size_t sent = 0;
+        uint32_t start = millis();
+
+        while (connected_ && sent < size) {
+            int rc = mbedtls_ssl_write(&ssl_, buf + sent, size - sent);
+            if (rc > 0) {
+                sent += rc;
+            } else if (wouldBlock(rc) && millis() - start < timeout_ms_) {
+                delay(1);
+            } else {
+                fail(rc);
+            }
+        }
+        return sent;
+    }
+
+    int available() override {
+        if (!connected_) {
+            return peek_ >= 0;
+        }
+        size_t avail = mbedtls_ssl_get_bytes_avail(&ssl_);
+        if (avail == 0) {
+            // Processes a pending record without consuming application data
+            int rc = mbedtls_ssl_read(&ssl_, nullptr, 0);
+            if (rc < 0 && !wouldBlock(rc)) {
+                fail(rc);
+            }
+            avail = connected_ ? mbedtls_ssl_get_bytes_avail(&ssl_) : 0;
+        }
+        return avail + (peek_ >= 0);
+    }
+
+    int read() override {
+        uint8_t b;
+        return read(&b, 1) == 1 ? b : -1;
+    }
+
+    int read(uint8_t *buf, size_t size) override {
+        size_t got = 0;
+
+        if (size > 0 && peek_ >= 0) {
+            buf[got++] = (uint8_t) peek_;
+            peek_ = -1;
+        }
+        if (got < size && connected_) {
+            int rc = mbedtls_ssl_read(&ssl_, buf + got, size - got);
+            if (rc > 0) {
+                got += rc;
+            } else if (!wouldBlock(rc)) {
+                fail(rc);
+            }
+        }
+        return got > 0 ? (int) got : -1;
+    }
+
+    int peek() override {
+        if (peek_ < 0) {
+            uint8_t b;
+            if (read(&b, 1) == 1) {
+                peek_ = b;
+            }
+        }
+        return peek_;
+    }
+
+    void flush() override {}
+
+    void stop() override {
+        if (connected_) {
+            mbedtls_ssl_close_notify(&ssl_);
+        }
+        mbedtls_net_free(&net_);
+        mbedtls_ssl_free(&ssl_);
+        mbedtls_ssl_init(&ssl_);
+        connected_ = false;
+        peek_ = -1;
+    }
+
+    uint8_t connected() override {
+        if (connected_) {
+            available();
+        }
+        return connected_;
+    }
+
+    operator bool() override {
+        return connected_;
+    }
+
+private:
+    static int fillRandom(void *, unsigned char *buf, size_t len) {
+        esp_fill_random(buf, len);
+        return 0;
+    }
+
+    static bool wouldBlock(int rc) {
+        return rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+
+    bool handshakeOver() {
+#if MBEDTLS_VERSION_MAJOR >= 3
+        return mbedtls_ssl_is_handshake_over(&ssl_);
+#else
+        return ssl_.state == MBEDTLS_SSL_HANDSHAKE_OVER;
+#endif
+    }
+
+    bool setupConfig() {
+        last_error_ = mbedtls_ssl_config_defaults(&conf_, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                                  MBEDTLS_SSL_PRESET_DEFAULT);
+        if (last_error_ != 0) {
+            return false;
+        }
+        mbedtls_ssl_conf_authmode(&conf_, MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_ca_chain(&conf_, &ca_, nullptr);
+        mbedtls_ssl_conf_rng(&conf_, fillRandom, nullptr);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+        // Resume by session ID only: the ID echoed back by the broker is how
+        // a resumption is recognized, and a ticket offer uses a random ID
+        mbedtls_ssl_conf_session_tickets(&conf_, MBEDTLS_SSL_SESSION_TICKETS_DISABLED);
+#endif
+        conf_ready_ = true;
+        return true;
+    }
+
+    bool handshake(bool offered, uint32_t heap_before) {
+        uint32_t start = millis();
+        uint32_t heap_low = ESP.getFreeHeap();
+
+        // Step by step so the free heap can be sampled in between
+        while (!handshakeOver()) {
+            int rc = mbedtls_ssl_handshake_step(&ssl_);
+            uint32_t heap = ESP.getFreeHeap();
+            if (heap < heap_low) {
+                heap_low = heap;
+            }
+            if (wouldBlock(rc)) {
+                if (millis() - start > timeout_ms_) {
+                    last_error_ = MBEDTLS_ERR_SSL_TIMEOUT;
+                    return false;
+                }
+                delay(1);
+            } else if (rc != 0) {
+                last_error_ = rc;
+                return false;
+            }
+        }
+        uint32_t elapsed = millis() - start;
+
+        // The session ID comes back unchanged when the broker resumed it
+        unsigned char offered_id[32];
+        size_t offered_len = 0;
+        if (offered) {
+            offered_len = session_.MBEDTLS_PRIVATE(id_len);
+            memcpy(offered_id, session_.MBEDTLS_PRIVATE(id), offered_len);
+        }
+        forgetSession();
+        has_session_ = mbedtls_ssl_get_session(&ssl_, &session_) == 0;
+        bool resumed = has_session_ && offered_len > 0 && session_.MBEDTLS_PRIVATE(id_len) == offered_len &&
+                       memcmp(session_.MBEDTLS_PRIVATE(id), offered_id, offered_len) == 0;
+
+        HandshakeStats &stats = resumed ? resumed_ : full_;
+        uint32_t heap_used = heap_before - heap_low;
+        stats.count++;
+        stats.total_ms += elapsed;
+        stats.max_ms = max(stats.max_ms, elapsed);
+        stats.max_heap = max(stats.max_heap, heap_used);
+        Serial.printf("[TLS] %s handshake in %lu ms, heap used %lu B "
+                      "(full: %lu, avg %lu ms, max heap %lu B; resumed: %lu, avg %lu ms, max heap %lu B)\n",
+                      resumed ? "Resumed" : "Full", (unsigned long) elapsed, (unsigned long) heap_used,
+                      (unsigned long) full_.count, (unsigned long) (full_.count ? full_.total_ms / full_.count : 0),
+                      (unsigned long) full_.max_heap, (unsigned long) resumed_.count,
+                      (unsigned long) (resumed_.count ? resumed_.total_ms / resumed_.count : 0),
+                      (unsigned long) resumed_.max_heap);
+        return true;
+    }
+
+    void fail(int rc) {
+        last_error_ = rc;
+        connected_ = false;
+    }
+
+    mbedtls_net_context net_;
+    mbedtls_ssl_context ssl_;
+    mbedtls_ssl_config conf_;
+    mbedtls_x509_crt ca_;
+    mbedtls_ssl_session session_;
+
+    const char *ca_pem_ = nullptr;
+    bool ca_ok_ = false;
+    bool conf_ready_ = false;
+    bool reuse_ = true;
+    bool has_session_ = false;
+    bool connected_ = false;
+    int peek_ = -1;
+    int last_error_ = 0;
+    uint32_t timeout_ms_ = 15000;
+
+    HandshakeStats full_ = {};
+    HandshakeStats resumed_ = {};
+};
+
+#endif // TLS_SESSION_CLIENT_H
@@ -1,6 +1,7 @@
 #include <ESP8266WiFi.h>
 #include <PubSubClient.h>
 #include <time.h>
+#include <MqttReconnect.h>
 
 // WiFi credentials
 const char *ssid = "WIFI_SSID";             // Replace with your WiFi name
@@ -22,6 +23,8 @@ const int daylight_offset_sec = 0;        // Daylight saving time offset in seco
 // WiFi and MQTT client initialization
 BearSSL::WiFiClientSecure espClient;
 PubSubClient mqtt_client(espClient);
+char client_id[40];
+MqttReconnect mqtt_connection(mqtt_client, client_id, mqtt_username, mqtt_password);
 
 // SSL certificate for MQTT broker
 // Load DigiCert Global Root G2, which is used by EMQX Public Broker: broker.emqx.io
@@ -79,11 +82,18 @@ CAUw7C29C79Fv1C5qfPrmAESrciIxpg0X40KPMbp1ZWVbd4=
 )EOF";
 */
 
+// Trust anchors must outlive every connect attempt, so they are not a local
+BearSSL::X509List serverTrustedCA(ca_cert);
+
 
 // Function declarations
 void connectToWiFi();
 
-void connectToMQTT();
+void setupMQTT();
+
+void onMQTTConnected(PubSubClient &client);
+
+void onMQTTConnectFailed(PubSubClient &client);
 
 void syncTime();
 
@@ -94,9 +104,7 @@ void setup() {
     Serial.begin(115200);
     connectToWiFi();
     syncTime();  // X.509 validation requires synchronization time
-    mqtt_client.setServer(mqtt_broker, mqtt_port);
-    mqtt_client.setCallback(mqttCallback);
-    connectToMQTT();
+    setupMQTT();
 }
 
 void connectToWiFi() {
@@ -125,27 +133,27 @@ void syncTime() {
     }
 }
 
-void connectToMQTT() {
-    BearSSL::X509List serverTrustedCA(ca_cert);
+void setupMQTT() {
     espClient.setTrustAnchors(&serverTrustedCA);
-    while (!mqtt_client.connected()) {
-        String client_id = "esp8266-client-" + String(WiFi.macAddress());
-        Serial.printf("Connecting to MQTT Broker as %s.....\n", client_id.c_str());
-        if (mqtt_client.connect(client_id.c_str(), mqtt_username, mqtt_password)) {
-            Serial.println("Connected to MQTT broker");
-            mqtt_client.subscribe(mqtt_topic);
-            // Publish message upon successful connection
-            mqtt_client.publish(mqtt_topic, "Hi EMQX I'm ESP8266 ^^");
-        } else {
-            char err_buf[128];
-            espClient.getLastSSLError(err_buf, sizeof(err_buf));
-            Serial.print("Failed to connect to MQTT broker, rc=");
-            Serial.println(mqtt_client.state());
-            Serial.print("SSL error: ");
-            Serial.println(err_buf);
-            delay(5000);
-        }
-    }
+    mqtt_client.setServer(mqtt_broker, mqtt_port);
+    mqtt_client.setCallback(mqttCallback);
+    snprintf(client_id, sizeof(client_id), "esp8266-client-%s", WiFi.macAddress().c_str());
+    mqtt_connection.onConnected(onMQTTConnected);
+    mqtt_connection.onConnectFailed(onMQTTConnectFailed);
+    // The connection itself is made from loop() by mqtt_connection
+}
+
+void onMQTTConnected(PubSubClient &client) {
+    client.subscribe(mqtt_topic);
+    // Publish message upon successful connection
+    client.publish(mqtt_topic, "Hi EMQX I'm ESP8266 ^^");
+}
+
+void onMQTTConnectFailed(PubSubClient &client) {
+    char err_buf[128];
+    espClient.getLastSSLError(err_buf, sizeof(err_buf));
+    Serial.print("SSL error: ");
+    Serial.println(err_buf);
 }
 
 void mqttCallback(char *topic, byte *payload, unsigned int length) {
@@ -159,8 +167,6 @@ void mqttCallback(char *topic, byte *payload, unsigned int length) {
 }
 
 void loop() {
-    if (!mqtt_client.connected()) {
-        connectToMQTT();
-    }
-    mqtt_client.loop();
+    // Never blocks: reconnects with backoff in the background
+    mqtt_connection.loop();
 }
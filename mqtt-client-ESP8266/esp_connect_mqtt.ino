@@ -1,5 +1,6 @@
 #include <ESP8266WiFi.h>
 #include <PubSubClient.h>
+#include <MqttReconnect.h>
 
 // WiFi settings
 const char *ssid = "WIFI_SSID";             // Replace with your WiFi name
@@ -14,19 +15,21 @@ const int mqtt_port = 1883;  // MQTT port (TCP)
 
 WiFiClient espClient;
 PubSubClient mqtt_client(espClient);
+char client_id[40];
+MqttReconnect mqtt_connection(mqtt_client, client_id, mqtt_username, mqtt_password);
 
 void connectToWiFi();
 
-void connectToMQTTBroker();
+void setupMQTTBroker();
+
+void onMQTTConnected(PubSubClient &client);
 
 void mqttCallback(char *topic, byte *payload, unsigned int length);
 
 void setup() {
     Serial.begin(115200);
     connectToWiFi();
-    mqtt_client.setServer(mqtt_broker, mqtt_port);
-    mqtt_client.setCallback(mqttCallback);
-    connectToMQTTBroker();
+    setupMQTTBroker();
 }
 
 void connectToWiFi() {
@@ -39,22 +42,18 @@ void connectToWiFi() {
     Serial.println("\nConnected to the WiFi network");
 }
 
-void connectToMQTTBroker() {
-    while (!mqtt_client.connected()) {
-        String client_id = "esp8266-client-" + String(WiFi.macAddress());
-        Serial.printf("Connecting to MQTT Broker as %s.....\n", client_id.c_str());
-        if (mqtt_client.connect(client_id.c_str(), mqtt_username, mqtt_password)) {
-            Serial.println("Connected to MQTT broker");
-            mqtt_client.subscribe(mqtt_topic);
-            // Publish message upon successful connection
-            mqtt_client.publish(mqtt_topic, "Hi EMQX I'm ESP8266 ^^");
-        } else {
-            Serial.print("Failed to connect to MQTT broker, rc=");
-            Serial.print(mqtt_client.state());
-            Serial.println(" try again in 5 seconds");
-            delay(5000);
-        }
-    }
+void setupMQTTBroker() {
+    mqtt_client.setServer(mqtt_broker, mqtt_port);
+    mqtt_client.setCallback(mqttCallback);
+    snprintf(client_id, sizeof(client_id), "esp8266-client-%s", WiFi.macAddress().c_str());
+    mqtt_connection.onConnected(onMQTTConnected);
+    // The connection itself is made from loop() by mqtt_connection
+}
+
+void onMQTTConnected(PubSubClient &client) {
+    client.subscribe(mqtt_topic);
+    // Publish message upon successful connection
+    client.publish(mqtt_topic, "Hi EMQX I'm ESP8266 ^^");
 }
 
 void mqttCallback(char *topic, byte *payload, unsigned int length) {
@@ -69,8 +68,6 @@ void mqttCallback(char *topic, byte *payload, unsigned int length) {
 }
 
 void loop() {
-    if (!mqtt_client.connected()) {
-        connectToMQTTBroker();
-    }
-    mqtt_client.loop();
+    // Never blocks: reconnects with backoff in the background
+    mqtt_connection.loop();
 }
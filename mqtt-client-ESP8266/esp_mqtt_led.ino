@@ -1,5 +1,6 @@
 #include <ESP8266WiFi.h>
 #include <PubSubClient.h>
+#include <MqttReconnect.h>
 
 // GPIO 5 D1
 #define LED 5
@@ -19,7 +20,12 @@ bool ledState = false;
 
 WiFiClient espClient;
 PubSubClient client(espClient);
+char client_id[40];
+MqttReconnect mqtt_connection(client, client_id, mqtt_username, mqtt_password);
 
+void onConnected(PubSubClient &client);
+
+void callback(char *topic, byte *payload, unsigned int length);
 
 void setup() {
     // Set software serial baud to 115200;
@@ -38,23 +44,15 @@ void setup() {
     pinMode(LED, OUTPUT);
     digitalWrite(LED, LOW);  // Turn off the LED initially
 
-    // Connecting to an MQTT broker
+    // Connecting to an MQTT broker happens in loop(), without blocking
     client.setServer(mqtt_broker, mqtt_port);
     client.setCallback(callback);
-    while (!client.connected()) {
-        String client_id = "esp8266-client-";
-        client_id += String(WiFi.macAddress());
-        Serial.printf("The client %s connects to the public MQTT broker\n", client_id.c_str());
-        if (client.connect(client_id.c_str(), mqtt_username, mqtt_password)) {
-            Serial.println("Public EMQX MQTT broker connected");
-        } else {
-            Serial.print("Failed with state ");
-            Serial.print(client.state());
-            delay(2000);
-        }
-    }
+    snprintf(client_id, sizeof(client_id), "esp8266-client-%s", WiFi.macAddress().c_str());
+    mqtt_connection.onConnected(onConnected);
+}
 
-    // Publish and subscribe
+void onConnected(PubSubClient &client) {
+    // Publish and subscribe, again after every reconnect
     client.publish(topic, "hello emqx");
     client.subscribe(topic);
 }
@@ -81,6 +79,6 @@ void callback(char *topic, byte *payload, unsigned int length) {
 }
 
 void loop() {
-    client.loop();
+    mqtt_connection.loop();
     delay(100); // Delay for a short period in each loop iteration
 }
@@ -1,6 +1,8 @@
 #include <ESP8266WiFi.h>
 #include <PubSubClient.h>
-#include <ArduinoJson.h>
+#include <MqttReconnect.h>
+#include <SampleRing.h>
+#include <TelemetryJson.h>
 
 // WiFi
 const char *ssid = "mousse"; // Enter your WiFi name
@@ -17,8 +19,19 @@ const int mqtt_port = 1883;
 #define sensorPIN A0
 unsigned long previousMillis = 0;
 
+// Readings wait here until they are published, so nothing is lost while offline
+struct Reading {
+    unsigned long ts;   // millis() when sampled
+    float moisture;
+};
+SampleRing<Reading, 32> pending_readings;
+
 WiFiClient espClient;
 PubSubClient client(espClient);
+char client_id[40];
+MqttReconnect mqtt_connection(client, client_id, mqtt_username, mqtt_password);
+
+bool publishReading(const Reading &reading);
 
 void setup() {
     // Set software serial baud to 115200;
@@ -30,38 +43,40 @@ void setup() {
         Serial.println("Connecting to WiFi..");
     }
     Serial.println("Connected to the WiFi network");
-    //connecting to a mqtt broker
+    //connecting to a mqtt broker happens in loop(), without blocking
     client.setServer(mqtt_broker, mqtt_port);
-    while (!client.connected()) {
-        String client_id = "esp8266-client-";
-        client_id += String(WiFi.macAddress());
-        Serial.printf("The client %s connects to the public mqtt broker\n", client_id.c_str());
-        if (client.connect(client_id.c_str(), mqtt_username, mqtt_password)) {
-            Serial.println("Public emqx mqtt broker connected");
-        } else {
-            Serial.print("failed with state ");
-            Serial.print(client.state());
-            delay(2000);
-        }
+    snprintf(client_id, sizeof(client_id), "esp8266-client-%s", WiFi.macAddress().c_str());
+}
+
+bool publishReading(const Reading &reading) {
+    // json serialize into a static buffer, no heap churn over days of uptime
+    static char json_string[64];
+    unsigned long encode_start = micros();
+    TelemetryJson data(json_string, sizeof(json_string));
+    data.add("moisture", reading.moisture);
+    data.add("ts", reading.ts);
+    const char *payload = data.finish();
+    unsigned long encode_us = micros() - encode_start;
+    if (!payload) {
+        return false;
     }
+    // publish moisture
+    Serial.printf("%s (encoded in %lu us)\n", payload, encode_us);
+    return client.publish(topic, (const uint8_t *) payload, data.length(), false);
 }
 
 
 void loop() {
-    client.loop();
+    mqtt_connection.loop();
     unsigned long currentMillis = millis();
-    // temperature and humidity data are publish every five second
+    // moisture data is sampled every five second, connected or not
     if (currentMillis - previousMillis >= 5000) {
         previousMillis = currentMillis;
-        float moistureValue = analogRead(sensorPIN);
-        // json serialize
-        DynamicJsonDocument data(256);
-        data["moisture"] = moistureValue;
-        // publish moisture
-        char json_string[256];
-        serializeJson(data, json_string);
-        //
-        Serial.println(json_string);
-        client.publish(topic, json_string, false);
+        pending_readings.push({currentMillis, (float) analogRead(sensorPIN)});
+    }
+    // oldest first, keep the rest for the next pass if a publish fails
+    while (!pending_readings.empty() && mqtt_connection.connected()
+           && publishReading(pending_readings.front())) {
+        pending_readings.pop();
     }
 }
\ No newline at end of file
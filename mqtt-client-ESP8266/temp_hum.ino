@@ -1,6 +1,8 @@
 #include <ESP8266WiFi.h>
 #include <PubSubClient.h>
-#include <ArduinoJson.h>
+#include <MqttReconnect.h>
+#include <SampleRing.h>
+#include <TelemetryJson.h>
 #include "DHT.h"
 
 // WiFi
@@ -19,10 +21,22 @@ const int mqtt_port = 1883;
 #define DHTTYPE DHT11   // DHT 11
 unsigned long previousMillis = 0;
 
+// Readings wait here until they are published, so nothing is lost while offline
+struct Reading {
+    unsigned long ts;   // millis() when sampled
+    float temp;
+    float hum;
+};
+SampleRing<Reading, 32> pending_readings;
+
 WiFiClient espClient;
 PubSubClient client(espClient);
+char client_id[40];
+MqttReconnect mqtt_connection(client, client_id, mqtt_username, mqtt_password);
 DHT dht(DHTPIN, DHTTYPE);
 
+bool publishReading(const Reading &reading);
+
 void setup() {
     // Set software serial baud to 115200;
     Serial.begin(115200);
@@ -35,42 +49,43 @@ void setup() {
     Serial.println("Connected to the WiFi network");
     //connecting to a mqtt broker
     client.setServer(mqtt_broker, mqtt_port);
-    client.setCallback(callback);
-    //connecting to a mqtt broker
-    while (!client.connected()) {
-        String client_id = "esp8266-client-";
-        client_id += String(WiFi.macAddress());
-        Serial.printf("The client %s connects to the public mqtt broker\n", client_id.c_str());
-        if (client.connect(client_id, mqtt_username, mqtt_password)) {
-            Serial.println("Public emqx mqtt broker connected");
-        } else {
-            Serial.print("failed with state ");
-            Serial.print(client.state());
-            delay(2000);
-        }
-    }
+    //connecting to a mqtt broker happens in loop(), without blocking
+    snprintf(client_id, sizeof(client_id), "esp8266-client-%s", WiFi.macAddress().c_str());
     // dht11 begin
     dht.begin();
 }
 
+bool publishReading(const Reading &reading) {
+    // json serialize into a static buffer, no heap churn over days of uptime
+    static char json_string[64];
+    unsigned long encode_start = micros();
+    TelemetryJson data(json_string, sizeof(json_string));
+    data.add("temp", reading.temp);
+    data.add("hum", reading.hum);
+    data.add("ts", reading.ts);
+    const char *payload = data.finish();
+    unsigned long encode_us = micros() - encode_start;
+    if (!payload) {
+        return false;
+    }
+    // publish temperature and humidity
+    // {"temp":23.5,"hum":55,"ts":5000}
+    Serial.printf("%s (encoded in %lu us)\n", payload, encode_us);
+    return client.publish(topic, (const uint8_t *) payload, data.length(), false);
+}
+
 
 void loop() {
-    client.loop();
+    mqtt_connection.loop();
     unsigned long currentMillis = millis();
-    // temperature and humidity data are publish every five second
+    // temperature and humidity data are sampled every five second, connected or not
     if (currentMillis - previousMillis >= 5000) {
         previousMillis = currentMillis;
-        float temp = dht.readTemperature();
-        float hum = dht.readHumidity();
-        // json serialize
-        DynamicJsonDocument data(256);
-        data["temp"] = temp;
-        data["hum"] = hum;
-        // publish temperature and humidity
-        char json_string[256];
-        serializeJson(data, json_string);
-        // {"temp":23.5,"hum":55}
-        Serial.println(json_string);
-        client.publish(topic, json_string, false);
+        pending_readings.push({currentMillis, dht.readTemperature(), dht.readHumidity()});
+    }
+    // oldest first, keep the rest for the next pass if a publish fails
+    while (!pending_readings.empty() && mqtt_connection.connected()
+           && publishReading(pending_readings.front())) {
+        pending_readings.pop();
     }
 }
\ No newline at end of file
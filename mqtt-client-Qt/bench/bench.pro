@@ -0,0 +1,25 @@
+TEMPLATE = app
+TARGET = qmqtt_bench
+QT = core network qmqtt
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+
+HEADERS += \
+    ../bench_publisher.h \
+    ../broker_address.h \
+    ../latency_histogram.h \
+    ../local_broker.h \
+    ../mqtt_thread.h \
+    ../publish_batcher.h \
+    ../thread_io.h
+
+SOURCES += \
+    main.cpp \
+    ../bench_publisher.cpp \
+    ../local_broker.cpp \
+    ../publish_batcher.cpp
+
+target.path = $$[QT_INSTALL_EXAMPLES]/qmqtt/bench
+INSTALLS += target
@@ -0,0 +1,233 @@
+/*
+ * main.cpp - qmqtt_bench, pub/sub latency and throughput suite
+ *
+ * Runs a fixed list of BenchPublisher runs one after the other and prints
+ * one JSON object per run on stdout, so results of different Qt / qmqtt
+ * builds can be collected and diffed by a script:
+ *
+ *   latency  QoS 0 at a fixed rate, publish() to the echo of the broker,
+ *            i.e. the pub/sub round trip without queueing
+ *   qos0     as fast as the window allows, round trip through the broker
+ *   qos1     as fast as the window allows, publish() to PUBACK
+ *   qos2     as fast as the window allows, publish() to PUBCOMP
+ *
+ * Without --host / --port / MQTT_HOST / MQTT_PORT the runs go to the
+ * loopback broker stand-in (local_broker.h) on a free port in this process,
+ * so numbers from one machine are comparable and need no network.
+ * Progress and errors go to stderr.
+ */
+#include <qmqtt.h>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QTimer>
+#include <cstdio>
+
+#include "bench_publisher.h"
+#include "broker_address.h"
+#include "local_broker.h"
+#include "mqtt_thread.h"
+
+// A run that has not finished by then never connected or hangs
+static const int RUN_TIMEOUT_SECS = 120;
+
+struct BenchRun
+{
+    QString name;
+    BenchOptions options;
+};
+
+class BenchSuite : public QObject
+{
+    Q_OBJECT
+    public:
+        BenchSuite(const QList<BenchRun>& runs, const BrokerAddress& broker,
+                const QString& brokerKind, const QString& label, QObject* parent = NULL)
+            : QObject(parent)
+              , _runs(runs)
+              , _broker(broker)
+              , _brokerKind(brokerKind)
+              , _label(label)
+              , _next(0)
+              , _failed(0)
+        {
+            _timeout.setSingleShot(true);
+            _timeout.setInterval(RUN_TIMEOUT_SECS * 1000);
+            connect(&_timeout, &QTimer::timeout, this, &BenchSuite::onTimeout);
+        }
+
+        void start() { runNext(); }
+
+    signals:
+        void finished(int failed);
+
+    private slots:
+        void onFinished(const BenchResult& result)
+        {
+            _timeout.stop();
+            _thread.reset();
+            print(_runs[_next - 1], &result);
+            runNext();
+        }
+
+        void onTimeout()
+        {
+            _thread.reset();
+            _failed++;
+            fprintf(stderr, "qmqtt_bench: %s did not finish in %d s\n",
+                    qPrintable(_runs[_next - 1].name), RUN_TIMEOUT_SECS);
+            print(_runs[_next - 1], NULL);
+            runNext();
+        }
+
+    private:
+        void runNext()
+        {
+            if (_next == _runs.size()) {
+                emit finished(_failed);
+                return;
+            }
+            const BenchRun& run = _runs[_next++];
+            fprintf(stderr, "qmqtt_bench: %s, %u x %d B at QoS %d against %s\n",
+                    qPrintable(run.name), run.options.count, run.options.payloadSize,
+                    int(run.options.qos), qPrintable(_broker.toString()));
+
+            // Every run gets a fresh client on a fresh thread
+            BenchOptions options = run.options;
+            BrokerAddress broker = _broker;
+            QString clientId = QString("qmqtt_bench_%1_%2")
+                .arg(QCoreApplication::applicationPid()).arg(_next);
+            _thread.reset(new MqttThread([this, options, broker, clientId]() -> QObject* {
+                BenchPublisher* client = new BenchPublisher(options, QHostAddress(), broker.port);
+                broker.applyTo(client);
+                client->setClientId(clientId);
+                client->setCleanSession(true);
+                connect(client, &BenchPublisher::finished, this, &BenchSuite::onFinished);
+                client->connectToHost();
+                return client;
+            }));
+            _thread->start();
+            _timeout.start();
+        }
+
+        // One line of JSON; result NULL for a run that timed out
+        void print(const BenchRun& run, const BenchResult* result)
+        {
+            QJsonObject line;
+            line["test"] = run.name;
+            line["qos"] = int(run.options.qos);
+            line["size"] = run.options.payloadSize;
+            line["count"] = double(run.options.count);
+            line["rate"] = double(run.options.rate);
+            line["window"] = run.options.window;
+            line["broker"] = _brokerKind;
+            line["host"] = _broker.toString();
+            line["qt"] = QString(qVersion());
+            if (!_label.isEmpty())
+                line["label"] = _label;
+            line["ok"] = result != NULL;
+            if (result) {
+                double publishSecs = result->publishNs / 1e9;
+                double totalSecs = result->totalNs / 1e9;
+                const LatencyHistogram& latency = result->latency;
+                line["sent"] = double(result->sent);
+                line["acked"] = double(result->acked);
+                line["lost"] = double(result->sent - result->acked);
+                line["publish_s"] = publishSecs;
+                line["total_s"] = totalSecs;
+                line["publish_msg_s"] = publishSecs > 0 ? result->sent / publishSecs : 0;
+                line["acked_msg_s"] = totalSecs > 0 ? result->acked / totalSecs : 0;
+                line["latency_min_us"] = double(latency.min()) / 1000;
+                line["latency_p50_us"] = double(latency.percentile(50)) / 1000;
+                line["latency_p90_us"] = double(latency.percentile(90)) / 1000;
+                line["latency_p99_us"] = double(latency.percentile(99)) / 1000;
+                line["latency_max_us"] = double(latency.max()) / 1000;
+                line["latency_mean_us"] = double(latency.mean()) / 1000;
+                if (result->writes >= 0 && result->sent > 0)
+                    line["writes_per_msg"] = double(result->writes) / result->sent;
+            }
+            fprintf(stdout, "%s\n", QJsonDocument(line).toJson(QJsonDocument::Compact).constData());
+            fflush(stdout);
+        }
+
+        QList<BenchRun> _runs;
+        BrokerAddress _broker;
+        QString _brokerKind;
+        QString _label;
+        QScopedPointer<MqttThread> _thread;
+        QTimer _timeout;
+        int _next;
+        int _failed;
+};
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("qmqtt pub/sub latency and throughput suite, one JSON line per test.");
+    parser.addHelpOption();
+    QCommandLineOption hostOption("host", "Broker host, overrides MQTT_HOST. Default: in-process loopback broker.", "host");
+    QCommandLineOption portOption("port", "Broker port, overrides MQTT_PORT. Default: 1883 with --host.", "port");
+    QCommandLineOption testsOption("tests", "Tests to run, comma separated.", "list", "latency,qos0,qos1,qos2");
+    QCommandLineOption countOption("count", "Messages per throughput test.", "n", "50000");
+    QCommandLineOption latencyCountOption("latency-count", "Messages of the latency test.", "n", "5000");
+    QCommandLineOption latencyRateOption("latency-rate", "Msg/s of the latency test.", "n", "1000");
+    QCommandLineOption sizeOption("size", "Payload size in bytes.", "bytes", "64");
+    QCommandLineOption windowOption("window", "Max messages waiting for their ack / echo.", "n", "1000");
+    QCommandLineOption labelOption("label", "Free text copied into every result, e.g. the qmqtt commit.", "text");
+    parser.addOptions({hostOption, portOption, testsOption, countOption, latencyCountOption,
+            latencyRateOption, sizeOption, windowOption, labelOption});
+    parser.process(app);
+
+    BenchOptions base;
+    base.quiet = true;
+    base.payloadSize = parser.value(sizeOption).toInt();
+    base.window = parser.value(windowOption).toInt();
+
+    QList<BenchRun> runs;
+    foreach (const QString& name, parser.value(testsOption).split(',', QString::SkipEmptyParts)) {
+        BenchRun run;
+        run.name = name.trimmed();
+        run.options = base;
+        run.options.topic = QString("qmqtt/bench/%1/%2")
+            .arg(QCoreApplication::applicationPid()).arg(run.name);
+        run.options.count = parser.value(countOption).toUInt();
+        if (run.name == "latency") {
+            run.options.count = parser.value(latencyCountOption).toUInt();
+            run.options.rate = parser.value(latencyRateOption).toUInt();
+        } else if (run.name == "qos0" || run.name == "qos1" || run.name == "qos2") {
+            run.options.qos = quint8(run.name.at(3).digitValue());
+        } else {
+            fprintf(stderr, "qmqtt_bench: unknown test %s\n", qPrintable(run.name));
+            return -1;
+        }
+        runs << run;
+    }
+
+    BrokerAddress broker;
+    QString brokerKind = "external";
+    QScopedPointer<MqttThread> localBroker;
+    if (BrokerAddress::overridden(parser.value(hostOption), parser.value(portOption))) {
+        broker = BrokerAddress::resolve(BrokerAddress("127.0.0.1", 1883),
+                parser.value(hostOption), parser.value(portOption));
+    } else {
+        quint16 port = 0;
+        localBroker.reset(LocalBroker::startThread(0, &port));
+        if (!localBroker)
+            return -1;
+        broker = BrokerAddress("127.0.0.1", port);
+        brokerKind = "loopback";
+    }
+
+    BenchSuite suite(runs, broker, brokerKind, parser.value(labelOption));
+    QObject::connect(&suite, &BenchSuite::finished, &app, &QCoreApplication::exit,
+            Qt::QueuedConnection);
+    QTimer::singleShot(0, &suite, &BenchSuite::start);
+    return app.exec();
+}
+
+#include "main.moc"
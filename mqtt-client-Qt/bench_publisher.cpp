@@ -0,0 +1,242 @@
+/*
+ * bench_publisher.cpp - high-rate publish benchmark for qmqtt
+ */
+#include "bench_publisher.h"
+#include "publish_batcher.h"
+
+#include <QTextStream>
+
+// Publishes per event-loop pass, so acks and socket writes get serviced in between
+static const int BENCH_BURST = 256;
+// How long to wait for the remaining acks / echoes after the last publish
+static const int BENCH_DRAIN_TIMEOUT_MS = 5000;
+// How long a full window may go without any ack / echo before the run ends
+static const int BENCH_STALL_TIMEOUT_MS = 5000;
+
+BenchPublisher::BenchPublisher(const BenchOptions& options,
+        const QHostAddress& host, const quint16 port, QObject* parent)
+    : QMQTT::Client(host, port, parent)
+      , _options(options)
+      , _message(0, options.topic, QByteArray(options.payloadSize, 'x'), options.qos)
+      , _batcher(new PublishBatcher([this](const QMQTT::Message& message) {
+                  return publish(message);
+              }, options.coalesceMs, this))
+      , _sent(0)
+      , _acked(0)
+      , _lastSentAt(0)
+      , _done(false)
+{
+    // finished() is usually connected across threads or queued
+    qRegisterMetaType<BenchResult>("BenchResult");
+
+    // msgids are 16 bit, the window must not wrap onto an unacked one
+    _options.window = qBound(1, _options.window, 65535);
+
+    // Paced runs check the schedule every millisecond, unpaced ones every pass
+    _pumpTimer.setInterval(_options.rate > 0 ? 1 : 0);
+    _pumpTimer.setTimerType(Qt::PreciseTimer);
+    _drainTimer.setSingleShot(true);
+    _drainTimer.setInterval(BENCH_DRAIN_TIMEOUT_MS);
+    _stallTimer.setSingleShot(true);
+    _stallTimer.setInterval(BENCH_STALL_TIMEOUT_MS);
+
+    connect(this, &BenchPublisher::connected, this, &BenchPublisher::onConnected);
+    connect(this, &BenchPublisher::disconnected, this, &BenchPublisher::onDisconnected);
+    connect(this, &BenchPublisher::subscribed, this, &BenchPublisher::onSubscribed);
+    connect(this, &BenchPublisher::published, this, &BenchPublisher::onPublished);
+    connect(this, &BenchPublisher::received, this, &BenchPublisher::onReceived);
+    connect(_batcher, &PublishBatcher::sent, this, &BenchPublisher::onSent);
+    connect(&_pumpTimer, &QTimer::timeout, this, &BenchPublisher::pump);
+    connect(&_drainTimer, &QTimer::timeout, this, &BenchPublisher::finish);
+    connect(&_stallTimer, &QTimer::timeout, this, &BenchPublisher::onStall);
+}
+
+void BenchPublisher::onConnected()
+{
+    // QoS 0 has no ack: measure the echo of our own messages instead
+    if (_options.qos == 0)
+        subscribe(_options.topic, 0);
+    else
+        start();
+}
+
+// Nothing reconnects a bench client: end the run, the in-flight messages are lost
+void BenchPublisher::onDisconnected()
+{
+    if (_clock.isValid())
+        finish();
+}
+
+void BenchPublisher::onSubscribed(const QString& topic, const quint8 qos)
+{
+    Q_UNUSED(qos);
+    if (topic == _options.topic && !_clock.isValid())
+        start();
+}
+
+void BenchPublisher::start()
+{
+    if (!_options.quiet) {
+        QTextStream out(stdout);
+        out << "bench: publishing " << _options.count << " x " << _options.payloadSize
+            << " B to " << _options.topic << " at QoS " << int(_options.qos) << ", rate "
+            << (_options.rate > 0 ? QString::number(_options.rate) + " msg/s" : QString("unlimited"))
+            << ", window " << _options.window;
+        if (_options.coalesceMs >= 0)
+            out << ", coalescing " << _options.coalesceMs << " ms";
+        out << "\n";
+        out.flush();
+    }
+
+    _ioAtStart = ThreadIo::sample();
+
+    _clock.start();
+    _pumpTimer.start();
+}
+
+void BenchPublisher::pump()
+{
+    quint64 due = _options.count;
+    if (_options.rate > 0)
+        due = qMin(due, quint64(_clock.nsecsElapsed()) * _options.rate / 1000000000 + 1);
+
+    for (int burst = 0; burst < BENCH_BURST && _sent < due; burst++) {
+        if (outstanding() >= _options.window) {
+            // Window full, acked() restarts the pump; if no ack comes
+            // at all (a lost PUBACK or echo), onStall() ends the run
+            _pumpTimer.stop();
+            _stallTimer.start();
+            return;
+        }
+        qint64 sentAt = _clock.nsecsElapsed();
+        _batcher->publish(_message, sentAt);
+        _lastSentAt = sentAt;
+        _sent++;
+    }
+
+    if (_sent == _options.count) {
+        _pumpTimer.stop();
+        _batcher->flush();
+        if (outstanding() == 0)
+            finish();
+        else
+            _drainTimer.start();
+    }
+}
+
+// The message left the batcher: start waiting for its ack / echo
+void BenchPublisher::onSent(qint64 sentAt, quint16 msgid)
+{
+    if (_options.qos == 0)
+        _echoQueue.enqueue(sentAt);
+    else
+        _inflight.insert(msgid, sentAt);
+}
+
+int BenchPublisher::outstanding() const
+{
+    return _echoQueue.size() + _inflight.size() + _batcher->pending();
+}
+
+void BenchPublisher::onPublished(const QMQTT::Message& message, quint16 msgid)
+{
+    Q_UNUSED(message);
+    // At QoS 0 qmqtt emits published from inside publish(), that is no ack
+    if (_options.qos == 0)
+        return;
+    QHash<quint16, qint64>::iterator it = _inflight.find(msgid);
+    if (it == _inflight.end())
+        return;
+    qint64 sentAt = it.value();
+    _inflight.erase(it);
+    acked(sentAt);
+}
+
+void BenchPublisher::onReceived(const QMQTT::Message& message)
+{
+    if (_options.qos != 0 || _echoQueue.isEmpty() || message.topic() != _options.topic)
+        return;
+    acked(_echoQueue.dequeue());
+}
+
+void BenchPublisher::acked(qint64 sentAt)
+{
+    // Stragglers after the drain timeout count as lost
+    if (_done)
+        return;
+    _latency.record(_clock.nsecsElapsed() - sentAt);
+    _acked++;
+    resume();
+}
+
+void BenchPublisher::resume()
+{
+    if (_done)
+        return;
+    if (_sent < _options.count) {
+        _stallTimer.stop();
+        if (!_pumpTimer.isActive())
+            _pumpTimer.start();
+    } else if (outstanding() == 0) {
+        finish();
+    }
+}
+
+void BenchPublisher::onStall()
+{
+    if (!_options.quiet) {
+        QTextStream out(stdout);
+        out << "bench: window full and no ack / echo for " << BENCH_STALL_TIMEOUT_MS
+            << " ms, giving up with " << outstanding() << " outstanding\n";
+        out.flush();
+    }
+    finish();
+}
+
+void BenchPublisher::finish()
+{
+    if (_done)
+        return;
+    _done = true;
+    _pumpTimer.stop();
+    _drainTimer.stop();
+    _stallTimer.stop();
+
+    BenchResult result;
+    result.sent = _sent;
+    result.acked = _acked;
+    result.publishNs = _lastSentAt;
+    result.totalNs = _clock.nsecsElapsed();
+    result.batches = _batcher->batches();
+    ThreadIo io = ThreadIo::sample();
+    if (io.valid() && _ioAtStart.valid())
+        result.writes = io.syscw - _ioAtStart.syscw;
+    result.latency = _latency;
+
+    if (!_options.quiet) {
+        double publishSecs = result.publishNs / 1e9;
+        double totalSecs = result.totalNs / 1e9;
+        QTextStream out(stdout);
+        out << "bench: published " << _sent << " in " << QString::number(publishSecs, 'f', 3) << " s, "
+            << QString::number(publishSecs > 0 ? _sent / publishSecs : 0, 'f', 0) << " msg/s\n";
+        out << "bench: " << (_options.qos == 0 ? "echoed " : "acked ") << _acked << " in "
+            << QString::number(totalSecs, 'f', 3) << " s, "
+            << QString::number(totalSecs > 0 ? _acked / totalSecs : 0, 'f', 0) << " msg/s, lost "
+            << (_sent - _acked) << "\n";
+        out << "bench: " << (_options.qos == 0 ? "publish-to-echo" : "publish-to-ack")
+            << " latency " << _latency.summaryUs() << "\n";
+        out << "bench: " << result.batches << " batches, "
+            << QString::number(result.batches ? double(_sent) / result.batches : 0, 'f', 1)
+            << " msg/batch";
+        if (result.writes >= 0)
+            out << ", " << result.writes << " write syscalls, "
+                << QString::number(_sent ? double(result.writes) / _sent : 0, 'f', 3)
+                << " per message";
+        out << "\n";
+        out.flush();
+    }
+
+    if (isConnectedToHost())
+        disconnectFromHost();
+    emit finished(result);
+}
@@ -0,0 +1,101 @@
+/*
+ * bench_publisher.h - high-rate publish benchmark for qmqtt
+ *
+ * Publishes a pre-built message as fast as the outstanding window allows,
+ * or paced to a fixed rate, and reports msg/s and latency at the end.
+ * QoS 1/2 latency is publish() to the PUBACK/PUBCOMP (the published
+ * signal). QoS 0 has no ack, so the publisher subscribes to its own topic
+ * and measures publish() to the echo from the broker instead.
+ *
+ * With coalesceMs >= 0 publishes go through a PublishBatcher, and latency
+ * counts from the moment the message was queued. Where the platform
+ * allows (thread_io.h) the report includes write syscalls per message.
+ */
+#ifndef BENCH_PUBLISHER_H
+#define BENCH_PUBLISHER_H
+
+#include <qmqtt.h>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMetaType>
+#include <QQueue>
+#include <QTimer>
+
+#include "latency_histogram.h"
+#include "thread_io.h"
+
+class PublishBatcher;
+
+struct BenchOptions
+{
+    QString topic = "qmqtt/bench";
+    quint32 count = 100000;     // messages to publish
+    quint32 rate = 0;           // msg/s, 0 = as fast as possible
+    quint8 qos = 0;
+    int payloadSize = 64;       // bytes
+    int window = 1000;          // max messages waiting for their ack / echo
+    bool quiet = false;         // no report on stdout, e.g. one client of many
+    int coalesceMs = -1;        // PublishBatcher window, -1 = publish directly
+};
+
+// Outcome of one run, handed out with finished() so it can cross threads
+struct BenchResult
+{
+    quint32 sent = 0;
+    quint32 acked = 0;          // acks, or echoes at QoS 0
+    qint64 publishNs = 0;       // until the last publish()
+    qint64 totalNs = 0;         // until the last ack / echo, or the drain timeout
+    quint64 batches = 0;        // batches the publishes went out in
+    qint64 writes = -1;         // write syscalls of the thread, -1 if unknown
+    LatencyHistogram latency;
+};
+Q_DECLARE_METATYPE(BenchResult)
+
+class BenchPublisher : public QMQTT::Client
+{
+    Q_OBJECT
+    public:
+        explicit BenchPublisher(const BenchOptions& options,
+                const QHostAddress& host, const quint16 port,
+                QObject* parent = NULL);
+        virtual ~BenchPublisher() {}
+
+    signals:
+        void finished(const BenchResult& result);
+
+    private slots:
+        void onConnected();
+        void onDisconnected();
+        void onSubscribed(const QString& topic, const quint8 qos);
+        void onPublished(const QMQTT::Message& message, quint16 msgid);
+        void onReceived(const QMQTT::Message& message);
+        void onSent(qint64 sentAt, quint16 msgid);
+        void pump();
+        void onStall();
+        void finish();
+
+    private:
+        void start();
+        void acked(qint64 sentAt);
+        void resume();
+        int outstanding() const;
+
+        BenchOptions _options;
+        QMQTT::Message _message;        // built once, shared by every publish
+        QTimer _pumpTimer;
+        QTimer _drainTimer;
+        QTimer _stallTimer;
+        QElapsedTimer _clock;
+        PublishBatcher* _batcher;
+        ThreadIo _ioAtStart;
+
+        quint32 _sent;
+        quint32 _acked;
+        qint64 _lastSentAt;
+        QQueue<qint64> _echoQueue;      // QoS 0: send times, echoes come back in order
+        QHash<quint16, qint64> _inflight; // QoS 1/2: msgid -> send time
+        LatencyHistogram _latency;
+        bool _done;
+};
+
+#endif // BENCH_PUBLISHER_H
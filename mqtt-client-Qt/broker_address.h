@@ -0,0 +1,68 @@
+/*
+ * broker_address.h - where the examples connect to
+ *
+ * Resolved from, in order: --host / --port, the MQTT_HOST / MQTT_PORT
+ * environment variables, the built-in default. The host may be an IP
+ * address or a name; names go through qmqtt's setHostName().
+ */
+#ifndef BROKER_ADDRESS_H
+#define BROKER_ADDRESS_H
+
+#include <qmqtt.h>
+#include <QHostAddress>
+#include <QString>
+
+struct BrokerAddress
+{
+    QString host;
+    quint16 port;
+
+    BrokerAddress(const QString& host = QString(), quint16 port = 1883)
+        : host(host)
+          , port(port)
+    {
+    }
+
+    // Empty arguments fall through to the environment, then to the default
+    static BrokerAddress resolve(const BrokerAddress& fallback,
+            const QString& hostArg = QString(), const QString& portArg = QString())
+    {
+        BrokerAddress address = fallback;
+        QString host = !hostArg.isEmpty() ? hostArg : QString::fromLocal8Bit(qgetenv("MQTT_HOST"));
+        QString port = !portArg.isEmpty() ? portArg : QString::fromLocal8Bit(qgetenv("MQTT_PORT"));
+        if (!host.isEmpty())
+            address.host = host;
+        bool ok = false;
+        quint16 value = port.toUShort(&ok);
+        if (ok && value > 0)
+            address.port = value;
+        return address;
+    }
+
+    // Whether anything overrides the default
+    static bool overridden(const QString& hostArg, const QString& portArg)
+    {
+        return !hostArg.isEmpty() || !portArg.isEmpty()
+            || !qgetenv("MQTT_HOST").isEmpty() || !qgetenv("MQTT_PORT").isEmpty();
+    }
+
+    // An empty host leaves whatever the client was constructed with
+    void applyTo(QMQTT::Client* client) const
+    {
+        client->setPort(port);
+        if (host.isEmpty())
+            return;
+        QHostAddress address;
+        if (address.setAddress(host))
+            client->setHost(address);
+        else
+            client->setHostName(host);
+    }
+
+    QString toString() const
+    {
+        return QString("%1:%2").arg(host).arg(port);
+    }
+};
+
+#endif // BROKER_ADDRESS_H
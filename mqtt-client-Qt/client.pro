@@ -1,9 +1,27 @@
 TEMPLATE = app
 TARGET = qmqtt_example
 QT = core network qmqtt
+CONFIG += c++11
+
+HEADERS += \
+    bench_publisher.h \
+    inflight_tracker.h \
+    latency_histogram.h \
+    load_generator.h \
+    local_broker.h \
+    mqtt_thread.h \
+    publish_batcher.h \
+    reconnector.h \
+    send_stamp.h \
+    thread_io.h
 
 SOURCES += \
-    example.cpp
+    example.cpp \
+    bench_publisher.cpp \
+    load_generator.cpp \
+    local_broker.cpp \
+    publish_batcher.cpp \
+    reconnector.cpp
 
 target.path = $$[QT_INSTALL_EXAMPLES]/qmqtt/client
 INSTALLS += target
@@ -30,10 +30,27 @@
  *
  */
 #include <qmqtt.h>
+#include <QAtomicInt>
 #include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
 #include <QTimer>
+#include <cstdio>
 #include <iostream>
 
+#include "bench_publisher.h"
+#include "broker_address.h"
+#include "inflight_tracker.h"
+#include "load_generator.h"
+#include "local_broker.h"
+#include "mqtt_thread.h"
+#include "publish_batcher.h"
+#include "reconnector.h"
+#include "send_stamp.h"
+
 // Broker address. QHostAddress supports IP addresses, except for special cases like localhost and null.
 // const QHostAddress EXAMPLE_HOST = QHostAddress::Null;
 // const QHostAddress EXAMPLE_HOST = QHostAddress::LocalHost;
@@ -42,7 +59,22 @@ const QHostAddress EXAMPLE_HOST = QHostAddress("broker.emqx.io");
 const quint16 EXAMPLE_PORT = 1883;
 // Topic for subscription/publication
 const QString EXAMPLE_TOPIC = "qmqtt/example/topic";
+// Port of the loopback broker stand-in (--local-broker)
+const quint16 LOCAL_BROKER_PORT = 18830;
+// Where all modes connect to, see broker_address.h for the overrides. Given
+// as a name: EXAMPLE_HOST above is Null, QHostAddress does not resolve names.
+static BrokerAddress broker("broker.emqx.io", EXAMPLE_PORT);
 
+// Console line for Reconnector::reconnected
+static QByteArray reconnectedLine(qint64 downtimeMs, int attempts, int replayed, int lost)
+{
+    return QString("reconnected after %1 ms, %2 attempts, replayed %3 queued publishes, lost %4")
+        .arg(downtimeMs).arg(attempts).arg(replayed).arg(lost).toUtf8();
+}
+
+// Publisher and Subscriber live on the MQTT thread (see mqtt_thread.h) and
+// never write to the console themselves: everything they want printed is a
+// queued signal to the Console on the main thread.
 class Publisher : public QMQTT::Client
 {
     Q_OBJECT
@@ -53,7 +85,16 @@ class Publisher : public QMQTT::Client
                 QObject* parent = NULL)
             : QMQTT::Client(host, port, parent)
               , _number(0)
-              , _qout(stdout)
+              , _burst(1)
+              , _statsMs(1000)
+              , _held(0)
+              , _stamp(false)
+              , _stampNs(0)
+              , _message(0, EXAMPLE_TOPIC, QByteArray(), 0)
+              , _reconnect(new Reconnector(this))
+              , _batcher(new PublishBatcher([this](const QMQTT::Message& message) {
+                          return _reconnect->publish(message);
+                      }, -1, this))
         {
             // Connect signals and slots for connection
             connect(this, &Publisher::connected, this, &Publisher::onConnected);
@@ -64,12 +105,65 @@ class Publisher : public QMQTT::Client
 
             // Connect signals and slots for disconnection
             connect(this, &Publisher::disconnected, this, &Publisher::onDisconnected);
+            connect(_reconnect, &Reconnector::reconnected, this,
+                    [this](qint64 downtimeMs, int attempts, int replayed, int lost) {
+                        emit line(reconnectedLine(downtimeMs, attempts, replayed, lost));
+                    });
+            connect(_batcher, &PublishBatcher::sent, this, &Publisher::onSent);
+            connect(this, &Publisher::published, this, &Publisher::onPublished);
+            connect(&_statsTimer, &QTimer::timeout, this, &Publisher::onStats);
         }
         virtual ~Publisher() {}
 
+        void setReconnectPolicy(const ReconnectPolicy& policy)
+        {
+            _reconnect->setPolicy(policy);
+        }
+
+        // Messages per tick, and how long to collect them into one write
+        void setBurst(int burst, int coalesceMs)
+        {
+            _burst = qMax(1, burst);
+            _batcher->setWindowMs(coalesceMs);
+        }
+
+        // QoS 1/2: at most window unacked messages, acks later than stallMs
+        // count as a stall. Metrics are printed every statsMs.
+        void setQos(int qos, int window, int stallMs, int statsMs)
+        {
+            _message.setQos(quint8(qBound(0, qos, 2)));
+            _tracker = InflightTracker(window, stallMs);
+            _statsMs = statsMs;
+        }
+
+        // Put a send stamp (send_stamp.h) in front of every payload
+        void setStamp(bool stamp)
+        {
+            _stamp = stamp;
+        }
+
+        // Connect, and keep reconnecting with backoff until the last message
+        void start()
+        {
+            _reconnect->connectToHost();
+        }
+
         QTimer _timer;
         quint16 _number;
-        QTextStream _qout;
+        int _burst;
+        int _statsMs;
+        quint64 _held;              // messages held back by a full window
+        bool _stamp;
+        quint64 _stampNs;           // spent building stamped payloads
+        QMQTT::Message _message;    // reused, only id and payload change
+        InflightTracker _tracker;
+        QTimer _statsTimer;
+        Reconnector* _reconnect;
+        PublishBatcher* _batcher;
+
+    signals:
+        // A line for the console
+        void line(const QByteArray& text);
 
     public slots:
         void onConnected()
@@ -77,46 +171,215 @@ class Publisher : public QMQTT::Client
             subscribe("will/topic", 0);
             // Start or restart the timer with millisecond precision.
             _timer.start(1000);
+            if (_message.qos() > 0 && _statsMs > 0 && !_statsTimer.isActive())
+                _statsTimer.start(_statsMs);
         }
 
-        // Periodically publish messages, stop after 1000 messages
+        // Periodically publish a burst of messages, stop after 1000 messages.
+        // While disconnected they are queued and sent on reconnect.
         void onTimeout()
         {
-            QMQTT::Message message(_number, EXAMPLE_TOPIC,
-                    QString("Number is %1").arg(_number).toUtf8());
-            message.setQos(0);
-            std::cout << publish(message) << std::endl;
-            _number++;
+            for (int i = 0; i < _burst && _number < 1000; i++) {
+                // Backpressure: the rest of the burst waits for acks
+                if (_message.qos() > 0 && _tracker.full(_batcher->pending())) {
+                    _held += _burst - i;
+                    break;
+                }
+                // At QoS 1/2 qmqtt takes a non-zero id as is, and _number would
+                // collide with the ids it hands out itself. Let it pick one;
+                // onSent() gets it back for the tracker.
+                _message.setId(_message.qos() > 0 ? 0 : _number);
+                if (_stamp) {
+                    quint64 start = SendStamp::nowNs();
+                    QByteArray payload(SendStamp::SIZE, '\0');
+                    payload += "Number is ";
+                    payload += QByteArray::number(_number);
+                    SendStamp::write(payload, _number);
+                    _message.setPayload(payload);
+                    _stampNs += SendStamp::nowNs() - start;
+                } else {
+                    _message.setPayload(QByteArray("Number is ") + QByteArray::number(_number));
+                }
+                _batcher->publish(_message);
+                _number++;
+            }
 
             if(_number >= 1000)
             {
+                if (_stamp)
+                    emit line("pub: stamped " + QByteArray::number(_number) + ", build cost "
+                            + QByteArray::number(_stampNs / _number) + " ns/msg");
+                _batcher->flush();
                 // Stop the message publishing timer.
                 _timer.stop();
-                disconnectFromHost();
+                _reconnect->disconnectFromHost();
                 // Call the single shot timer to quit the application.
                 QTimer::singleShot(0, qApp, &QCoreApplication::quit);
             }
         }
 
 
+        void onSent(qint64 tag, quint16 msgid)
+        {
+            Q_UNUSED(tag);
+            if (msgid && _message.qos() > 0)
+                _tracker.sent(msgid);
+            emit line(msgid ? QByteArray::number(msgid) : QByteArray("queued"));
+        }
+
+        // PUBACK / PUBCOMP. At QoS 0 qmqtt emits this from inside publish().
+        void onPublished(const QMQTT::Message& message, quint16 msgid)
+        {
+            if (message.qos() > 0)
+                _tracker.acked(msgid);
+        }
+
+        void onStats()
+        {
+            _tracker.tick();
+            emit line("pub: " + _tracker.summary().toUtf8() + ", held back "
+                    + QByteArray::number(_held));
+        }
+
+
         void onSubscribed(const QString& topic)
         {
-            _qout << "subscribed " << topic << endl;
+            emit line("subscribed " + topic.toUtf8());
         }
 
 
         void onReceived(const QMQTT::Message& message)
         {
-            _qout << "Received from topic: \"" << message.topic()
-                << "\"" << endl;
-            _qout << "Received payload: \"" << QString::fromUtf8(message.payload())
-                << "\"" << endl;
+            emit line("Received from topic: \"" + message.topic().toUtf8() + "\"");
+            emit line("Received payload: \"" + message.payload() + "\"");
         }
 
+        // The reconnector takes it from here, the timer keeps queueing.
+        // qmqtt does not retransmit unacked messages after a reconnect.
         void onDisconnected()
         {
-            QTimer::singleShot(0, qApp, &QCoreApplication::quit);
+            _tracker.abandon();
+            emit line("disconnected");
+        }
+};
+
+// Output of the receive path. Nothing is written per message: sampled
+// messages are appended to a buffer that a timer writes out in one go.
+struct ReceiveOptions
+{
+    int sampleEvery = 1;    // print every Nth message, 0 = only count
+    int flushMs = 100;      // how often buffered output is written
+    int statsMs = 1000;     // receive rate / backlog report interval, 0 = off
+    int slowHandlerMs = 0;  // stress: sleep this long in the console per sampled message
+    bool stamp = false;     // parse send stamps, report one-way latency / gaps / reordering
+};
+
+// Output buffered beyond this is dropped (and counted) instead of growing without bound
+const int RECEIVE_OUTPUT_MAX = 1024 * 1024;
+
+// Presentation, on the main thread. Slow here only delays the output, the
+// MQTT thread keeps reading the socket and answering keepalives.
+class Console : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit Console(const ReceiveOptions& options = ReceiveOptions(), QObject* parent = NULL)
+            : QObject(parent)
+              , _options(options)
+              , _pendingLines(0)
+              , _droppedLines(0)
+              , _skipped(0)
+              , _maxDelayMs(0)
+        {
+            _pending.reserve(64 * 1024);   // keeps its capacity across flushes
+            connect(&_flushTimer, &QTimer::timeout, this, &Console::flushOutput);
+            _flushTimer.start(qMax(1, _options.flushMs));
         }
+        virtual ~Console()
+        {
+            flushOutput();
+        }
+
+        // Sampled messages emitted by the MQTT thread and not handled here yet
+        QAtomicInt backlog;
+        // Set to drop queued samples without handling them, e.g. before exiting
+        QAtomicInt draining;
+
+    public slots:
+        void print(const QByteArray& text)
+        {
+            _pending += text;
+            _pending += '\n';
+            _pendingLines++;
+        }
+
+        // The payload is copied as raw bytes, it is never decoded as UTF-8.
+        void onSampled(const QString& topic, const QByteArray& payload)
+        {
+            backlog.deref();
+            if (draining.load()) {
+                _skipped++;
+                return;
+            }
+            if (_options.slowHandlerMs > 0)
+                QThread::msleep(_options.slowHandlerMs);
+            if (_pending.size() >= RECEIVE_OUTPUT_MAX) {
+                _droppedLines++;
+                return;
+            }
+            _pending += "Received from topic: \"";
+            _pending += topic.toUtf8();
+            _pending += "\"\nReceived payload: \"";
+            _pending += payload;
+            _pending += "\"\n";
+            _pendingLines++;
+        }
+
+        // Network side stats, plus how far the console is behind
+        void onStats(const QByteArray& text, qint64 emittedAtMs)
+        {
+            qint64 delayMs = qMax<qint64>(0, QDateTime::currentMSecsSinceEpoch() - emittedAtMs);
+            _maxDelayMs = qMax(_maxDelayMs, delayMs);
+
+            _pending += text;
+            _pending += QString(" | console: backlog %1 msgs, output %2 lines (%3 KB), "
+                    "dropped %4 lines, delay %5 ms (max %6 ms)\n")
+                .arg(backlog.load()).arg(_pendingLines).arg(_pending.size() / 1024)
+                .arg(_droppedLines).arg(delayMs).arg(_maxDelayMs).toUtf8();
+        }
+
+        // Last words, then leave the event loop with the given exit code
+        void finish(const QByteArray& text, int exitCode)
+        {
+            if (_skipped > 0)
+                print(QByteArray("console: skipped ") + QByteArray::number(_skipped)
+                        + " queued samples on exit");
+            print(text);
+            flushOutput();
+            QCoreApplication::exit(exitCode);
+        }
+
+        // Write everything buffered since the last tick with one write
+        void flushOutput()
+        {
+            if (_pending.isEmpty())
+                return;
+            if (!_out.isOpen())
+                _out.open(fileno(stdout), QIODevice::WriteOnly | QIODevice::Unbuffered);
+            _out.write(_pending);
+            _pending.resize(0);
+            _pendingLines = 0;
+        }
+
+    private:
+        ReceiveOptions _options;
+        QFile _out;
+        QTimer _flushTimer;
+        QByteArray _pending;
+        int _pendingLines;
+        quint64 _droppedLines;
+        quint64 _skipped;
+        qint64 _maxDelayMs;
 };
 
 class Subscriber : public QMQTT::Client
@@ -128,108 +391,463 @@ class Subscriber : public QMQTT::Client
                 const quint16 port = EXAMPLE_PORT,
                 QObject* parent = NULL)
             : QMQTT::Client(host, port, parent)
-              , _qout(stdout)
+              , _backlog(NULL)
+              , _received(0)
+              , _receivedBytes(0)
+              , _lastReceived(0)
+              , _lastReceivedBytes(0)
+              , _maxLagMs(0)
+              , _pingResps(0)
+              , _maxPingGapMs(0)
+              , _disconnects(0)
+              , _reconnect(new Reconnector(this))
         {
             // Connect signals and slots for connection establishment and received messages.
             connect(this, &Subscriber::connected, this, &Subscriber::onConnected);
+            connect(this, &Subscriber::disconnected, this, &Subscriber::onDisconnected);
             connect(this, &Subscriber::subscribed, this, &Subscriber::onSubscribed);
             connect(this, &Subscriber::received, this, &Subscriber::onReceived);
+            connect(this, &Subscriber::pingresp, this, &Subscriber::onPingResp);
+            connect(&_statsTimer, &QTimer::timeout, this, &Subscriber::onStats);
+            _statsTimer.setTimerType(Qt::PreciseTimer);
+            connect(_reconnect, &Reconnector::reconnected, this,
+                    [this](qint64 downtimeMs, int attempts, int replayed, int lost) {
+                        emit line(reconnectedLine(downtimeMs, attempts, replayed, lost));
+                    });
         }
         virtual ~Subscriber() {}
 
-        QTextStream _qout;
+        void setReconnectPolicy(const ReconnectPolicy& policy)
+        {
+            _reconnect->setPolicy(policy);
+        }
+
+        // Connect, and reconnect with backoff whenever the connection drops
+        void start()
+        {
+            _reconnect->connectToHost();
+        }
+
+        void setReceiveOptions(const ReceiveOptions& options)
+        {
+            _options = options;
+        }
+
+        // Counter of samples in flight to the console, for its backlog report
+        void setConsoleBacklog(QAtomicInt* backlog)
+        {
+            _backlog = backlog;
+        }
+
+        quint32 pingResps() const { return _pingResps; }
+        qint64 maxPingGapMs() const { return _maxPingGapMs; }
+        quint32 disconnects() const { return _disconnects; }
+
+        ReceiveOptions _options;
+        QAtomicInt* _backlog;
+        QTimer _statsTimer;
+        QElapsedTimer _statsClock;
+        QElapsedTimer _pingClock;
+        quint64 _received;
+        quint64 _receivedBytes;
+        quint64 _lastReceived;
+        quint64 _lastReceivedBytes;
+        qint64 _maxLagMs;
+        quint32 _pingResps;
+        qint64 _maxPingGapMs;
+        quint32 _disconnects;
+        Reconnector* _reconnect;
+        StampStats _stamps;
+
+    signals:
+        // A line for the console
+        void line(const QByteArray& text);
+        // Every sampleEvery-th message
+        void sampled(const QString& topic, const QByteArray& payload);
+        void stats(const QByteArray& text, qint64 emittedAtMs);
 
     public slots:
         // Handler for successful connection
         void onConnected()
         {
-            _qout << "connected" << endl;
+            emit line("connected");
             subscribe(EXAMPLE_TOPIC, 0);
+            // The first gap runs from the CONNACK to the first PINGRESP
+            _pingClock.start();
+            if (_options.statsMs > 0 && !_statsTimer.isActive()) {
+                _statsTimer.start(_options.statsMs);
+                _statsClock.start();
+            }
+        }
+
+        void onDisconnected()
+        {
+            _disconnects++;
+            _pingClock.invalidate();
+            emit line("disconnected");
         }
 
         // Callback for successful subscription
         void onSubscribed(const QString& topic)
         {
-            _qout << "subscribed " << topic << endl;
+            emit line("subscribed " + topic.toUtf8());
         }
 
-        // Callback for received messages
+        // Callback for received messages: count, and hand a sample to the console
         void onReceived(const QMQTT::Message& message)
         {
-            _qout << "Received from topic: \"" << message.topic()
-                << "\"" << endl;
-            _qout << "Received payload: \"" << QString::fromUtf8(message.payload())
-                << "\"" << endl;
+            _received++;
+            _receivedBytes += message.payload().size();
+            int skip = _options.stamp ? _stamps.receive(message.payload()) : 0;
+            if (_options.sampleEvery <= 0 || _received % _options.sampleEvery != 0)
+                return;
+            if (_backlog)
+                _backlog->ref();
+            emit sampled(message.topic(), skip ? message.payload().mid(skip) : message.payload());
+        }
+
+        // Keepalive health: PINGRESPs keep arriving about every keepAlive seconds
+        void onPingResp()
+        {
+            _pingResps++;
+            if (_pingClock.isValid())
+                _maxPingGapMs = qMax(_maxPingGapMs, _pingClock.restart());
+        }
+
+        // Receive rate, and how far this thread's event loop is behind
+        void onStats()
+        {
+            qint64 elapsedMs = _statsClock.restart();
+            qint64 lagMs = qMax<qint64>(0, elapsedMs - _options.statsMs);
+            _maxLagMs = qMax(_maxLagMs, lagMs);
+            double secs = elapsedMs / 1000.0;
+
+            QString text = QString("recv: %1 msg/s, %2 KB/s, total %3, loop lag %4 ms (max %5 ms), "
+                    "pingresp %6 (max gap %7 ms), disconnects %8")
+                .arg(secs > 0 ? (_received - _lastReceived) / secs : 0, 0, 'f', 0)
+                .arg(secs > 0 ? (_receivedBytes - _lastReceivedBytes) / secs / 1024 : 0, 0, 'f', 1)
+                .arg(_received).arg(lagMs).arg(_maxLagMs)
+                .arg(_pingResps).arg(_maxPingGapMs).arg(_disconnects);
+            if (_options.stamp)
+                text += ", " + _stamps.summary();
+            emit stats(text.toUtf8(), QDateTime::currentMSecsSinceEpoch());
+            _lastReceived = _received;
+            _lastReceivedBytes = _receivedBytes;
+        }
+};
+
+// Stress test for the threading: the console sleeps in every sampled
+// message while a flood is published to the subscribed topic. Passes if
+// the subscriber never dropped its connection and PINGRESPs kept coming
+// about every keepAlive seconds, however far the console fell behind.
+class StressCheck : public QObject
+{
+    Q_OBJECT
+    public:
+        StressCheck(Subscriber* subscriber, Console* console, int keepAliveSecs,
+                int durationSecs, QObject* parent = NULL)
+            : QObject(parent)
+              , _subscriber(subscriber)
+              , _console(console)
+              , _keepAliveSecs(keepAliveSecs)
+              , _durationSecs(durationSecs)
+        {
+            QTimer::singleShot(durationSecs * 1000, this, &StressCheck::check);
+        }
+
+    signals:
+        void done(const QByteArray& text, int exitCode);
+
+    private slots:
+        void check()
+        {
+            // PINGREQ goes out every keepAlive seconds, allow for one late tick
+            qint64 maxGapMs = _keepAliveSecs * 1500;
+            quint32 minPingResps = quint32(qMax(1, _durationSecs / _keepAliveSecs - 1));
+            bool healthy = _subscriber->disconnects() == 0
+                && _subscriber->pingResps() >= minPingResps
+                && _subscriber->maxPingGapMs() <= maxGapMs;
+            int behind = _console->backlog.load();
+            _console->draining.store(1);
+
+            emit done(QString("stress: %1 - %2 s, console %3 msgs behind, pingresp %4 "
+                        "(need %5), max gap %6 ms (limit %7 ms), disconnects %8")
+                    .arg(healthy ? "PASS" : "FAIL").arg(_durationSecs).arg(behind)
+                    .arg(_subscriber->pingResps()).arg(minPingResps)
+                    .arg(_subscriber->maxPingGapMs()).arg(maxGapMs)
+                    .arg(_subscriber->disconnects()).toUtf8(),
+                    healthy ? 0 : 1);
         }
+
+    private:
+        Subscriber* _subscriber;
+        Console* _console;
+        int _keepAliveSecs;
+        int _durationSecs;
 };
 
+static void configureSubscriber(Subscriber* subscriber, const ReceiveOptions& options,
+        const ReconnectPolicy& reconnect, Console* console, int keepAlive)
+{
+    subscriber->setReceiveOptions(options);
+    subscriber->setConsoleBacklog(&console->backlog);
+
+    // Set Hostname, supporting both IP and domain name.
+    // subscriber->setHostName("34.211.84.46");
+    // subscriber->setHostName("broker.emqx.io");
+    // Set MQTT version, supporting V3_1_1 and V3_1_0.
+    subscriber->setVersion(QMQTT::V3_1_1);
+    // Set client ID
+    subscriber->setClientId("sub_client");
+    // Set username
+    subscriber->setUsername("username");
+    // Set password
+    subscriber->setPassword("password");
+    // Reconnect with exponential backoff instead of qmqtt's fixed interval
+    subscriber->setReconnectPolicy(reconnect);
+    // Set keep-alive interval
+    subscriber->setKeepAlive(keepAlive);
+    // Set clean session
+    subscriber->setCleanSession(true);
+    // Set will topic
+    subscriber->setWillTopic("will/topic");
+
+    QByteArray ba("Hello");
+    // Set will message
+    subscriber->setWillMessage(ba);
+
+    // Presentation happens on the console's (main) thread, queued
+    QObject::connect(subscriber, &Subscriber::line, console, &Console::print);
+    QObject::connect(subscriber, &Subscriber::sampled, console, &Console::onSampled);
+    QObject::connect(subscriber, &Subscriber::stats, console, &Console::onStats);
+}
 
 int main(int argc, char** argv)
 {
-    if (argc != 2) {
-        std::cout << "Usage: qmqtt_example [pub | sub]" << std::endl;
-        return -1;
-    }
+    // Define a Qt application object, the entry point for Qt GUI programs
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("qmqtt example: pub | sub | bench | stress | load");
+    parser.addHelpOption();
+    parser.addPositionalArgument("mode", "pub, sub, bench, stress or load");
+    // Options for the bench mode
+    QCommandLineOption countOption("count", "Messages to publish.", "n", "100000");
+    QCommandLineOption rateOption("rate", "Messages per second, 0 = as fast as possible. "
+            "Comma separated in load mode, cycled over the clients.", "msg/s", "0");
+    QCommandLineOption qosOption("qos", "QoS level 0, 1 or 2.", "qos", "0");
+    QCommandLineOption sizeOption("size", "Payload size in bytes.", "bytes", "64");
+    QCommandLineOption windowOption("window", "Max messages waiting for their ack / echo.", "n", "1000");
+    QCommandLineOption coalesceOption("coalesce-ms", "Collect publishes for this long and write them "
+            "in one go, 0 = per event-loop pass, -1 = off.", "ms", "-1");
+    // Options for the pub mode
+    QCommandLineOption burstOption("burst", "Messages published per tick.", "n", "1");
+    QCommandLineOption stallOption("stall-ms", "QoS 1/2: an ack later than this is a stall.", "ms", "1000");
+    // Options for the sub mode
+    QCommandLineOption sampleOption("sample", "Print every Nth message, 0 = only count.", "n", "1");
+    QCommandLineOption flushOption("flush-ms", "Interval for writing buffered output.", "ms", "100");
+    QCommandLineOption statsOption("stats-ms", "Receive rate report interval, 0 = off.", "ms", "1000");
+    QCommandLineOption slowOption("slow-handler-ms", "Sleep in the console per printed message.", "ms", "0");
+    QCommandLineOption keepAliveOption("keepalive", "Keep-alive interval.", "s", "100");
+    QCommandLineOption backoffMinOption("backoff-min-ms", "First reconnect delay.", "ms", "500");
+    QCommandLineOption backoffMaxOption("backoff-max-ms", "Reconnect delay cap, doubling up to it.", "ms", "30000");
+    QCommandLineOption stampOption("stamp", "Pub: send stamp in every payload. "
+            "Sub: report one-way latency, gaps and reordering from it.");
+    QCommandLineOption sameThreadOption("same-thread",
+            "Run the MQTT client on the main thread, to compare.");
+    // Options for the stress and load modes
+    QCommandLineOption durationOption("duration", "Run length.", "s", "30");
+    QCommandLineOption clientsOption("clients", "Load: number of clients.", "n", "10");
+    QCommandLineOption threadsOption("threads", "Load: MQTT threads the clients are spread over.", "n", "2");
+    QCommandLineOption topicOption("topic", "Load: topic patterns, %1 = client index. "
+            "Comma separated, cycled over the clients.", "patterns", "qmqtt/load/%1");
+    QCommandLineOption hostOption("host", "Broker host, overrides MQTT_HOST and broker.emqx.io.", "host");
+    QCommandLineOption portOption("port", "Broker port, overrides MQTT_PORT and 1883.", "port");
+    QCommandLineOption localBrokerOption("local-broker",
+            "Bench/load: run against a loopback broker stand-in in this process.");
+    parser.addOptions({countOption, rateOption, qosOption, sizeOption, windowOption,
+            coalesceOption, burstOption, stallOption, sampleOption, flushOption, statsOption, slowOption, keepAliveOption,
+            backoffMinOption, backoffMaxOption, stampOption, sameThreadOption, durationOption, clientsOption, threadsOption, topicOption,
+            hostOption, portOption, localBrokerOption});
+    parser.process(app);
 
-    QString s = QString(argv[1]);
-    if (!s.contains("sub") && !s.contains("pub")) {
+    QString s = parser.positionalArguments().value(0);
+    if (!s.contains("sub") && !s.contains("pub") && s != "bench" && s != "stress" && s != "load") {
 
         QTextStream qout(stdout);
         qout<< "Unknown arguments: " << s << endl;
-        std::cout << "Usage: qmqtt_example [pub | sub]" << std::endl;
+        std::cout << "Usage: qmqtt_example [pub | sub | bench | stress | load [options]]" << std::endl;
         return -1;
     }
 
+    broker = BrokerAddress::resolve(broker, parser.value(hostOption), parser.value(portOption));
+    QScopedPointer<MqttThread> localBroker;
+    if (parser.isSet(localBrokerOption) && (s == "bench" || s == "load")) {
+        localBroker.reset(LocalBroker::startThread(LOCAL_BROKER_PORT));
+        if (!localBroker)
+            return -1;
+        broker = BrokerAddress("127.0.0.1", LOCAL_BROKER_PORT);
+    }
 
-    // Define a Qt application object, the entry point for Qt GUI programs
-    QCoreApplication app(argc, argv);
-    Subscriber subscriber;
-    Publisher publisher;
+    if (s == "load") {
+        LoadOptions options;
+        options.clients = parser.value(clientsOption).toInt();
+        options.threads = parser.value(threadsOption).toInt();
+        options.topics = parser.value(topicOption).split(',', QString::SkipEmptyParts);
+        if (parser.isSet(rateOption)) {
+            options.rates.clear();
+            foreach (const QString& rate, parser.value(rateOption).split(',', QString::SkipEmptyParts))
+                options.rates << rate.toUInt();
+        }
+        options.durationSecs = qMax(1, parser.value(durationOption).toInt());
+        options.count = parser.value(countOption).toUInt();
+        options.qos = quint8(qBound(0, parser.value(qosOption).toInt(), 2));
+        options.payloadSize = qMax(0, parser.value(sizeOption).toInt());
+        if (parser.isSet(windowOption))
+            options.window = parser.value(windowOption).toInt();
+        options.coalesceMs = parser.value(coalesceOption).toInt();
+        if (parser.isSet(keepAliveOption))
+            options.keepAlive = parser.value(keepAliveOption).toInt();
+
+        LoadGenerator load(options, broker);
+        QObject::connect(&load, &LoadGenerator::finished, &app, &QCoreApplication::quit,
+                Qt::QueuedConnection);
+        load.start();
+        return app.exec();
+    }
+
+    if (s == "bench") {
+        BenchOptions options;
+        options.count = parser.value(countOption).toUInt();
+        options.rate = parser.value(rateOption).toUInt();
+        options.qos = quint8(qBound(0, parser.value(qosOption).toInt(), 2));
+        options.payloadSize = qMax(0, parser.value(sizeOption).toInt());
+        options.window = parser.value(windowOption).toInt();
+        options.coalesceMs = parser.value(coalesceOption).toInt();
+
+        BenchPublisher bench(options, EXAMPLE_HOST, broker.port);
+        broker.applyTo(&bench);
+        bench.setClientId(QString("bench_client_%1").arg(QCoreApplication::applicationPid()));
+        bench.setUsername("username");
+        bench.setPassword("password");
+        bench.setKeepAlive(100);
+        bench.setCleanSession(true);
+        QObject::connect(&bench, &BenchPublisher::finished, &app, &QCoreApplication::quit,
+                Qt::QueuedConnection);
+        bench.connectToHost();
+        return app.exec();
+    }
+
+    ReceiveOptions receiveOptions;
+    receiveOptions.sampleEvery = parser.value(sampleOption).toInt();
+    receiveOptions.flushMs = parser.value(flushOption).toInt();
+    receiveOptions.statsMs = parser.value(statsOption).toInt();
+    receiveOptions.slowHandlerMs = parser.value(slowOption).toInt();
+    receiveOptions.stamp = parser.isSet(stampOption);
+    int keepAlive = qMax(1, parser.value(keepAliveOption).toInt());
+    ReconnectPolicy reconnect;
+    reconnect.initialMs = qMax(1, parser.value(backoffMinOption).toInt());
+    reconnect.maxMs = qMax(reconnect.initialMs, parser.value(backoffMaxOption).toInt());
+    int durationSecs = qMax(1, parser.value(durationOption).toInt());
+    quint32 rate = parser.value(rateOption).toUInt();
 
-    if (s.contains("sub")) {
+    if (s == "stress") {
+        // Every message is printed, so every message pays the slow handler
+        receiveOptions.sampleEvery = 1;
+        if (!parser.isSet(slowOption))
+            receiveOptions.slowHandlerMs = 20;
+        if (!parser.isSet(keepAliveOption))
+            keepAlive = 2;
+        if (rate == 0)
+            rate = 1000;
+    }
+
+    // Main thread: presentation only
+    Console console(receiveOptions);
+    MqttThread::Factory factory;
+
+    if (s == "stress") {
+        std::cout << "stress: console sleeps " << receiveOptions.slowHandlerMs << " ms per message, "
+            << rate << " msg/s for " << durationSecs << " s, keepalive " << keepAlive << " s"
+            << (parser.isSet(sameThreadOption) ? ", same thread" : "") << std::endl;
+
+        factory = [receiveOptions, reconnect, keepAlive, durationSecs, rate, &console]() -> QObject* {
+            QObject* root = new QObject;
+            Subscriber* subscriber = new Subscriber(EXAMPLE_HOST, EXAMPLE_PORT, root);
+            broker.applyTo(subscriber);
+            configureSubscriber(subscriber, receiveOptions, reconnect, &console, keepAlive);
+            subscriber->setClientId(QString("stress_sub_%1").arg(QCoreApplication::applicationPid()));
+
+            // The flood, on the same thread as the subscriber
+            BenchOptions flood;
+            flood.topic = EXAMPLE_TOPIC;
+            flood.rate = rate;
+            flood.count = rate * quint32(durationSecs);
+            BenchPublisher* publisher = new BenchPublisher(flood, EXAMPLE_HOST, EXAMPLE_PORT, root);
+            broker.applyTo(publisher);
+            publisher->setClientId(QString("stress_pub_%1").arg(QCoreApplication::applicationPid()));
+            publisher->setKeepAlive(keepAlive);
+            publisher->setCleanSession(true);
+
+            StressCheck* check = new StressCheck(subscriber, &console, keepAlive, durationSecs, root);
+            QObject::connect(check, &StressCheck::done, &console, &Console::finish);
+
+            subscriber->start();
+            publisher->connectToHost();
+            return root;
+        };
+    } else if (s.contains("sub")) {
        std::cout << "sub" << std::endl;
 
-       // Set Hostname, supporting both IP and domain name.
-       // subscriber.setHostName("34.211.84.46");
-       // subscriber.setHostName("broker.emqx.io");
-       // Set MQTT version, supporting V3_1_1 and V3_1_0.
-       subscriber.setVersion(QMQTT::V3_1_1);
-       // Set client ID
-       subscriber.setClientId("sub_client");
-       // Set username
-       subscriber.setUsername("username");
-       // Set password
-       subscriber.setPassword("password");
-       // Set whether to auto-reconnect
-       subscriber.setAutoReconnect(true);
-       // Set reconnection interval
-       subscriber.setAutoReconnectInterval(100);
-       // Set keep-alive interval
-       subscriber.setKeepAlive(100);
-       // Set clean session
-       subscriber.setCleanSession(true);
-       // Set will topic
-       subscriber.setWillTopic("will/topic");
-
-       QByteArray ba("Hello");
-       // Set will message
-       subscriber.setWillMessage(ba);
-       // Connect to broker
-       subscriber.connectToHost();
+       factory = [receiveOptions, reconnect, keepAlive, &console]() -> QObject* {
+           Subscriber* subscriber = new Subscriber;
+           broker.applyTo(subscriber);
+           configureSubscriber(subscriber, receiveOptions, reconnect, &console, keepAlive);
+           // Connect to broker
+           subscriber->start();
+           return subscriber;
+       };
     } else if (s.contains("pub")) {
 
-        // publisher.setHostName("broker.emqx.io");
-        publisher.setClientId("pub_client11");
-        publisher.setUsername("username");
-        publisher.setPassword("password");
-        publisher.setAutoReconnect(true);
-        publisher.setAutoReconnectInterval(100);
-        publisher.setKeepAlive(100);
-        publisher.connectToHost();
+        int burst = parser.value(burstOption).toInt();
+        int coalesceMs = parser.value(coalesceOption).toInt();
+        int qos = parser.value(qosOption).toInt();
+        int window = parser.value(windowOption).toInt();
+        int stallMs = parser.value(stallOption).toInt();
+        int statsMs = receiveOptions.statsMs;
+        bool stamp = receiveOptions.stamp;
+        factory = [reconnect, keepAlive, burst, coalesceMs, qos, window, stallMs, statsMs,
+                stamp, &console]() -> QObject* {
+            Publisher* publisher = new Publisher;
+            broker.applyTo(publisher);
+            // publisher->setHostName("broker.emqx.io");
+            publisher->setClientId("pub_client11");
+            publisher->setUsername("username");
+            publisher->setPassword("password");
+            publisher->setReconnectPolicy(reconnect);
+            publisher->setBurst(burst, coalesceMs);
+            publisher->setQos(qos, window, stallMs, statsMs);
+            publisher->setStamp(stamp);
+            publisher->setKeepAlive(keepAlive);
+            QObject::connect(publisher, &Publisher::line, &console, &Console::print);
+            publisher->start();
+            return publisher;
+        };
     }
 
+    // The MQTT client gets its own event loop, unless asked to share ours
+    MqttThread network(factory);
+    QScopedPointer<QObject> sameThread;
+    if (parser.isSet(sameThreadOption))
+        sameThread.reset(factory());
+    else
+        network.start();
+
     // The exec() function enters the Qt application's event loop to wait for events.
-    return app.exec();
+    int rc = app.exec();
+    network.quit();
+    network.wait();
+    return rc;
 }
 
 #include "example.moc"
@@ -0,0 +1,156 @@
+/*
+ * inflight_tracker.h - QoS 1/2 in-flight window and ack latency
+ *
+ * Keeps the msgid returned by publish() with its send time until the
+ * published signal (PUBACK / PUBCOMP) for that msgid comes back, and
+ * records the ack latency. The publisher asks full() before publishing and
+ * holds back while the window is full.
+ *
+ * Two kinds of stall are counted, as episodes and total time:
+ *   window stalls  the window was full and the publisher had to wait
+ *   ack stalls     the oldest unacked message was older than stallMs,
+ *                  i.e. the broker stopped acking (checked in tick())
+ */
+#ifndef INFLIGHT_TRACKER_H
+#define INFLIGHT_TRACKER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+
+#include "latency_histogram.h"
+
+class InflightTracker
+{
+    public:
+        explicit InflightTracker(int window = 100, qint64 stallMs = 1000)
+            : _window(qBound(1, window, 65535))
+              , _stallNs(stallMs * 1000000)
+              , _acked(0)
+              , _abandoned(0)
+              , _windowStalls(0)
+              , _windowStallNs(0)
+              , _windowStallStart(-1)
+              , _ackStalls(0)
+              , _ackStallNs(0)
+              , _ackStallStart(-1)
+              , _maxAgeNs(0)
+        {
+            _clock.start();
+        }
+
+        int window() const { return _window; }
+        int size() const { return _inflight.size(); }
+
+        // extra: messages about to be published but not handed to publish() yet
+        bool full(int extra = 0)
+        {
+            bool isFull = _inflight.size() + extra >= _window;
+            if (isFull && _windowStallStart < 0) {
+                _windowStalls++;
+                _windowStallStart = _clock.nsecsElapsed();
+            }
+            return isFull;
+        }
+
+        void sent(quint16 msgid)
+        {
+            _inflight.insert(msgid, _clock.nsecsElapsed());
+        }
+
+        // PUBACK / PUBCOMP for msgid; false if it was not tracked
+        bool acked(quint16 msgid)
+        {
+            QHash<quint16, qint64>::iterator it = _inflight.find(msgid);
+            if (it == _inflight.end())
+                return false;
+            qint64 now = _clock.nsecsElapsed();
+            _latency.record(now - it.value());
+            _inflight.erase(it);
+            _acked++;
+            endWindowStall(now);
+            if (_inflight.isEmpty())
+                endAckStall(now);
+            return true;
+        }
+
+        // The session is gone (clean session reconnect): nothing will be acked
+        void abandon()
+        {
+            qint64 now = _clock.nsecsElapsed();
+            _abandoned += _inflight.size();
+            _inflight.clear();
+            endWindowStall(now);
+            endAckStall(now);
+        }
+
+        // Call periodically: looks for an unacked message older than stallMs
+        void tick()
+        {
+            qint64 now = _clock.nsecsElapsed();
+            qint64 oldest = now;
+            for (QHash<quint16, qint64>::const_iterator it = _inflight.constBegin();
+                    it != _inflight.constEnd(); ++it)
+                oldest = qMin(oldest, it.value());
+            qint64 age = now - oldest;
+            _maxAgeNs = qMax(_maxAgeNs, age);
+            if (age > _stallNs) {
+                if (_ackStallStart < 0) {
+                    _ackStalls++;
+                    _ackStallStart = oldest + _stallNs;
+                }
+            } else {
+                endAckStall(now);
+            }
+        }
+
+        const LatencyHistogram& latency() const { return _latency; }
+
+        // "inflight 12/100, acked 5012, ack latency min .. us, window stalls 2 (340 ms), ..."
+        QString summary() const
+        {
+            qint64 now = _clock.nsecsElapsed();
+            qint64 windowNs = _windowStallNs + (_windowStallStart >= 0 ? now - _windowStallStart : 0);
+            qint64 ackNs = _ackStallNs + (_ackStallStart >= 0 ? now - _ackStallStart : 0);
+            return QString("inflight %1/%2, acked %3, ack latency %4, window stalls %5 (%6 ms), "
+                    "ack stalls %7 (%8 ms, oldest unacked up to %9 ms), unacked at disconnect %10")
+                .arg(_inflight.size()).arg(_window).arg(_acked).arg(_latency.summaryUs())
+                .arg(_windowStalls).arg(windowNs / 1000000)
+                .arg(_ackStalls).arg(ackNs / 1000000).arg(_maxAgeNs / 1000000)
+                .arg(_abandoned);
+        }
+
+    private:
+        void endWindowStall(qint64 now)
+        {
+            if (_windowStallStart >= 0 && _inflight.size() < _window) {
+                _windowStallNs += now - _windowStallStart;
+                _windowStallStart = -1;
+            }
+        }
+
+        void endAckStall(qint64 now)
+        {
+            if (_ackStallStart >= 0) {
+                _ackStallNs += qMax<qint64>(0, now - _ackStallStart);
+                _ackStallStart = -1;
+            }
+        }
+
+        int _window;
+        qint64 _stallNs;
+        QElapsedTimer _clock;
+        QHash<quint16, qint64> _inflight;   // msgid -> send time
+        LatencyHistogram _latency;
+        quint64 _acked;
+        quint64 _abandoned;
+        quint32 _windowStalls;
+        qint64 _windowStallNs;
+        qint64 _windowStallStart;
+        quint32 _ackStalls;
+        qint64 _ackStallNs;
+        qint64 _ackStallStart;
+        qint64 _maxAgeNs;
+};
+
+#endif // INFLIGHT_TRACKER_H
@@ -0,0 +1,123 @@
+/*
+ * latency_histogram.h - fixed-size latency histogram for the qmqtt benchmarks
+ *
+ * Log-linear buckets: every power of two is split into 16 linear
+ * sub-buckets, so a reported percentile is within ~6% of the true value
+ * whatever the magnitude, and recording is a couple of shifts. Histograms
+ * of the same layout can be merged, e.g. across clients.
+ */
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <QtGlobal>
+#include <QString>
+#include <string.h>
+
+class LatencyHistogram
+{
+    public:
+        LatencyHistogram() { reset(); }
+
+        void reset()
+        {
+            memset(_buckets, 0, sizeof(_buckets));
+            _count = 0;
+            _sum = 0;
+            _min = 0;
+            _max = 0;
+        }
+
+        void record(qint64 ns)
+        {
+            quint64 v = ns > 0 ? quint64(ns) : 0;
+            _buckets[bucketOf(v)]++;
+            if (_count == 0 || v < _min)
+                _min = v;
+            if (v > _max)
+                _max = v;
+            _count++;
+            _sum += v;
+        }
+
+        void merge(const LatencyHistogram& other)
+        {
+            if (other._count == 0)
+                return;
+            for (int i = 0; i < BUCKETS; i++)
+                _buckets[i] += other._buckets[i];
+            if (_count == 0 || other._min < _min)
+                _min = other._min;
+            if (other._max > _max)
+                _max = other._max;
+            _count += other._count;
+            _sum += other._sum;
+        }
+
+        quint64 count() const { return _count; }
+        quint64 min() const { return _min; }
+        quint64 max() const { return _max; }
+        quint64 mean() const { return _count ? _sum / _count : 0; }
+
+        // Upper bound of the bucket holding the p-th percentile (0..100), in ns
+        quint64 percentile(double p) const
+        {
+            if (_count == 0)
+                return 0;
+            quint64 rank = quint64(p / 100.0 * _count + 0.5);
+            if (rank < 1)
+                rank = 1;
+            quint64 seen = 0;
+            for (int i = 0; i < BUCKETS; i++) {
+                seen += _buckets[i];
+                if (seen >= rank)
+                    return qMin(upperBound(i), _max);
+            }
+            return _max;
+        }
+
+        // "min 12 p50 40 p90 55 p99 90 max 130" in microseconds
+        QString summaryUs() const
+        {
+            return QString("min %1 p50 %2 p90 %3 p99 %4 max %5 us")
+                .arg(_min / 1000).arg(percentile(50) / 1000).arg(percentile(90) / 1000)
+                .arg(percentile(99) / 1000).arg(_max / 1000);
+        }
+
+    private:
+        static const int SUB_BITS = 4;
+        static const int SUB = 1 << SUB_BITS;
+        static const int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+        static int msb(quint64 v)
+        {
+            int n = 0;
+            while (v >>= 1)
+                n++;
+            return n;
+        }
+
+        static int bucketOf(quint64 v)
+        {
+            if (v < SUB)
+                return int(v);
+            int shift = msb(v) - SUB_BITS;
+            return (shift + 1) * SUB + int((v >> shift) & (SUB - 1));
+        }
+
+        static quint64 upperBound(int bucket)
+        {
+            if (bucket < SUB)
+                return quint64(bucket);
+            int shift = bucket / SUB - 1;
+            quint64 base = (quint64(SUB) | quint64(bucket % SUB)) << shift;
+            return base + (quint64(1) << shift) - 1;
+        }
+
+        quint64 _buckets[BUCKETS];
+        quint64 _count;
+        quint64 _sum;
+        quint64 _min;
+        quint64 _max;
+};
+
+#endif // LATENCY_HISTOGRAM_H
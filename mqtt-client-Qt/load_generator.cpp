@@ -0,0 +1,137 @@
+/*
+ * load_generator.cpp - many qmqtt clients from one process
+ */
+#include "load_generator.h"
+#include "mqtt_thread.h"
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+// Time on top of the run for connecting and draining before giving up on stragglers
+static const int LOAD_GRACE_MS = 30000;
+
+LoadGenerator::LoadGenerator(const LoadOptions& options, const BrokerAddress& broker,
+        QObject* parent)
+    : QObject(parent)
+      , _options(options)
+      , _broker(broker)
+      , _finished(0)
+      , _sent(0)
+      , _acked(0)
+      , _minRate(0)
+      , _maxRate(0)
+{
+    qRegisterMetaType<BenchResult>("BenchResult");
+
+    _options.clients = qMax(1, _options.clients);
+    _options.threads = qBound(1, _options.threads, _options.clients);
+    if (_options.topics.isEmpty())
+        _options.topics << "qmqtt/load/%1";
+    if (_options.rates.isEmpty())
+        _options.rates << 10;
+
+    _deadline.setSingleShot(true);
+    connect(&_deadline, &QTimer::timeout, this, &LoadGenerator::report);
+}
+
+LoadGenerator::~LoadGenerator()
+{
+    // Each thread deletes its clients when its event loop quits
+    qDeleteAll(_threads);
+}
+
+void LoadGenerator::start()
+{
+    QTextStream out(stdout);
+    out << "load: " << _options.clients << " clients on " << _options.threads
+        << " threads, " << _options.topics.join(",") << " at QoS " << int(_options.qos)
+        << ", " << _options.payloadSize << " B\n";
+    out.flush();
+
+    _clock.start();
+    int longestMs = _options.durationSecs * 1000;
+    // Unpaced clients stop after --count messages, give them a minute
+    foreach (quint32 rate, _options.rates)
+        if (rate == 0)
+            longestMs = qMax(longestMs, 60000);
+    _deadline.start(longestMs + LOAD_GRACE_MS);
+
+    for (int t = 0; t < _options.threads; t++) {
+        MqttThread* thread = new MqttThread([this, t]() { return createClients(t); });
+        thread->setObjectName(QString("mqtt-%1").arg(t));
+        _threads << thread;
+        thread->start();
+    }
+}
+
+// Runs on pool thread t: its share of the clients, round-robin
+QObject* LoadGenerator::createClients(int thread)
+{
+    QObject* root = new QObject;
+    qint64 pid = QCoreApplication::applicationPid();
+
+    for (int i = thread; i < _options.clients; i += _options.threads) {
+        BenchOptions bench;
+        bench.topic = _options.topics[i % _options.topics.size()].arg(i);
+        bench.rate = _options.rates[i % _options.rates.size()];
+        bench.count = bench.rate > 0 ? bench.rate * quint32(_options.durationSecs) : _options.count;
+        bench.qos = _options.qos;
+        bench.payloadSize = _options.payloadSize;
+        bench.window = _options.window;
+        bench.coalesceMs = _options.coalesceMs;
+        bench.quiet = true;
+
+        BenchPublisher* client = new BenchPublisher(bench, QHostAddress(), _broker.port, root);
+        _broker.applyTo(client);
+        client->setClientId(QString("load_%1_%2").arg(pid).arg(i));
+        client->setKeepAlive(_options.keepAlive);
+        client->setCleanSession(true);
+        // Queued to the generator on the main thread
+        connect(client, &BenchPublisher::finished, this, &LoadGenerator::onClientFinished);
+        client->connectToHost();
+    }
+    return root;
+}
+
+void LoadGenerator::onClientFinished(const BenchResult& result)
+{
+    double secs = result.publishNs / 1e9;
+    double rate = secs > 0 ? result.sent / secs : 0;
+    if (_finished == 0 || rate < _minRate)
+        _minRate = rate;
+    if (rate > _maxRate)
+        _maxRate = rate;
+
+    _finished++;
+    _sent += result.sent;
+    _acked += result.acked;
+    _latency.merge(result.latency);
+
+    if (_finished == _options.clients)
+        report();
+}
+
+void LoadGenerator::report()
+{
+    if (!_clock.isValid())
+        return;
+    _deadline.stop();
+    double secs = _clock.nsecsElapsed() / 1e9;
+    _clock.invalidate();
+
+    QTextStream out(stdout);
+    if (_finished < _options.clients)
+        out << "load: gave up on " << (_options.clients - _finished)
+            << " clients that did not finish (no connection?)\n";
+    out << "load: " << _finished << " clients published " << _sent << ", "
+        << (_options.qos == 0 ? "echoed " : "acked ") << _acked << ", lost " << (_sent - _acked)
+        << " in " << QString::number(secs, 'f', 3) << " s\n";
+    out << "load: aggregate " << QString::number(secs > 0 ? _acked / secs : 0, 'f', 0)
+        << " msg/s, per client " << QString::number(_minRate, 'f', 0) << ".."
+        << QString::number(_maxRate, 'f', 0) << " msg/s\n";
+    out << "load: " << (_options.qos == 0 ? "publish-to-echo" : "publish-to-ack")
+        << " latency " << _latency.summaryUs() << "\n";
+    out.flush();
+
+    emit finished();
+}
@@ -0,0 +1,73 @@
+/*
+ * load_generator.h - many qmqtt clients from one process
+ *
+ * Runs N BenchPublishers with unique client IDs, spread round-robin over a
+ * small pool of MQTT threads. Client i publishes to topic pattern
+ * i % patterns with %1 replaced by i, at rate i % rates, so one run can mix
+ * hot and quiet clients. At the end throughput and the latency histograms
+ * of all clients are merged into one report.
+ */
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+
+#include "bench_publisher.h"
+#include "broker_address.h"
+
+class MqttThread;
+
+struct LoadOptions
+{
+    int clients = 10;
+    int threads = 2;
+    QStringList topics = QStringList("qmqtt/load/%1");  // %1 = client index
+    QList<quint32> rates = QList<quint32>() << 10;      // msg/s per client
+    int durationSecs = 10;      // publishing time of each client
+    quint32 count = 100000;     // messages per client when its rate is 0
+    quint8 qos = 0;
+    int payloadSize = 64;
+    int window = 100;           // per client
+    int coalesceMs = -1;        // per client PublishBatcher window, -1 = off
+    int keepAlive = 60;
+};
+
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+    public:
+        LoadGenerator(const LoadOptions& options, const BrokerAddress& broker,
+                QObject* parent = NULL);
+        virtual ~LoadGenerator();
+
+        void start();
+
+    signals:
+        void finished();
+
+    private slots:
+        void onClientFinished(const BenchResult& result);
+        void report();
+
+    private:
+        QObject* createClients(int thread);
+
+        LoadOptions _options;
+        BrokerAddress _broker;
+        QList<MqttThread*> _threads;
+        QTimer _deadline;
+        QElapsedTimer _clock;
+
+        int _finished;
+        quint64 _sent;
+        quint64 _acked;
+        double _minRate;
+        double _maxRate;
+        LatencyHistogram _latency;
+};
+
+#endif // LOAD_GENERATOR_H
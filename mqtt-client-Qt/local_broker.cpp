@@ -0,0 +1,274 @@
+/*
+ * local_broker.cpp - loopback MQTT broker stand-in for offline load runs
+ */
+#include "local_broker.h"
+#include "mqtt_thread.h"
+
+#include <QSemaphore>
+#include <QTcpSocket>
+#include <cstdio>
+
+// MQTT control packet types, high nibble of the fixed header
+enum {
+    PKT_CONNECT = 1,
+    PKT_PUBLISH = 3,
+    PKT_PUBREL = 6,
+    PKT_SUBSCRIBE = 8,
+    PKT_UNSUBSCRIBE = 10,
+    PKT_PINGREQ = 12,
+    PKT_DISCONNECT = 14
+};
+
+// Larger packets are a protocol error here, the client is dropped
+static const int LOCAL_BROKER_MAX_PACKET = 1024 * 1024;
+
+static quint16 readU16(const QByteArray& data, int offset)
+{
+    return quint16(quint8(data[offset]) << 8 | quint8(data[offset + 1]));
+}
+
+// Two-byte length prefixed string at offset, advances it. False if truncated.
+static bool readString(const QByteArray& data, int& offset, QByteArray& out)
+{
+    if (offset + 2 > data.size())
+        return false;
+    int len = readU16(data, offset);
+    if (offset + 2 + len > data.size())
+        return false;
+    out = data.mid(offset + 2, len);
+    offset += 2 + len;
+    return true;
+}
+
+static QByteArray ack(quint8 header, quint16 id)
+{
+    QByteArray frame(4, 0);
+    frame[0] = char(header);
+    frame[1] = 2;
+    frame[2] = char(id >> 8);
+    frame[3] = char(id & 0xFF);
+    return frame;
+}
+
+LocalBroker::LocalBroker(QObject* parent)
+    : QObject(parent)
+{
+    connect(&_server, &QTcpServer::newConnection, this, &LocalBroker::onNewConnection);
+}
+
+bool LocalBroker::listen(const QHostAddress& address, quint16 port)
+{
+    return _server.listen(address, port);
+}
+
+MqttThread* LocalBroker::startThread(quint16 port, quint16* boundPort)
+{
+    QSemaphore ready;
+    bool listening = false;
+    quint16 bound = 0;
+    MqttThread* thread = new MqttThread([&]() -> QObject* {
+        LocalBroker* broker = new LocalBroker;
+        listening = broker->listen(QHostAddress::LocalHost, port);
+        if (listening)
+            bound = broker->serverPort();
+        else
+            fprintf(stderr, "local broker: %s\n", qPrintable(broker->errorString()));
+        ready.release();
+        return broker;
+    });
+    thread->setObjectName("broker");
+    thread->start();
+    ready.acquire();
+    if (!listening) {
+        delete thread;
+        return NULL;
+    }
+    if (boundPort)
+        *boundPort = bound;
+    return thread;
+}
+
+void LocalBroker::onNewConnection()
+{
+    while (QTcpSocket* socket = _server.nextPendingConnection()) {
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        _sessions.insert(socket, Session());
+        connect(socket, &QTcpSocket::readyRead, this, &LocalBroker::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, &LocalBroker::onDisconnected);
+    }
+}
+
+void LocalBroker::onDisconnected()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    _sessions.remove(socket);
+    socket->deleteLater();
+}
+
+void LocalBroker::onReadyRead()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    QHash<QTcpSocket*, Session>::iterator it = _sessions.find(socket);
+    if (it == _sessions.end())
+        return;
+    QByteArray& rx = it->rx;
+    rx += socket->readAll();
+
+    // Consume every complete packet: fixed header, remaining length, body
+    int offset = 0;
+    while (rx.size() - offset >= 2) {
+        int length = 0;
+        int used = 0;
+        bool complete = false;
+        for (int i = 0; i < 4 && offset + 1 + i < rx.size(); i++) {
+            quint8 b = quint8(rx[offset + 1 + i]);
+            length |= (b & 0x7F) << (7 * i);
+            if (!(b & 0x80)) {
+                used = i + 1;
+                complete = true;
+                break;
+            }
+        }
+        if (!complete || length > LOCAL_BROKER_MAX_PACKET) {
+            if (used == 0 && rx.size() - offset < 5)
+                break;      // length still incomplete
+            socket->abort();
+            return;
+        }
+        if (rx.size() - offset < 1 + used + length)
+            break;
+        quint8 header = quint8(rx[offset]);
+        QByteArray body = rx.mid(offset + 1 + used, length);
+        offset += 1 + used + length;
+        if (!handlePacket(socket, *it, header, body)) {
+            socket->disconnectFromHost();
+            return;
+        }
+    }
+    rx.remove(0, offset);
+}
+
+bool LocalBroker::handlePacket(QTcpSocket* socket, Session& session, quint8 header,
+        const QByteArray& body)
+{
+    switch (header >> 4) {
+    case PKT_CONNECT:
+        socket->write(QByteArray("\x20\x02\x00\x00", 4));
+        return true;
+
+    case PKT_PUBLISH: {
+        int qos = (header >> 1) & 3;
+        int offset = 0;
+        QByteArray topic;
+        if (!readString(body, offset, topic) || (qos > 0 && offset + 2 > body.size()))
+            return false;
+        if (qos > 0) {
+            quint16 id = readU16(body, offset);
+            offset += 2;
+            socket->write(ack(qos == 1 ? 0x40 : 0x50, id));
+        }
+        deliver(topic, body.mid(offset));
+        return true;
+    }
+
+    case PKT_PUBREL:
+        if (body.size() < 2)
+            return false;
+        socket->write(ack(0x70, readU16(body, 0)));
+        return true;
+
+    case PKT_SUBSCRIBE: {
+        if (body.size() < 2)
+            return false;
+        quint16 id = readU16(body, 0);
+        QByteArray granted;
+        int offset = 2;
+        QByteArray filter;
+        while (offset < body.size()) {
+            if (!readString(body, offset, filter) || offset >= body.size())
+                return false;
+            offset++;           // requested QoS, everything is delivered at 0
+            session.filters.append(filter.split('/'));
+            granted += char(0);
+        }
+        QByteArray frame;
+        frame += char(0x90);
+        appendLength(frame, 2 + granted.size());
+        frame += char(id >> 8);
+        frame += char(id & 0xFF);
+        frame += granted;
+        socket->write(frame);
+        return true;
+    }
+
+    case PKT_UNSUBSCRIBE: {
+        if (body.size() < 2)
+            return false;
+        int offset = 2;
+        QByteArray filter;
+        while (offset < body.size()) {
+            if (!readString(body, offset, filter))
+                return false;
+            session.filters.removeAll(filter.split('/'));
+        }
+        socket->write(ack(0xB0, readU16(body, 0)));
+        return true;
+    }
+
+    case PKT_PINGREQ:
+        socket->write(QByteArray("\xD0\x00", 2));
+        return true;
+
+    case PKT_DISCONNECT:
+    default:
+        return false;
+    }
+}
+
+void LocalBroker::deliver(const QByteArray& topic, const QByteArray& payload)
+{
+    QList<QByteArray> levels = topic.split('/');
+    QByteArray frame;
+
+    for (QHash<QTcpSocket*, Session>::iterator it = _sessions.begin(); it != _sessions.end(); ++it) {
+        foreach (const QList<QByteArray>& filter, it->filters) {
+            if (!matches(filter, levels))
+                continue;
+            // Encoded once, written to every matching subscriber
+            if (frame.isEmpty()) {
+                frame += char(0x30);
+                appendLength(frame, 2 + topic.size() + payload.size());
+                frame += char(topic.size() >> 8);
+                frame += char(topic.size() & 0xFF);
+                frame += topic;
+                frame += payload;
+            }
+            it.key()->write(frame);
+            break;      // once per client, however many of its filters match
+        }
+    }
+}
+
+bool LocalBroker::matches(const QList<QByteArray>& filter, const QList<QByteArray>& topic)
+{
+    for (int i = 0; i < filter.size(); i++) {
+        if (filter[i] == "#")
+            return true;
+        if (i >= topic.size())
+            return false;
+        if (filter[i] != "+" && filter[i] != topic[i])
+            return false;
+    }
+    return filter.size() == topic.size();
+}
+
+void LocalBroker::appendLength(QByteArray& frame, int length)
+{
+    do {
+        char b = char(length & 0x7F);
+        length >>= 7;
+        if (length > 0)
+            b |= char(0x80);
+        frame += b;
+    } while (length > 0);
+}
@@ -0,0 +1,61 @@
+/*
+ * local_broker.h - loopback MQTT broker stand-in for offline load runs
+ *
+ * Just enough MQTT 3.1.1 for the bench and load modes: CONNECT, SUBSCRIBE
+ * with + and # filters, UNSUBSCRIBE, PUBLISH at any QoS (acked with PUBACK
+ * or PUBREC/PUBCOMP), PINGREQ and DISCONNECT. Every PUBLISH is delivered
+ * at QoS 0 to all matching subscriptions, the sender included, so the QoS 0
+ * echo latency can be measured. No authentication, retained messages,
+ * wills or session state. Everything runs on the thread that created it.
+ */
+#ifndef LOCAL_BROKER_H
+#define LOCAL_BROKER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QObject>
+#include <QTcpServer>
+
+class MqttThread;
+class QTcpSocket;
+
+class LocalBroker : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit LocalBroker(QObject* parent = NULL);
+        virtual ~LocalBroker() {}
+
+        bool listen(const QHostAddress& address, quint16 port);
+        quint16 serverPort() const { return _server.serverPort(); }
+        QString errorString() const { return _server.errorString(); }
+
+        // A broker on its own thread, already listening on 127.0.0.1 when
+        // this returns. Port 0 picks a free one, see boundPort. NULL on error.
+        static MqttThread* startThread(quint16 port, quint16* boundPort = NULL);
+
+    private slots:
+        void onNewConnection();
+        void onReadyRead();
+        void onDisconnected();
+
+    private:
+        struct Session
+        {
+            QByteArray rx;                  // bytes of an incomplete packet
+            QList<QList<QByteArray> > filters; // subscriptions, split at '/'
+        };
+
+        bool handlePacket(QTcpSocket* socket, Session& session, quint8 header,
+                const QByteArray& body);
+        void deliver(const QByteArray& topic, const QByteArray& payload);
+        static bool matches(const QList<QByteArray>& filter, const QList<QByteArray>& topic);
+        static void appendLength(QByteArray& frame, int length);
+
+        QTcpServer _server;
+        QHash<QTcpSocket*, Session> _sessions;
+};
+
+#endif // LOCAL_BROKER_H
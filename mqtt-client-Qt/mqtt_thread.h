@@ -0,0 +1,52 @@
+/*
+ * mqtt_thread.h - event loop thread for the qmqtt clients
+ *
+ * Keeps socket reads, acks and keepalive pings off the main thread, so a
+ * slow console or UI cannot stall them. qmqtt keeps its socket and its
+ * keepalive timers in private members without a QObject parent, and
+ * moveToThread() on a client would leave those behind. Clients therefore
+ * have to be created inside the thread: the factory runs in run(), and the
+ * object it returns (parent of everything it created) is deleted there
+ * when the thread's event loop quits.
+ *
+ * Signals from the clients to objects on the main thread are queued
+ * automatically. Never call into a client from the main thread, connect a
+ * signal to its slot instead.
+ */
+#ifndef MQTT_THREAD_H
+#define MQTT_THREAD_H
+
+#include <QScopedPointer>
+#include <QThread>
+#include <functional>
+
+class MqttThread : public QThread
+{
+    public:
+        typedef std::function<QObject*()> Factory;
+
+        explicit MqttThread(const Factory& factory, QObject* parent = NULL)
+            : QThread(parent)
+              , _factory(factory)
+        {
+            setObjectName("mqtt");
+        }
+
+        virtual ~MqttThread()
+        {
+            quit();
+            wait();
+        }
+
+    protected:
+        void run() override
+        {
+            QScopedPointer<QObject> root(_factory());
+            exec();
+        }
+
+    private:
+        Factory _factory;
+};
+
+#endif // MQTT_THREAD_H
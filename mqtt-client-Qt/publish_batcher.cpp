@@ -0,0 +1,51 @@
+/*
+ * publish_batcher.cpp - coalesce publishes into one socket write
+ */
+#include "publish_batcher.h"
+
+PublishBatcher::PublishBatcher(const Publish& publish, int windowMs, QObject* parent)
+    : QObject(parent)
+      , _publish(publish)
+      , _windowMs(windowMs)
+      , _batches(0)
+      , _messages(0)
+{
+    _timer.setSingleShot(true);
+    _timer.setTimerType(Qt::PreciseTimer);
+    connect(&_timer, &QTimer::timeout, this, &PublishBatcher::flush);
+}
+
+void PublishBatcher::setWindowMs(int windowMs)
+{
+    _windowMs = windowMs;
+    if (_windowMs < 0)
+        flush();
+}
+
+void PublishBatcher::publish(const QMQTT::Message& message, qint64 tag)
+{
+    if (_windowMs < 0) {
+        _batches++;
+        _messages++;
+        emit sent(tag, _publish(message));
+        return;
+    }
+    _queue.append(qMakePair(message, tag));
+    // A 0 ms timer fires once the events of this pass are done
+    if (!_timer.isActive())
+        _timer.start(_windowMs);
+}
+
+void PublishBatcher::flush()
+{
+    _timer.stop();
+    if (_queue.isEmpty())
+        return;
+    // sent() handlers may publish again, those start the next batch
+    QVector<QPair<QMQTT::Message, qint64> > batch;
+    batch.swap(_queue);
+    _batches++;
+    _messages += batch.size();
+    for (int i = 0; i < batch.size(); i++)
+        emit sent(batch[i].second, _publish(batch[i].first));
+}
@@ -0,0 +1,64 @@
+/*
+ * publish_batcher.h - coalesce publishes into one socket write
+ *
+ * qmqtt encodes every publish() straight into its QTcpSocket's write
+ * buffer, and the socket hands that buffer to the kernel whenever it
+ * becomes writable. Publishes spread over several timer events, or over
+ * a few milliseconds, therefore usually leave in separate write()s and
+ * separate TCP segments. The batcher holds them back instead and
+ * publishes them back to back:
+ *
+ *   windowMs < 0   no batching, publish() goes straight through
+ *   windowMs == 0  everything published in this event-loop pass
+ *   windowMs > 0   everything published within windowMs of the first one
+ *
+ * so a burst is encoded contiguously and goes out in one write. The cost
+ * is up to windowMs of extra latency. sent() reports each message's tag
+ * and msgid once it was really published.
+ */
+#ifndef PUBLISH_BATCHER_H
+#define PUBLISH_BATCHER_H
+
+#include <qmqtt.h>
+#include <QObject>
+#include <QPair>
+#include <QTimer>
+#include <QVector>
+#include <functional>
+
+class PublishBatcher : public QObject
+{
+    Q_OBJECT
+    public:
+        typedef std::function<quint16(const QMQTT::Message&)> Publish;
+
+        PublishBatcher(const Publish& publish, int windowMs = 0, QObject* parent = NULL);
+        virtual ~PublishBatcher() {}
+
+        void setWindowMs(int windowMs);
+        int windowMs() const { return _windowMs; }
+
+        // Queue for the current batch; tag comes back with sent()
+        void publish(const QMQTT::Message& message, qint64 tag = 0);
+
+        int pending() const { return _queue.size(); }
+        quint64 batches() const { return _batches; }
+        quint64 messages() const { return _messages; }
+
+    signals:
+        void sent(qint64 tag, quint16 msgid);
+
+    public slots:
+        // Publish everything queued, now
+        void flush();
+
+    private:
+        Publish _publish;
+        int _windowMs;
+        QTimer _timer;
+        QVector<QPair<QMQTT::Message, qint64> > _queue;
+        quint64 _batches;
+        quint64 _messages;
+};
+
+#endif // PUBLISH_BATCHER_H
@@ -0,0 +1,124 @@
+/*
+ * reconnector.cpp - reconnect with exponential backoff for a qmqtt client
+ */
+#include "reconnector.h"
+
+#include <QtMath>
+
+Reconnector::Reconnector(QMQTT::Client* client, const ReconnectPolicy& policy)
+    : QObject(client)
+      , _client(client)
+      , _policy(policy)
+      , _random(std::random_device()())
+      , _stopped(true)
+      , _connectedOnce(false)
+      , _attempts(0)
+      , _lostInGap(0)
+      , _reconnects(0)
+      , _lost(0)
+      , _maxDowntimeMs(0)
+{
+    // Retries are ours now
+    _client->setAutoReconnect(false);
+
+    _retryTimer.setSingleShot(true);
+    connect(&_retryTimer, &QTimer::timeout, this, &Reconnector::retry);
+    connect(_client, &QMQTT::Client::connected, this, &Reconnector::onConnected);
+    connect(_client, &QMQTT::Client::disconnected, this, &Reconnector::onDisconnected);
+    connect(_client, &QMQTT::Client::error, this, &Reconnector::onError);
+}
+
+void Reconnector::connectToHost()
+{
+    _stopped = false;
+    _down.start();
+    _attempts = 1;
+    _client->connectToHost();
+}
+
+void Reconnector::disconnectFromHost()
+{
+    _stopped = true;
+    _retryTimer.stop();
+    _client->disconnectFromHost();
+}
+
+quint16 Reconnector::publish(const QMQTT::Message& message)
+{
+    if (_client->isConnectedToHost() && _queue.isEmpty())
+        return _client->publish(message);
+
+    if (_queue.size() >= _policy.queueMax) {
+        _queue.dequeue();
+        _lostInGap++;
+        _lost++;
+    }
+    _queue.enqueue(message);
+    return 0;
+}
+
+void Reconnector::onConnected()
+{
+    _retryTimer.stop();
+    qint64 downtimeMs = _down.isValid() ? _down.elapsed() : 0;
+    _down.invalidate();
+
+    // Replay everything queued in one go, the socket sends it as one burst
+    int replayed = _queue.size();
+    while (!_queue.isEmpty())
+        _client->publish(_queue.dequeue());
+
+    // The first connect is not a recovery
+    if (_connectedOnce) {
+        _reconnects++;
+        _maxDowntimeMs = qMax(_maxDowntimeMs, downtimeMs);
+        emit reconnected(downtimeMs, _attempts, replayed, _lostInGap);
+    }
+    _connectedOnce = true;
+    _attempts = 0;
+    _lostInGap = 0;
+}
+
+void Reconnector::onDisconnected()
+{
+    if (_stopped)
+        return;
+    if (!_down.isValid()) {
+        _down.start();
+        _attempts = 0;
+    }
+    scheduleRetry();
+}
+
+// A refused or timed out connect may not come with a disconnected signal
+void Reconnector::onError(const QMQTT::ClientError error)
+{
+    Q_UNUSED(error);
+    if (_stopped || _client->isConnectedToHost())
+        return;
+    if (!_down.isValid()) {
+        _down.start();
+        _attempts = 0;
+    }
+    scheduleRetry();
+}
+
+void Reconnector::scheduleRetry()
+{
+    if (_retryTimer.isActive())
+        return;
+    double delay = qMin(double(_policy.maxMs),
+            _policy.initialMs * qPow(_policy.multiplier, _attempts));
+    std::uniform_real_distribution<double> share(0.0, qBound(0.0, _policy.jitter, 1.0));
+    int delayMs = qMax(1, int(delay * (1.0 - share(_random))));
+    emit retrying(_attempts + 1, delayMs);
+    _retryTimer.start(delayMs);
+}
+
+void Reconnector::retry()
+{
+    if (_stopped || _client->isConnectedToHost())
+        return;
+    _attempts++;
+    _client->connectToHost();
+}
@@ -0,0 +1,87 @@
+/*
+ * reconnector.h - reconnect with exponential backoff for a qmqtt client
+ *
+ * Replaces qmqtt's fixed-interval auto-reconnect, which after a broker
+ * restart has every client retrying every few milliseconds. The n-th retry
+ * waits initialMs * multiplier^n, capped at maxMs, minus a random share of
+ * up to jitter of it, so a fleet that lost the broker at the same moment
+ * does not come back in lockstep.
+ *
+ * Publishes made through the reconnector while the client is down are
+ * queued (up to queueMax, the oldest are dropped beyond that) and replayed
+ * in one go as soon as the client is connected again. Every recovery is
+ * reported with how long the client was down, how many attempts it took,
+ * and how many publishes were replayed or lost.
+ */
+#ifndef RECONNECTOR_H
+#define RECONNECTOR_H
+
+#include <qmqtt.h>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+#include <random>
+
+struct ReconnectPolicy
+{
+    int initialMs = 500;        // first retry
+    int maxMs = 30000;          // cap for the backoff
+    double multiplier = 2.0;
+    double jitter = 0.5;        // up to this share of the delay is randomly taken off
+    int queueMax = 1000;        // publishes kept while disconnected
+};
+
+class Reconnector : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit Reconnector(QMQTT::Client* client, const ReconnectPolicy& policy = ReconnectPolicy());
+        virtual ~Reconnector() {}
+
+        void setPolicy(const ReconnectPolicy& policy) { _policy = policy; }
+
+        // First connect; failures are retried with backoff as well
+        void connectToHost();
+        // Disconnect for good, no retries after this
+        void disconnectFromHost();
+
+        // publish() right away while connected, queue otherwise. Returns the
+        // msgid, 0 if the message was queued.
+        quint16 publish(const QMQTT::Message& message);
+
+        quint32 reconnects() const { return _reconnects; }
+        quint64 lost() const { return _lost; }
+        qint64 maxDowntimeMs() const { return _maxDowntimeMs; }
+
+    signals:
+        // Back after downtimeMs; publishes replayed from the queue, and dropped from it
+        void reconnected(qint64 downtimeMs, int attempts, int replayed, int lost);
+        // A retry is scheduled in delayMs
+        void retrying(int attempt, int delayMs);
+
+    private slots:
+        void onConnected();
+        void onDisconnected();
+        void onError(const QMQTT::ClientError error);
+        void retry();
+
+    private:
+        void scheduleRetry();
+
+        QMQTT::Client* _client;
+        ReconnectPolicy _policy;
+        QTimer _retryTimer;
+        QElapsedTimer _down;            // running while disconnected
+        std::minstd_rand _random;
+        QQueue<QMQTT::Message> _queue;
+        bool _stopped;
+        bool _connectedOnce;
+        int _attempts;
+        int _lostInGap;
+        quint32 _reconnects;
+        quint64 _lost;
+        qint64 _maxDowntimeMs;
+};
+
+#endif // RECONNECTOR_H
@@ -0,0 +1,141 @@
+/*
+ * send_stamp.h - optional send stamp at the front of a payload
+ *
+ * 16 bytes, multi-byte fields big-endian, the same layout as stamp.h of
+ * the paho and nng examples, so any of them can talk to any other:
+ *
+ *   0   'M' 'S'   magic
+ *   2   1         version
+ *   3   0         flags, reserved
+ *   4   quint32   sequence number, +1 per message of one publisher
+ *   8   quint64   send time, CLOCK_MONOTONIC in ns
+ *
+ * The monotonic clock is shared by the processes of one host only, so the
+ * one-way latency means something when publisher and subscriber run on the
+ * same machine, whatever broker is in between.
+ *
+ * StampStats follows the sequence numbers: a jump forward is a gap, an
+ * older number a late (reordered) message, which also fills one missing
+ * slot of an earlier gap. A duplicate (QoS 1 redelivery) looks late too.
+ */
+#ifndef SEND_STAMP_H
+#define SEND_STAMP_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <QtEndian>
+#ifdef Q_OS_UNIX
+#include <time.h>
+#endif
+
+#include "latency_histogram.h"
+
+struct SendStamp
+{
+    static const int SIZE = 16;
+    static const char VERSION = 1;
+
+    static quint64 nowNs()
+    {
+#ifdef Q_OS_UNIX
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return quint64(ts.tv_sec) * 1000000000u + quint64(ts.tv_nsec);
+#else
+        return quint64(QElapsedTimer::msecsSinceReference()) * 1000000u;
+#endif
+    }
+
+    // Replaces the first SIZE bytes of payload, which must be at least that long
+    static void write(QByteArray& payload, quint32 seq)
+    {
+        uchar* p = reinterpret_cast<uchar*>(payload.data());
+        p[0] = 'M';
+        p[1] = 'S';
+        p[2] = VERSION;
+        p[3] = 0;
+        qToBigEndian<quint32>(seq, p + 4);
+        qToBigEndian<quint64>(nowNs(), p + 8);
+    }
+
+    // True and the fields if payload starts with a stamp
+    static bool read(const QByteArray& payload, quint32* seq, quint64* sentNs)
+    {
+        const uchar* p = reinterpret_cast<const uchar*>(payload.constData());
+        if (payload.size() < SIZE || p[0] != 'M' || p[1] != 'S' || p[2] != VERSION)
+            return false;
+        *seq = qFromBigEndian<quint32>(p + 4);
+        *sentNs = qFromBigEndian<quint64>(p + 8);
+        return true;
+    }
+};
+
+class StampStats
+{
+    public:
+        StampStats()
+            : _unstamped(0)
+              , _nextSeq(0)
+              , _gaps(0)
+              , _missing(0)
+              , _reordered(0)
+              , _costNs(0)
+        {
+        }
+
+        // Records latency and sequence of a received payload; returns how
+        // many bytes to skip to get to the application payload
+        int receive(const QByteArray& payload)
+        {
+            quint64 start = SendStamp::nowNs();
+            quint32 seq;
+            quint64 sentNs;
+            if (!SendStamp::read(payload, &seq, &sentNs)) {
+                _unstamped++;
+                return 0;
+            }
+            // Clamped: a stamp from another host's clock can be ahead of ours
+            _latency.record(start > sentNs ? qint64(start - sentNs) : 0);
+
+            bool first = _latency.count() == 1;
+            qint32 ahead = qint32(seq - _nextSeq);
+            if (!first && ahead > 0) {
+                _gaps++;
+                _missing += quint32(ahead);
+            } else if (!first && ahead < 0) {
+                _reordered++;
+                if (_missing > 0)
+                    _missing--;
+            }
+            if (first || ahead >= 0)
+                _nextSeq = seq + 1;
+
+            _costNs += SendStamp::nowNs() - start;
+            return SendStamp::SIZE;
+        }
+
+        const LatencyHistogram& latency() const { return _latency; }
+
+        // "stamped 100, one-way latency min .. us, gaps 0, missing 0, ..."
+        QString summary() const
+        {
+            quint64 stamped = _latency.count();
+            return QString("stamped %1, unstamped %2, one-way latency %3, gaps %4, missing %5, "
+                    "reordered %6, parse cost %7 ns/msg")
+                .arg(stamped).arg(_unstamped).arg(_latency.summaryUs())
+                .arg(_gaps).arg(_missing).arg(_reordered)
+                .arg(stamped ? _costNs / stamped : 0);
+        }
+
+    private:
+        LatencyHistogram _latency;
+        quint64 _unstamped;
+        quint32 _nextSeq;
+        quint64 _gaps;
+        quint64 _missing;
+        quint64 _reordered;
+        quint64 _costNs;        // in receive(), clock reads included
+};
+
+#endif // SEND_STAMP_H
@@ -0,0 +1,41 @@
+/*
+ * thread_io.h - syscall counters of the calling thread
+ *
+ * Linux keeps per-thread I/O accounting in /proc/thread-self/io. syscw
+ * counts write()-family calls; Qt sends TCP data with write(), so on a
+ * thread that runs only MQTT clients the delta over a run is its socket
+ * writes (plus the odd event-loop wakeup). Elsewhere the counters are -1.
+ */
+#ifndef THREAD_IO_H
+#define THREAD_IO_H
+
+#include <QFile>
+#include <QList>
+#include <QtGlobal>
+
+struct ThreadIo
+{
+    qint64 syscr = -1;      // read syscalls
+    qint64 syscw = -1;      // write syscalls
+
+    bool valid() const { return syscw >= 0; }
+
+    static ThreadIo sample()
+    {
+        ThreadIo io;
+#ifdef Q_OS_LINUX
+        QFile file("/proc/thread-self/io");
+        if (!file.open(QIODevice::ReadOnly))
+            return io;
+        foreach (const QByteArray& line, file.readAll().split('\n')) {
+            if (line.startsWith("syscr:"))
+                io.syscr = line.mid(6).trimmed().toLongLong();
+            else if (line.startsWith("syscw:"))
+                io.syscw = line.mid(6).trimmed().toLongLong();
+        }
+#endif
+        return io;
+    }
+};
+
+#endif // THREAD_IO_H